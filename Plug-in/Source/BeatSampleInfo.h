@@ -47,15 +47,21 @@ struct BeatSampleInfo
     void setNextBeatInfo();
 
     /**
-	 * \brief This should be called after every sample is processed to internally track the host timeline position.
+	 * \brief This should be called after samples are processed to internally track the host timeline position.
+	 * \param numSamples The number of samples that were processed, none of them on the beat boundary
 	 */
-    void incrementSamplesIntoBeat() { ++samplesIntoBeat; }
+    void incrementSamplesIntoBeat(const int numSamples) { samplesIntoBeat += numSamples; }
 
     /**
 	 * \return True if we're at a beat boundary
 	 */
     [[nodiscard]] bool isPastBeatEnd() const { return samplesIntoBeat >= beatSampleLength; }
 
+    /**
+	 * \return The number of samples until the next beat, counting the one on the beat boundary
+	 */
+    [[nodiscard]] int getNumSamplesLeftInBeat() const { return beatSampleLength - samplesIntoBeat + 1; }
+
     /**
 	 * \return The number of samples through the beat the host timeline has moved past
 	 */
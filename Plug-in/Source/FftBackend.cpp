@@ -0,0 +1,259 @@
+/*
+  ==============================================================================
+
+	This file is part of Gamelanizer.
+	Copyright (c) 2019 - Luke McDuffie Craig.
+
+	Gamelanizer is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Gamelanizer is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Gamelanizer. If not, see <https://www.gnu.org/licenses/>.
+
+  ==============================================================================
+*/
+
+#include "FftBackend.h"
+
+#if GamelanizerFftBackend == GamelanizerFftBackendPffft
+ #include <pffft.h>
+#elif GamelanizerFftBackend == GamelanizerFftBackendFftw
+ #include <fftw3.h>
+#elif GamelanizerFftBackend == GamelanizerFftBackendKissFft
+ #include <kiss_fftr.h>
+#elif GamelanizerFftBackend != GamelanizerFftBackendJuce
+ #error "Unknown GamelanizerFftBackend"
+#endif
+
+//==============================================================================
+#if GamelanizerFftBackend == GamelanizerFftBackendJuce
+
+struct FftBackend::Implementation
+{
+    explicit Implementation(const int order): instance{order}
+    {
+    }
+
+    void forward(float* inOut) const noexcept
+    {
+        instance.performRealOnlyForwardTransform(inOut, true);
+    }
+
+    void inverse(float* inOut) const noexcept
+    {
+        instance.performRealOnlyInverseTransform(inOut);
+    }
+
+    dsp::FFT instance;
+};
+
+//==============================================================================
+#elif GamelanizerFftBackend == GamelanizerFftBackendPffft
+
+struct FftBackend::Implementation
+{
+    explicit Implementation(const int order): size{1 << order},
+                                              setup{pffft_new_setup(size, PFFFT_REAL)},
+                                              buffer{static_cast<float*>(pffft_aligned_malloc(size * sizeof(float)))},
+                                              work{static_cast<float*>(pffft_aligned_malloc(size * sizeof(float)))}
+    {
+        // pffft needs real transforms to be a multiple of 32
+        jassert(setup != nullptr);
+    }
+
+    ~Implementation()
+    {
+        pffft_aligned_free(work);
+        pffft_aligned_free(buffer);
+        pffft_destroy_setup(setup);
+    }
+
+    void forward(float* inOut) const noexcept
+    {
+        // pffft wants 16 byte aligned data
+        std::copy(inOut, inOut + size, buffer);
+        pffft_transform_ordered(setup, buffer, buffer, work, PFFFT_FORWARD);
+        // pffft packs the real Nyquist bin in the imaginary part of the DC bin
+        std::copy(buffer + 2, buffer + size, inOut + 2);
+        inOut[0] = buffer[0];
+        inOut[1] = 0.0f;
+        inOut[size] = buffer[1];
+        inOut[size + 1] = 0.0f;
+    }
+
+    void inverse(float* inOut) const noexcept
+    {
+        buffer[0] = inOut[0];
+        buffer[1] = inOut[size];
+        std::copy(inOut + 2, inOut + size, buffer + 2);
+        pffft_transform_ordered(setup, buffer, buffer, work, PFFFT_BACKWARD);
+        // pffft doesn't scale the inverse
+        FloatVectorOperations::multiply(inOut, buffer, 1.0f / static_cast<float>(size), size);
+    }
+
+    const int size;
+    PFFFT_Setup* const setup;
+    float* const buffer;
+    float* const work;
+};
+
+//==============================================================================
+#elif GamelanizerFftBackend == GamelanizerFftBackendFftw
+
+struct FftBackend::Implementation
+{
+    explicit Implementation(const int order): size{1 << order},
+                                              buffer{fftwf_alloc_real(static_cast<size_t>(size + 2))}
+    {
+        // the FFTW planner is not thread safe
+        const ScopedLock sl(getPlannerLock());
+        loadWisdom();
+
+        // plan in-place on our own buffer so that the plans can always be reused with it
+        auto* complexBuffer = reinterpret_cast<fftwf_complex*>(buffer);
+        forwardPlan = fftwf_plan_dft_r2c_1d(size, buffer, complexBuffer, FFTW_MEASURE);
+        inversePlan = fftwf_plan_dft_c2r_1d(size, complexBuffer, buffer, FFTW_MEASURE);
+        jassert(forwardPlan != nullptr && inversePlan != nullptr);
+
+        saveWisdom();
+    }
+
+    ~Implementation()
+    {
+        const ScopedLock sl(getPlannerLock());
+        fftwf_destroy_plan(inversePlan);
+        fftwf_destroy_plan(forwardPlan);
+        fftwf_free(buffer);
+    }
+
+    void forward(float* inOut) const noexcept
+    {
+        std::copy(inOut, inOut + size, buffer);
+        fftwf_execute(forwardPlan);
+        // FFTW's r2c output is already the same as JUCE's
+        std::copy(buffer, buffer + size + 2, inOut);
+    }
+
+    void inverse(float* inOut) const noexcept
+    {
+        std::copy(inOut, inOut + size + 2, buffer);
+        fftwf_execute(inversePlan);
+        // FFTW doesn't scale the inverse
+        FloatVectorOperations::multiply(inOut, buffer, 1.0f / static_cast<float>(size), size);
+    }
+
+    static CriticalSection& getPlannerLock()
+    {
+        static CriticalSection plannerLock;
+        return plannerLock;
+    }
+
+    static File getWisdomFile()
+    {
+        return File::getSpecialLocation(File::SpecialLocationType::userApplicationDataDirectory)
+               .getChildFile("Gamelanizer").getChildFile("fftwf_wisdom.txt");
+    }
+
+    static void loadWisdom()
+    {
+        static auto loaded = false;
+        if (loaded)
+            return;
+        loaded = true;
+        const auto wisdomFile = getWisdomFile();
+        if (wisdomFile.existsAsFile())
+            fftwf_import_wisdom_from_filename(wisdomFile.getFullPathName().toRawUTF8());
+    }
+
+    static void saveWisdom()
+    {
+        const auto wisdomFile = getWisdomFile();
+        if (wisdomFile.getParentDirectory().createDirectory().wasOk())
+            fftwf_export_wisdom_to_filename(wisdomFile.getFullPathName().toRawUTF8());
+    }
+
+    const int size;
+    float* const buffer;
+    fftwf_plan forwardPlan{};
+    fftwf_plan inversePlan{};
+};
+
+//==============================================================================
+#elif GamelanizerFftBackend == GamelanizerFftBackendKissFft
+
+struct FftBackend::Implementation
+{
+    explicit Implementation(const int order): size{1 << order},
+                                              forwardConfig{kiss_fftr_alloc(size, 0, nullptr, nullptr)},
+                                              inverseConfig{kiss_fftr_alloc(size, 1, nullptr, nullptr)},
+                                              buffer(static_cast<size_t>(size))
+    {
+        jassert(forwardConfig != nullptr && inverseConfig != nullptr);
+    }
+
+    ~Implementation()
+    {
+        kiss_fftr_free(inverseConfig);
+        kiss_fftr_free(forwardConfig);
+    }
+
+    void forward(float* inOut) noexcept
+    {
+        // kiss_fftr is out of place. Its output is already the same as JUCE's
+        std::copy(inOut, inOut + size, buffer.begin());
+        kiss_fftr(forwardConfig, buffer.data(), reinterpret_cast<kiss_fft_cpx*>(inOut));
+    }
+
+    void inverse(float* inOut) noexcept
+    {
+        kiss_fftri(inverseConfig, reinterpret_cast<const kiss_fft_cpx*>(inOut), buffer.data());
+        // KissFFT doesn't scale the inverse
+        FloatVectorOperations::multiply(inOut, buffer.data(), 1.0f / static_cast<float>(size), size);
+    }
+
+    const int size;
+    kiss_fftr_cfg forwardConfig;
+    kiss_fftr_cfg inverseConfig;
+    std::vector<float> buffer;
+};
+
+#endif
+
+//==============================================================================
+
+FftBackend::FftBackend(const int order) : size{1 << order},
+                                          implementation{std::make_unique<Implementation>(order)}
+{
+}
+
+FftBackend::~FftBackend() = default;
+
+void FftBackend::performRealOnlyForwardTransform(float* inOut) noexcept
+{
+    implementation->forward(inOut);
+}
+
+void FftBackend::performRealOnlyInverseTransform(float* inOut) noexcept
+{
+    implementation->inverse(inOut);
+}
+
+const char* FftBackend::getName()
+{
+#if GamelanizerFftBackend == GamelanizerFftBackendPffft
+    return "pffft";
+#elif GamelanizerFftBackend == GamelanizerFftBackendFftw
+    return "FFTW3";
+#elif GamelanizerFftBackend == GamelanizerFftBackendKissFft
+    return "KissFFT";
+#else
+    return JUCE_DSP_USE_INTEL_MKL ? "MKL" : "Fallback";
+#endif
+}
@@ -0,0 +1,111 @@
+/*
+  ==============================================================================
+
+	This file is part of Gamelanizer.
+	Copyright (c) 2019 - Luke McDuffie Craig.
+
+	Gamelanizer is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Gamelanizer is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Gamelanizer. If not, see <https://www.gnu.org/licenses/>.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "../JuceLibraryCode/JuceHeader.h"
+
+/**
+ * \brief The FFT library is chosen at build time with the GamelanizerFftBackend preprocessor definition in the .jucer file.
+ * Anything other than the JUCE backend needs the library's headers and binaries added to the exporter.
+ */
+#define GamelanizerFftBackendJuce 0
+#define GamelanizerFftBackendPffft 1
+#define GamelanizerFftBackendFftw 2
+#define GamelanizerFftBackendKissFft 3
+
+#ifndef GamelanizerFftBackend
+ #define GamelanizerFftBackend GamelanizerFftBackendJuce
+#endif
+
+/** \addtogroup Utility
+ *  @{
+ */
+
+/**
+ * \brief A real-only FFT with the same data layout and scaling as JUCE's dsp::FFT,
+ * backed by whichever library GamelanizerFftBackend selects:
+ * - GamelanizerFftBackendJuce (0): dsp::FFT. That is the fallback engine, or MKL if JUCE_DSP_USE_INTEL_MKL is enabled.
+ * - GamelanizerFftBackendPffft (1): pffft.
+ * - GamelanizerFftBackendFftw (2): FFTW3 in single precision. Plans are measured once and saved as wisdom.
+ * - GamelanizerFftBackendKissFft (3): KissFFT's real transforms.
+ *
+ * The libraries' headers are only included in FftBackend.cpp.
+ */
+class FftBackend
+{
+public:
+    /**
+     * \brief Create the FFT. This may allocate and (for FFTW) measure plans, so do not call it on the audio thread.
+     * \param order The FFT size is \f$2^{order}\f$
+     */
+    explicit FftBackend(int order);
+
+    FftBackend(const FftBackend&) = delete;
+
+    FftBackend& operator=(const FftBackend&) = delete;
+
+    FftBackend(FftBackend&&) = delete;
+
+    FftBackend& operator=(FftBackend&&) = delete;
+
+    ~FftBackend();
+
+    /**
+     * \brief Same as dsp::FFT::performRealOnlyForwardTransform with onlyCalculateNonNegativeFrequencies set to true.
+     * \param inOut The real input in the first getSize() samples.
+     * The output is the getSize()/2 + 1 non-negative frequency bins as interleaved complex numbers.
+     * It must be at least 2 * getSize() long.
+     */
+    void performRealOnlyForwardTransform(float* inOut) noexcept;
+
+    /**
+     * \brief Same as dsp::FFT::performRealOnlyInverseTransform. The output is scaled by 1/getSize().
+     * \param inOut The getSize()/2 + 1 non-negative frequency bins as interleaved complex numbers.
+     * The real output is written to the first getSize() samples. It must be at least 2 * getSize() long.
+     */
+    void performRealOnlyInverseTransform(float* inOut) noexcept;
+
+    /**
+     * \return The FFT size
+     */
+    [[nodiscard]] int getSize() const noexcept { return size; }
+
+    /**
+     * \return The name of the FFT library this was built with. This is also used in the PerformanceMeasures log filenames.
+     */
+    static const char* getName();
+
+private:
+    /**
+     * \brief The library specific state
+     */
+    struct Implementation;
+
+    const int size;
+
+    std::unique_ptr<Implementation> implementation;
+
+    //==============================================================================
+    JUCE_LEAK_DETECTOR(FftBackend)
+};
+
+/** @}*/
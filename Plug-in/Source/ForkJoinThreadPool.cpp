@@ -0,0 +1,176 @@
+/*
+  ==============================================================================
+
+	This file is part of Gamelanizer.
+	Copyright (c) 2019 - Luke McDuffie Craig.
+
+	Gamelanizer is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Gamelanizer is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Gamelanizer. If not, see <https://www.gnu.org/licenses/>.
+
+  ==============================================================================
+*/
+
+#include "ForkJoinThreadPool.h"
+
+#if JUCE_WINDOWS
+ #ifndef NOMINMAX
+  #define NOMINMAX
+ #endif
+ #ifndef WIN32_LEAN_AND_MEAN
+  #define WIN32_LEAN_AND_MEAN
+ #endif
+ #include <windows.h>
+#elif JUCE_MAC
+ #include <dispatch/dispatch.h>
+#else
+ #include <semaphore.h>
+ #include <cerrno>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+ #include <emmintrin.h>
+#endif
+
+namespace
+{
+    /**
+     * \brief Tell the CPU that this is a spin loop, so it uses less power and leaves more of the core
+     * to the other hyper-thread
+     */
+    void pauseWhileSpinning() noexcept
+    {
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+        _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+        __asm__ __volatile__("yield");
+#endif
+    }
+}
+
+//==============================================================================
+class ForkJoinThreadPool::Worker::WakeEvent
+{
+public:
+#if JUCE_WINDOWS
+    WakeEvent() : semaphore{CreateSemaphore(nullptr, 0, std::numeric_limits<LONG>::max(), nullptr)}
+    {
+        jassert(semaphore != nullptr);
+    }
+
+    ~WakeEvent() { CloseHandle(semaphore); }
+
+    void signal() noexcept { ReleaseSemaphore(semaphore, 1, nullptr); }
+
+    void wait() noexcept { WaitForSingleObject(semaphore, INFINITE); }
+
+private:
+    HANDLE semaphore;
+#elif JUCE_MAC
+    WakeEvent() : semaphore{dispatch_semaphore_create(0)} { jassert(semaphore != nullptr); }
+
+    ~WakeEvent() { dispatch_release(semaphore); }
+
+    void signal() noexcept { dispatch_semaphore_signal(semaphore); }
+
+    void wait() noexcept { dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER); }
+
+private:
+    dispatch_semaphore_t semaphore;
+#else
+    WakeEvent()
+    {
+        const auto result = sem_init(&semaphore, 0, 0);
+        ignoreUnused(result);
+        jassert(result == 0);
+    }
+
+    ~WakeEvent() { sem_destroy(&semaphore); }
+
+    void signal() noexcept { sem_post(&semaphore); }
+
+    void wait() noexcept
+    {
+        while (sem_wait(&semaphore) != 0 && errno == EINTR)
+        {
+        }
+    }
+
+private:
+    sem_t semaphore{};
+#endif
+
+    JUCE_DECLARE_NON_COPYABLE(WakeEvent)
+};
+
+ForkJoinThreadPool::ForkJoinThreadPool(const int numWorkers)
+{
+    for (auto worker = 0; worker < numWorkers; ++worker)
+        workers.push_back(std::make_unique<Worker>());
+}
+
+//==============================================================================
+ForkJoinThreadPool::Worker::Worker() : Thread("Gamelanizer level worker"), wakeEvent{std::make_unique<WakeEvent>()}
+{
+    // the thread starting the jobs is the audio thread, which waits for this one
+    startThread(9);
+}
+
+ForkJoinThreadPool::Worker::~Worker()
+{
+    // Thread::notify doesn't reach a worker waiting on the semaphore
+    signalThreadShouldExit();
+    wakeEvent->signal();
+    stopThread(4000);
+}
+
+void ForkJoinThreadPool::Worker::startTask(void (*function)(void*, int), void* context, const int index)
+{
+    jassert(numTasksFinished.load() == numTasksStarted.load());
+    taskFunction = function;
+    taskContext = context;
+    taskIndex = index;
+    numTasksStarted.fetch_add(1);
+
+    // this is after numTasksStarted, and the worker checks it again after isWaiting, so one of them sees the other.
+    // If both do, the extra signal just makes the worker check for a task once more next time it parks
+    if (isWaiting.load())
+        wakeEvent->signal();
+}
+
+void ForkJoinThreadPool::Worker::waitForTask() const
+{
+    while (numTasksFinished.load() != numTasksStarted.load())
+        pauseWhileSpinning();
+}
+
+void ForkJoinThreadPool::Worker::run()
+{
+    uint32 numTasksRun = 0;
+    while (!threadShouldExit())
+    {
+        for (auto spin = 0; spin < numSpins && numTasksStarted.load() == numTasksRun; ++spin)
+            pauseWhileSpinning();
+
+        if (numTasksStarted.load() == numTasksRun)
+        {
+            isWaiting.store(true);
+            if (numTasksStarted.load() == numTasksRun)
+                wakeEvent->wait();
+            isWaiting.store(false);
+            continue;
+        }
+
+        taskFunction(taskContext, taskIndex);
+        numTasksFinished.store(++numTasksRun);
+    }
+}
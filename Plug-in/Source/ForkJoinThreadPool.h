@@ -0,0 +1,149 @@
+/*
+  ==============================================================================
+
+	This file is part of Gamelanizer.
+	Copyright (c) 2019 - Luke McDuffie Craig.
+
+	Gamelanizer is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Gamelanizer is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Gamelanizer. If not, see <https://www.gnu.org/licenses/>.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "../JuceLibraryCode/JuceHeader.h"
+
+/** \addtogroup Core
+ *  @{
+ */
+
+/**
+ * \brief A few persistent threads that run the tasks of a job alongside the thread that starts it. run() returns once
+ * every task has.
+ *
+ * After a task a worker spins for a while, because the next one usually comes with the next block, and then waits
+ * on a semaphore. The thread starting a job only signals the workers that are waiting, and signalling never blocks it,
+ * unlike Thread::notify, which locks a mutex that the worker might be holding.
+ * Nothing is allocated after the constructor.
+ */
+class ForkJoinThreadPool final
+{
+public:
+    /**
+     * \param numWorkers The number of threads besides the one that starts the jobs. They start right away.
+     */
+    explicit ForkJoinThreadPool(int numWorkers);
+
+    ForkJoinThreadPool(const ForkJoinThreadPool&) = delete;
+
+    ForkJoinThreadPool& operator=(const ForkJoinThreadPool&) = delete;
+
+    ForkJoinThreadPool(ForkJoinThreadPool&&) = delete;
+
+    ForkJoinThreadPool& operator=(ForkJoinThreadPool&&) = delete;
+
+    ~ForkJoinThreadPool() = default;
+
+    /**
+     * \brief Call task(index) for every index below numTasks, and return when they have all returned.
+     * The calling thread runs task 0 and each worker runs one of the others. Only one thread can call this at a time.
+     * \param numTasks No more than getNumWorkers() + 1
+     * \param task Called on several threads at once, so the tasks can't change any state they share
+     */
+    template <typename Task>
+    void run(const int numTasks, Task& task)
+    {
+        jassert(numTasks <= getNumWorkers() + 1);
+        for (auto index = 1; index < numTasks; ++index)
+            workers[static_cast<size_t>(index - 1)]->startTask(callTask<Task>, &task, index);
+
+        task(0);
+
+        for (auto index = 1; index < numTasks; ++index)
+            workers[static_cast<size_t>(index - 1)]->waitForTask();
+    }
+
+    [[nodiscard]] int getNumWorkers() const { return static_cast<int>(workers.size()); }
+
+private:
+    template <typename Task>
+    static void callTask(void* task, const int index) { (*static_cast<Task*>(task))(index); }
+
+    class Worker final : private Thread
+    {
+    public:
+        Worker();
+
+        Worker(const Worker&) = delete;
+
+        Worker& operator=(const Worker&) = delete;
+
+        Worker(Worker&&) = delete;
+
+        Worker& operator=(Worker&&) = delete;
+
+        ~Worker() override;
+
+        /**
+         * \brief Give this worker a task. It can't have one already.
+         */
+        void startTask(void (*function)(void*, int), void* context, int index);
+
+        /**
+         * \brief Spin until the task is done.
+         */
+        void waitForTask() const;
+
+    private:
+        /**
+         * \brief The platform's counting semaphore
+         */
+        class WakeEvent;
+
+        void run() override;
+
+        /**
+         * \brief How many times a worker checks for a new task before it waits on #wakeEvent.
+         * With the CPU's pause between the checks it's on the order of tens of microseconds.
+         */
+        static constexpr int numSpins{1 << 10};
+
+        void (*taskFunction)(void*, int){};
+
+        void* taskContext{};
+
+        int taskIndex{};
+
+        /**
+         * \brief The task fields are written before this is incremented, and read after it's seen.
+         */
+        std::atomic<uint32> numTasksStarted{};
+
+        std::atomic<uint32> numTasksFinished{};
+
+        /**
+         * \brief True while the worker is waiting on #wakeEvent
+         */
+        std::atomic<bool> isWaiting{};
+
+        std::unique_ptr<WakeEvent> wakeEvent;
+
+        JUCE_LEAK_DETECTOR(Worker)
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    JUCE_LEAK_DETECTOR(ForkJoinThreadPool)
+};
+
+/** @}*/
@@ -34,6 +34,7 @@ GamelanizerParameters::GamelanizerParameters()
     for (auto i = 0; i < GamelanizerConstants::maxLevels; ++i)
     {
         pitchIds[i] = "pitch" + String(i);
+        spectralPitchIds[i] = "spectralPitch" + String(i);
         taperIds[i] = "taper" + String(i);
         lpfIds[i] = "lpf" + String(i);
         hpfIds[i] = "hpf" + String(i);
@@ -51,6 +52,8 @@ String GamelanizerParameters::getPanId(const int level) { return panIds[level];
 
 String GamelanizerParameters::getPitchId(const int level) { return pitchIds[level]; }
 
+String GamelanizerParameters::getSpectralPitchId(const int level) { return spectralPitchIds[level]; }
+
 String GamelanizerParameters::getTaperId(const int level) { return taperIds[level]; }
 
 String GamelanizerParameters::getHpfId(const int level) { return hpfIds[level]; }
@@ -74,6 +77,8 @@ AudioProcessorValueTreeState::ParameterLayout GamelanizerParameters::createParam
     addFiltersToLayout(params);
     addPitchesToLayout(params);
     addDropsToLayout(params);
+    // added after the others, so the indices of the older parameters don't change
+    addSpectralPitchesToLayout(params);
 
     return {params.begin(), params.end()};
 }
@@ -271,4 +276,16 @@ void GamelanizerParameters::addDropsToLayout(std::vector<std::unique_ptr<RangedA
     }
 }
 
+void GamelanizerParameters::addSpectralPitchesToLayout(std::vector<std::unique_ptr<RangedAudioParameter>>& params)
+{
+    for (auto i = 0; i < GamelanizerConstants::maxLevels; ++i)
+    {
+        params.push_back(std::make_unique<AudioParameterBool>(
+                getSpectralPitchId(i),
+                "Spectral Pitch " + String(i + 1),
+                false) // default value
+        );
+    }
+}
+
 //==============================================================================
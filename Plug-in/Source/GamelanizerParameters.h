@@ -69,6 +69,11 @@ public:
      */
     String getPitchId(int level);
 
+    /**
+     * \param level The subdivision level
+     */
+    String getSpectralPitchId(int level);
+
     /**
      * \param level The subdivision level
      */
@@ -105,6 +110,7 @@ private:
     std::array<String, GamelanizerConstants::maxLevels + 1> panIds;
 
     std::array<String, GamelanizerConstants::maxLevels> pitchIds;
+    std::array<String, GamelanizerConstants::maxLevels> spectralPitchIds;
     std::array<String, GamelanizerConstants::maxLevels> taperIds;
     std::array<String, GamelanizerConstants::maxLevels> hpfIds;
     std::array<String, GamelanizerConstants::maxLevels> lpfIds;
@@ -125,6 +131,8 @@ private:
 
     void addDropsToLayout(std::vector<std::unique_ptr<RangedAudioParameter>>& params);
 
+    void addSpectralPitchesToLayout(std::vector<std::unique_ptr<RangedAudioParameter>>& params);
+
     //==============================================================================
     JUCE_LEAK_DETECTOR(GamelanizerParameters)
 };
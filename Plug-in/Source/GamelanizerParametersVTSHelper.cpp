@@ -37,6 +37,8 @@ GamelanizerParametersVtsHelper::GamelanizerParametersVtsHelper(AudioProcessorVal
     {
         taperParamRawPointers[i] = valueTreeState.getRawParameterValue(gamelanizerParameters.getTaperId(i));
         pitchParamRawPointers[i] = valueTreeState.getRawParameterValue(gamelanizerParameters.getPitchId(i));
+        spectralPitchParamRawPointers[i] = valueTreeState.getRawParameterValue(
+            gamelanizerParameters.getSpectralPitchId(i));
         lpfParamRawPointers[i] = valueTreeState.getRawParameterValue(gamelanizerParameters.getLpfId(i));
         hpfParamRawPointers[i] = valueTreeState.getRawParameterValue(gamelanizerParameters.getHpfId(i));
 
@@ -119,14 +121,40 @@ void GamelanizerParametersVtsHelper::updateSmoothers()
         hpfSmooth[i].setTargetValue(*hpfParamRawPointers[i]);
 }
 
-//==============================================================================
-float GamelanizerParametersVtsHelper::getGain(const int level) { return gainsSmooth[level].getNextValue(); }
+void GamelanizerParametersVtsHelper::prepareRamps(const int maxNumSamples)
+{
+    gainsRampBuffer.setSize(GamelanizerConstants::maxLevels + 1, maxNumSamples);
+    pansRampBuffer.setSize(GamelanizerConstants::maxLevels + 1, maxNumSamples);
+    mutesRampBuffer.setSize(GamelanizerConstants::maxLevels + 1, maxNumSamples);
+    tapersRampBuffer.setSize(GamelanizerConstants::maxLevels, maxNumSamples);
+}
 
-float GamelanizerParametersVtsHelper::getPan(const int level) { return pansSmooth[level].getNextValue(); }
+void GamelanizerParametersVtsHelper::generateRamps(const int numSamples)
+{
+    jassert(numSamples <= gainsRampBuffer.getNumSamples());
+    for (auto i = 0; i < GamelanizerConstants::maxLevels + 1; ++i)
+    {
+        gainsRamp[i] = generateRamp(gainsSmooth[i], gainsRampBuffer.getWritePointer(i), numSamples);
+        pansRamp[i] = generateRamp(pansSmooth[i], pansRampBuffer.getWritePointer(i), numSamples);
+        mutesRamp[i] = generateRamp(mutesSmooth[i], mutesRampBuffer.getWritePointer(i), numSamples);
+    }
 
-float GamelanizerParametersVtsHelper::getMute(const int level) { return mutesSmooth[level].getNextValue(); }
+    for (auto i = 0; i < GamelanizerConstants::maxLevels; ++i)
+        tapersRamp[i] = generateRamp(tapersSmooth[i], tapersRampBuffer.getWritePointer(i), numSamples);
+}
 
-float GamelanizerParametersVtsHelper::getTaper(const int level) { return tapersSmooth[level].getNextValue(); }
+GamelanizerParametersVtsHelper::Ramp GamelanizerParametersVtsHelper::generateRamp(
+    SmoothFloat& smoother, float* rampBuffer, const int numSamples)
+{
+    // getNextValue wouldn't change anything, so skip it
+    if (!smoother.isSmoothing())
+        return {nullptr, smoother.getTargetValue()};
+
+    // the smoothing might end partway through, then getNextValue just returns the target
+    for (auto i = 0; i < numSamples; ++i)
+        rampBuffer[i] = smoother.getNextValue();
+    return {rampBuffer, smoother.getCurrentValue()};
+}
 
 GamelanizerParametersVtsHelper::ParameterAndWasChanged GamelanizerParametersVtsHelper::getPitch(
     const int level, const bool smoothed)
@@ -144,6 +172,11 @@ GamelanizerParametersVtsHelper::ParameterAndWasChanged GamelanizerParametersVtsH
     return {nextPitch, nextPitch != previousPitch};
 }
 
+bool GamelanizerParametersVtsHelper::isPitchShiftedSpectrally(const int level) const
+{
+    return *spectralPitchParamRawPointers[level] >= 0.5f;
+}
+
 GamelanizerParametersVtsHelper::ParameterAndWasChanged GamelanizerParametersVtsHelper::getLpFilterCutoff(
     const int level)
 {
@@ -180,6 +213,25 @@ GamelanizerParametersVtsHelper::ParameterAndWasChanged GamelanizerParametersVtsH
     return {nextCutoff, previousCutoff != nextCutoff};
 }
 
+bool GamelanizerParametersVtsHelper::levelsHaveIdenticalPhaseVocoderInput(const int levelA, const int levelB) const
+{
+    const auto& taperA = tapersSmooth[levelA];
+    const auto& taperB = tapersSmooth[levelB];
+    const auto& pitchA = pitchesSmooth[levelA];
+    const auto& pitchB = pitchesSmooth[levelB];
+    return !taperA.isSmoothing() && !taperB.isSmoothing()
+        && !pitchA.isSmoothing() && !pitchB.isSmoothing()
+        && taperA.getCurrentValue() == taperB.getCurrentValue()
+        && pitchA.getCurrentValue() == pitchB.getCurrentValue();
+}
+
+bool GamelanizerParametersVtsHelper::isInaudible(const int level) const
+{
+    const auto isGainZero = !gainsSmooth[level].isSmoothing() && gainsSmooth[level].getCurrentValue() == 0.0f;
+    const auto isMuted = !mutesSmooth[level].isSmoothing() && mutesSmooth[level].getCurrentValue() >= 1.0f;
+    return isGainZero || isMuted;
+}
+
 float GamelanizerParametersVtsHelper::getDropNote(const int level, const int note)
 {
     return *dropParamRawPointers[level][note];
@@ -57,6 +57,23 @@ public:
         bool wasChanged;
     };
 
+    /**
+     * \brief The values of a smoother for each sample of a segment. When the smoother isn't moving
+     * there is no buffer and every sample has the same value.
+     */
+    struct Ramp
+    {
+        /**
+         * \brief The value for each sample, or nullptr if the ramp is constant
+         */
+        const float* values;
+        float value;
+
+        [[nodiscard]] bool isConstant() const { return values == nullptr; }
+
+        float operator[](const int sample) const { return values == nullptr ? value : values[sample]; }
+    };
+
     //==============================================================================
     void resetSmoothers(double sampleRate);
 
@@ -68,24 +85,55 @@ public:
 
     void updateSmoothers();
 
+    /**
+     * \brief Allocate the ramp buffers. Called from prepareToPlay.
+     * \param maxNumSamples The length of the longest segment that generateRamps will be called with
+     */
+    void prepareRamps(int maxNumSamples);
+
+    /**
+     * \brief Advance the gain, pan, mute and taper smoothers by a segment and store their values in ramps.
+     * The ramps stay valid until this is called again. A smoother that isn't moving costs nothing per sample.
+     */
+    void generateRamps(int numSamples);
+
     //==============================================================================
-    float getGain(int level);
+    [[nodiscard]] const Ramp& getGainRamp(int level) const { return gainsRamp[level]; }
 
-    float getPan(int level);
+    [[nodiscard]] const Ramp& getPanRamp(int level) const { return pansRamp[level]; }
 
-    float getMute(int level);
+    [[nodiscard]] const Ramp& getMuteRamp(int level) const { return mutesRamp[level]; }
 
     //==============================================================================	
     float getDropNote(int level, int note);
 
-    float getTaper(int level);
+    [[nodiscard]] const Ramp& getTaperRamp(int level) const { return tapersRamp[level]; }
 
     ParameterAndWasChanged getPitch(int level, bool smoothed = true);
 
+    /**
+     * \brief Whether a subdivision level should shift its pitch in the frequency domain instead of by resampling.
+     * See PhaseVocoderBase::PitchShiftingMethod
+     */
+    [[nodiscard]] bool isPitchShiftedSpectrally(int level) const;
+
     ParameterAndWasChanged getLpFilterCutoff(int level);
 
     ParameterAndWasChanged getHpFilterCutoff(int level);
 
+    /**
+     * \brief Whether two subdivision levels currently feed identical input to their phase vocoders.
+     * That is the case when their tapers and pitches are equal and neither is being smoothed.
+     */
+    [[nodiscard]] bool levelsHaveIdenticalPhaseVocoderInput(int levelA, int levelB) const;
+
+    /**
+     * \brief Whether a level is muted or has 0 gain, and that isn't being smoothed.
+     * The individual outputs are after the gain and mute, so the level can't be heard anywhere.
+     * \param level 0 is the base level
+     */
+    [[nodiscard]] bool isInaudible(int level) const;
+
     //==============================================================================
 private:
     //==============================================================================
@@ -109,6 +157,22 @@ private:
     std::array<float*, GamelanizerConstants::maxLevels> pitchParamRawPointers{};
     std::array<SmoothFloat, GamelanizerConstants::maxLevels> pitchesSmooth{};
     std::array<float, GamelanizerConstants::maxLevels> pitchesPrevious{};
+
+    std::array<float*, GamelanizerConstants::maxLevels> spectralPitchParamRawPointers{};
+    //==============================================================================
+    AudioBuffer<float> gainsRampBuffer;
+    std::array<Ramp, GamelanizerConstants::maxLevels + 1> gainsRamp{};
+
+    AudioBuffer<float> pansRampBuffer;
+    std::array<Ramp, GamelanizerConstants::maxLevels + 1> pansRamp{};
+
+    AudioBuffer<float> mutesRampBuffer;
+    std::array<Ramp, GamelanizerConstants::maxLevels + 1> mutesRamp{};
+
+    AudioBuffer<float> tapersRampBuffer;
+    std::array<Ramp, GamelanizerConstants::maxLevels> tapersRamp{};
+
+    static Ramp generateRamp(SmoothFloat& smoother, float* rampBuffer, int numSamples);
     //==============================================================================
 
     /**
@@ -0,0 +1,128 @@
+/*
+  ==============================================================================
+
+	This file is part of Gamelanizer.
+	Copyright (c) 2019 - Luke McDuffie Craig.
+
+	Gamelanizer is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Gamelanizer is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Gamelanizer. If not, see <https://www.gnu.org/licenses/>.
+
+  ==============================================================================
+*/
+
+#include "OutputMixMatrix.h"
+
+void OutputMixMatrix::prepare(const int numHostOutputChannels, const int maxNumSamples)
+{
+    numOutputChannels = jmin(numHostOutputChannels, static_cast<int>(maxOutputChannels));
+    // the stereo out is always there
+    jassert(numOutputChannels >= firstIndividualOutputChannel);
+    entriesBuffer.setSize(3 * numInputs, maxNumSamples);
+}
+
+void OutputMixMatrix::update(const GamelanizerParametersVtsHelper& parameters, const int numSamples)
+{
+    jassert(numSamples > 0 && numSamples <= entriesBuffer.getNumSamples());
+    for (auto input = 0; input < numInputs; ++input)
+    {
+        const auto& gain = parameters.getGainRamp(input);
+        const auto& mute = parameters.getMuteRamp(input);
+        const auto& pan = parameters.getPanRamp(input);
+
+        if (gain.isConstant() && mute.isConstant())
+        {
+            gains[input] = {nullptr, gain.value * (1.0f - mute.value)};
+        }
+        else
+        {
+            auto* gainValues = entriesBuffer.getWritePointer(2 * numInputs + input);
+            for (auto i = 0; i < numSamples; ++i)
+                gainValues[i] = gain[i] * (1.0f - mute[i]);
+            gains[input] = {gainValues, gainValues[numSamples - 1]};
+        }
+
+        if (pan.isConstant())
+        {
+            const auto panAmplitude = pan.value / 200.0f + 0.5f;
+            leftGains[input] = {nullptr, std::sqrt(1.0f - panAmplitude)};
+            rightGains[input] = {nullptr, std::sqrt(panAmplitude)};
+        }
+        else
+        {
+            auto* left = entriesBuffer.getWritePointer(input);
+            auto* right = entriesBuffer.getWritePointer(numInputs + input);
+            for (auto i = 0; i < numSamples; ++i)
+            {
+                const auto panAmplitude = pan[i] / 200.0f + 0.5f;
+                left[i] = std::sqrt(1.0f - panAmplitude);
+                right[i] = std::sqrt(panAmplitude);
+            }
+            leftGains[input] = {left, left[numSamples - 1]};
+            rightGains[input] = {right, right[numSamples - 1]};
+        }
+    }
+}
+
+void OutputMixMatrix::applyGain(const int input, float* samples, const int numSamples) const
+{
+    const auto& entry = gains[input];
+    if (entry.isConstant())
+        FloatVectorOperations::multiply(samples, entry.value, numSamples);
+    else
+        FloatVectorOperations::multiply(samples, entry.values, numSamples);
+}
+
+void OutputMixMatrix::mix(const std::array<const float*, numInputs>& inputs, float* const* outputs,
+                          const int numSamples) const
+{
+    mixRow(leftGains, inputs, outputs[leftOutputChannel], numSamples);
+    mixRow(rightGains, inputs, outputs[rightOutputChannel], numSamples);
+
+    // the individual outs that were pruned in prepare aren't in numOutputChannels.
+    // The base's individual out is only written if there are more than 3 channels, so a third channel stays silent
+    const auto hasBaseIndividualOutput = numOutputChannels > firstIndividualOutputChannel + 1;
+    for (auto input = 0; input < numOutputChannels - firstIndividualOutputChannel; ++input)
+    {
+        auto* output = outputs[firstIndividualOutputChannel + input];
+        const auto* samples = inputs[input];
+        if (input == 0 && !hasBaseIndividualOutput)
+            FloatVectorOperations::clear(output, numSamples);
+        else
+            FloatVectorOperations::copy(output, samples, numSamples);
+    }
+}
+
+void OutputMixMatrix::mixRow(const std::array<Entry, numInputs>& row,
+                             const std::array<const float*, numInputs>& inputs, float* output, const int numSamples)
+{
+    // the first input overwrites the output, the rest are added to it
+    for (auto input = 0; input < numInputs; ++input)
+    {
+        const auto* samples = inputs[input];
+        const auto& entry = row[input];
+        if (input > 0)
+        {
+            if (entry.isConstant())
+                FloatVectorOperations::addWithMultiply(output, samples, entry.value, numSamples);
+            else
+                FloatVectorOperations::addWithMultiply(output, samples, entry.values, numSamples);
+        }
+        else
+        {
+            if (entry.isConstant())
+                FloatVectorOperations::multiply(output, samples, entry.value, numSamples);
+            else
+                FloatVectorOperations::multiply(output, samples, entry.values, numSamples);
+        }
+    }
+}
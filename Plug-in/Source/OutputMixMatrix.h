@@ -0,0 +1,142 @@
+/*
+  ==============================================================================
+
+	This file is part of Gamelanizer.
+	Copyright (c) 2019 - Luke McDuffie Craig.
+
+	Gamelanizer is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Gamelanizer is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Gamelanizer. If not, see <https://www.gnu.org/licenses/>.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "GamelanizerConstants.h"
+#include "GamelanizerParametersVTSHelper.h"
+
+/** \addtogroup Core
+ *  @{
+ */
+
+/**
+ * \brief Mixes the base level and the subdivision levels into the stereo out and the individual outs.
+ *
+ * A level's gain times (1 - mute) is applied to it with applyGain before the subdivision levels are filtered, like the
+ * per-sample loop did: the gain and mute ramps don't commute with the filters' state. The mix is then a matrix from the
+ * 5 levels to the 7 output channels. A level's column has its left and right equal-power pan gains for the stereo out,
+ * and 1 for its own individual out.
+ * The gains and the matrix are built once per segment from the smoothers' ramps. Only the entries of levels whose gain,
+ * mute or pan is being smoothed have a value for every sample, the rest are scalars.
+ */
+class OutputMixMatrix
+{
+public:
+    OutputMixMatrix() = default;
+
+    OutputMixMatrix(const OutputMixMatrix&) = delete;
+
+    OutputMixMatrix& operator=(const OutputMixMatrix&) = delete;
+
+    OutputMixMatrix(OutputMixMatrix&&) = delete;
+
+    OutputMixMatrix& operator=(OutputMixMatrix&&) = delete;
+
+    ~OutputMixMatrix() = default;
+
+    //==============================================================================
+    /**
+     * \brief The base level and then each subdivision level, numbered like the parameters
+     */
+    static constexpr int numInputs{GamelanizerConstants::maxLevels + 1};
+
+    /**
+     * \brief The output channels, the stereo out and then the individual out of each input.
+     * The base's individual out is silent unless there are more than 3 channels.
+     */
+    enum OutputChannel
+    {
+        leftOutputChannel,
+        rightOutputChannel,
+        firstIndividualOutputChannel,
+        maxOutputChannels = firstIndividualOutputChannel + numInputs
+    };
+
+    /**
+     * \brief Prune the individual outs that the host didn't enable and allocate the per-sample entries.
+     * Called from GamelanizerAudioProcessor::prepareToPlay
+     * \param numOutputChannels The number of output channels the host will give
+     * \param maxNumSamples The longest segment
+     */
+    void prepare(int numOutputChannels, int maxNumSamples);
+
+    /**
+     * \return The number of output channels that are written, at most #maxOutputChannels
+     */
+    [[nodiscard]] int getNumOutputChannels() const { return numOutputChannels; }
+
+    /**
+     * \brief Build the gains and the matrix for the next segment from the gain, mute and pan ramps.
+     * Call it after GamelanizerParametersVtsHelper::generateRamps
+     */
+    void update(const GamelanizerParametersVtsHelper& parameters, int numSamples);
+
+    /**
+     * \brief Multiply a segment of an input by its gain times (1 - mute), in place. Call it before filtering.
+     * \param input The base level is 0, subdivision level n is n + 1
+     * \param samples The segment of the input
+     * \param numSamples The length of the segment
+     */
+    void applyGain(int input, float* samples, int numSamples) const;
+
+    /**
+     * \brief Mix a segment of every input into the output channels, overwriting them.
+     * The inputs have already had applyGain applied.
+     * \param inputs The segment of each input
+     * \param outputs getNumOutputChannels() write pointers to the segment in the outgoing audio block
+     * \param numSamples The length of the segment
+     */
+    void mix(const std::array<const float*, numInputs>& inputs, float* const* outputs, int numSamples) const;
+
+private:
+    using Entry = GamelanizerParametersVtsHelper::Ramp;
+
+    /**
+     * \brief Each input's gain times (1 - mute)
+     */
+    std::array<Entry, numInputs> gains{};
+
+    /**
+     * \brief The stereo rows of the matrix. The individual outs are just copies of their inputs.
+     */
+    std::array<Entry, numInputs> leftGains{};
+    std::array<Entry, numInputs> rightGains{};
+
+    /**
+     * \brief The per-sample entries: the left gains, then the right gains, then the gains
+     */
+    AudioBuffer<float> entriesBuffer;
+
+    int numOutputChannels{2};
+
+    /**
+     * \brief Mix every active input into one output channel with one row of the matrix
+     */
+    static void mixRow(const std::array<Entry, numInputs>& row, const std::array<const float*, numInputs>& inputs,
+                       float* output, int numSamples);
+
+    //==============================================================================
+    JUCE_LEAK_DETECTOR(OutputMixMatrix)
+};
+
+/** @}*/
@@ -0,0 +1,211 @@
+/*
+  ==============================================================================
+
+	This file is part of Gamelanizer.
+	Copyright (c) 2019 - Luke McDuffie Craig.
+
+	Gamelanizer is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Gamelanizer is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Gamelanizer. If not, see <https://www.gnu.org/licenses/>.
+
+  ==============================================================================
+*/
+#if MeasurePerformance
+#include "PerformanceBenchmarks.h"
+#include "FftBackend.h"
+#include "GamelanizerConstants.h"
+#include "PolyphaseSincInterpolator.h"
+#include "SubdivisionLevel.h"
+#include <chrono>
+#include <set>
+
+void PerformanceBenchmarks::runAll()
+{
+    MemoryOutputStream log;
+    log << "benchmark,implementation,size,nanosecondsPerIteration,maxDifference" << newLine;
+
+    benchmarkFft(log);
+    benchmarkResamplers(log);
+
+    writeLog(log, String("Benchmarks") + FftBackend::getName());
+}
+
+void PerformanceBenchmarks::benchmarkFft(MemoryOutputStream& log)
+{
+    constexpr auto nIterations = 10000;
+    Random random(1);
+
+    // only benchmark each distinct size once
+    const std::set<int> fftOrders(SubdivisionLevel::fftOrders.begin(), SubdivisionLevel::fftOrders.end());
+    for (auto fftOrder : fftOrders)
+    {
+        FftBackend backend(fftOrder);
+        dsp::FFT reference(fftOrder);
+        const auto fftSize = backend.getSize();
+
+        std::vector<float> input(static_cast<size_t>(fftSize));
+        for (auto& sample : input)
+            sample = random.nextFloat() * 2.0f - 1.0f;
+
+        std::vector<float> backendInOut(2 * static_cast<size_t>(fftSize));
+        std::vector<float> referenceInOut(2 * static_cast<size_t>(fftSize));
+
+        // check that the backend matches JUCE's layout and scaling
+        std::copy(input.begin(), input.end(), backendInOut.begin());
+        std::copy(input.begin(), input.end(), referenceInOut.begin());
+        backend.performRealOnlyForwardTransform(backendInOut.data());
+        reference.performRealOnlyForwardTransform(referenceInOut.data(), true);
+        auto maxForwardDifference = 0.0f;
+        for (auto i = 0; i < fftSize + 2; ++i)
+            maxForwardDifference = jmax(maxForwardDifference, std::abs(backendInOut[i] - referenceInOut[i]));
+
+        backend.performRealOnlyInverseTransform(backendInOut.data());
+        auto maxRoundTripDifference = 0.0f;
+        for (auto i = 0; i < fftSize; ++i)
+            maxRoundTripDifference = jmax(maxRoundTripDifference, std::abs(backendInOut[i] - input[i]));
+
+        const auto timeIterations = [&](auto&& forwardAndInverse)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            for (auto iteration = 0; iteration < nIterations; ++iteration)
+            {
+                std::copy(input.begin(), input.end(), backendInOut.begin());
+                forwardAndInverse();
+            }
+            const auto end = std::chrono::steady_clock::now();
+            return static_cast<int64>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()
+                / nIterations);
+        };
+
+        const auto backendTime = timeIterations([&]
+        {
+            backend.performRealOnlyForwardTransform(backendInOut.data());
+            backend.performRealOnlyInverseTransform(backendInOut.data());
+        });
+        const auto referenceTime = timeIterations([&]
+        {
+            reference.performRealOnlyForwardTransform(backendInOut.data(), true);
+            reference.performRealOnlyInverseTransform(backendInOut.data());
+        });
+
+        log << "fft," << FftBackend::getName() << "," << fftSize << "," << String(backendTime) << ","
+            << String(jmax(maxForwardDifference, maxRoundTripDifference)) << newLine;
+        log << "fft,juce," << fftSize << "," << String(referenceTime) << ",0" << newLine;
+
+        Logger::writeToLog("FFT " + String(fftSize) + ": " + FftBackend::getName() + " " + String(backendTime)
+            + " ns, juce " + String(referenceTime) + " ns");
+    }
+}
+
+void PerformanceBenchmarks::benchmarkResamplers(MemoryOutputStream& log)
+{
+    constexpr auto nIterations = 2000;
+    constexpr auto hopSize = 256;
+
+    // the default pitch of each level, and the lowest pitch
+    std::vector<float> pitchesInCents{GamelanizerConstants::minPitchShiftCents};
+    for (auto level = 0; level < GamelanizerConstants::maxLevels; ++level)
+        pitchesInCents.push_back(1200.0f * (level + 1.0f));
+
+    for (auto cents : pitchesInCents)
+    {
+        const auto speedRatio = std::pow(2.0, cents / 1200.0);
+
+        // in cycles per input sample
+        const auto passbandFrequency = 0.25 * 0.5 / jmax(1.0, speedRatio);
+        const auto stopbandFrequency = speedRatio > 1.0 ? 0.5 * (0.5 + 0.5 / speedRatio) : 0.0;
+        const auto idealOutput = [&](const double position)
+        {
+            return 0.5 * std::sin(MathConstants<double>::twoPi * passbandFrequency * position);
+        };
+
+        // resample enough hops to fill the interpolator's history with the test signal, then compare one more hop
+        // to the ideal output, then time the resampling of one hop
+        const auto measure = [&](auto& interpolator, const int delayInSamples)
+        {
+            const auto numWarmUpHops = 1 + static_cast<int>(std::ceil(2.0 * delayInSamples / (hopSize * speedRatio)));
+            const auto numInputSamples = static_cast<int>(std::ceil(hopSize * speedRatio * (numWarmUpHops + 1))) + 8;
+            std::vector<float> input(static_cast<size_t>(numInputSamples));
+            for (auto n = 0; n < numInputSamples; ++n)
+                input[n] = static_cast<float>(idealOutput(n)
+                    + 0.5 * std::sin(MathConstants<double>::twoPi * stopbandFrequency * n));
+            std::vector<float> output(static_cast<size_t>(hopSize));
+
+            interpolator.reset();
+            auto numUsed = 0;
+            for (auto hop = 0; hop <= numWarmUpHops; ++hop)
+                numUsed += interpolator.process(speedRatio, input.data() + numUsed, output.data(), hopSize);
+
+            auto maxDifference = 0.0f;
+            for (auto i = 0; i < hopSize; ++i)
+            {
+                const auto position = (numWarmUpHops * hopSize + i) * speedRatio - delayInSamples;
+                maxDifference = jmax(maxDifference, std::abs(output[i] - static_cast<float>(idealOutput(position))));
+            }
+
+            const auto start = std::chrono::steady_clock::now();
+            for (auto iteration = 0; iteration < nIterations; ++iteration)
+            {
+                interpolator.reset();
+                interpolator.process(speedRatio, input.data(), output.data(), hopSize);
+            }
+            const auto end = std::chrono::steady_clock::now();
+            const auto time = static_cast<int64>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()
+                / nIterations);
+            return std::make_pair(time, maxDifference);
+        };
+
+        CatmullRomInterpolator catmullRom;
+        // it interpolates between the third and second newest samples, except when it just copies at a ratio of 1
+        const auto catmullRomResult = measure(catmullRom, speedRatio == 1.0 ? 0 : 2);
+        log << "resampler,catmullRom," << String(cents) << "," << String(catmullRomResult.first) << ","
+            << String(catmullRomResult.second) << newLine;
+        Logger::writeToLog("Resampler " + String(cents) + " cents: catmullRom " + String(catmullRomResult.first)
+            + " ns, max difference " + String(catmullRomResult.second));
+
+        const std::pair<PolyphaseSincInterpolator::Quality, const char*> qualities[]{
+            {PolyphaseSincInterpolator::draftQuality, "sincDraft"},
+            {PolyphaseSincInterpolator::normalQuality, "sincNormal"},
+            {PolyphaseSincInterpolator::highQuality, "sincHigh"}
+        };
+        for (const auto& quality : qualities)
+        {
+            PolyphaseSincInterpolator sinc(quality.first);
+            const auto sincResult = measure(sinc, sinc.getDelayInSamples());
+            log << "resampler," << quality.second << "," << String(cents) << "," << String(sincResult.first) << ","
+                << String(sincResult.second) << newLine;
+            Logger::writeToLog("Resampler " + String(cents) + " cents: " + quality.second + " "
+                + String(sincResult.first) + " ns, max difference " + String(sincResult.second));
+        }
+    }
+}
+
+void PerformanceBenchmarks::writeLog(const MemoryOutputStream& log, const String& filename)
+{
+    auto benchmarkLog{
+        File::getSpecialLocation(File::SpecialLocationType::userDesktopDirectory)
+        .getChildFile("GamelanizerLogs").getNonexistentChildFile(filename, ".csv", true)
+    };
+
+    const auto created = benchmarkLog.create();
+    if (created.wasOk())
+    {
+        FileOutputStream out(benchmarkLog);
+        if (!out.failedToOpen())
+            out << log.toString();
+    }
+    else
+    {
+        Logger::writeToLog(created.getErrorMessage());
+    }
+}
+#endif
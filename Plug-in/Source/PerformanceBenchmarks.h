@@ -0,0 +1,70 @@
+/*
+  ==============================================================================
+
+	This file is part of Gamelanizer.
+	Copyright (c) 2019 - Luke McDuffie Craig.
+
+	Gamelanizer is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Gamelanizer is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Gamelanizer. If not, see <https://www.gnu.org/licenses/>.
+
+  ==============================================================================
+*/
+#pragma once
+
+#if MeasurePerformance
+#include "../JuceLibraryCode/JuceHeader.h"
+
+/** \addtogroup Utility
+ *  @{
+ */
+
+/**
+ * \brief Offline micro-benchmarks of the DSP building blocks. They are run once when the plug-in is created 
+ * and only exist when the MeasurePerformance preprocessor definition is set, like PerformanceMeasures. 
+ * The results are written to a .csv in the same GamelanizerLogs folder on the users desktop, and logged with
+ * Logger::writeToLog, because the benchmarks only mean something in release builds, where DBG is compiled out.
+ */
+struct PerformanceBenchmarks
+{
+    /**
+     * \brief Run all of the benchmarks and write their results.
+     */
+    static void runAll();
+
+    /**
+     * \brief Time a forward and inverse real transform with the FftBackend that was built and with JUCE's dsp::FFT,
+     * at every size in SubdivisionLevel::fftOrders. The largest difference between the two outputs is logged too.
+     * \param log Where to write the csv rows
+     */
+    static void benchmarkFft(MemoryOutputStream& log);
+
+    /**
+     * \brief Time the resampling of one analysis hop with CatmullRomInterpolator and with every PolyphaseSincInterpolator::Quality,
+     * at the default pitch of each subdivision level and at the smallest pitch. The input is a tone in the output's passband
+     * plus, when the pitch is shifted up, a tone above the output's Nyquist frequency.
+     * The largest difference from the ideal output (just the first tone, delayed by the interpolator) is logged too.
+     * \param log Where to write the csv rows. The size column is the pitch shift in cents.
+     */
+    static void benchmarkResamplers(MemoryOutputStream& log);
+
+private:
+    /**
+     * \brief Write the log to a new file on the users desktop
+     * \param log The csv rows
+     * \param filename The filename without the extension
+     */
+    static void writeLog(const MemoryOutputStream& log, const String& filename);
+};
+
+/** @}*/
+#endif
@@ -21,6 +21,7 @@
 */
 #if MeasurePerformance
 #include "PerformanceMeasures.h"
+#include "FftBackend.h"
 
 void PerformanceMeasures::reset()
 {
@@ -53,7 +54,7 @@ void PerformanceMeasures::finishMeasurements(
 #else
 			auto filename = String("Release");
 #endif
-            filename = filename + String(bufferSize) + (JUCE_DSP_USE_INTEL_MKL ? "MKL" : "Fallback");
+            filename = filename + String(bufferSize) + FftBackend::getName();
 
 			// make a new measurement log file for each playback
             auto measurementLog{
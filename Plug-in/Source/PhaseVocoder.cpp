@@ -22,45 +22,113 @@
 
 #include "PhaseVocoder.h"
 #include "ModuloSameSignAsDivisor.h"
+#include "SimdPhaseMath.h"
 #include "WindowingFunctions.h"
 //==============================================================================
-PhaseVocoder::PhaseVocoder(const int levelNumber,
-                           const float effectiveTimeScaleFactor) : analysisFrames{levelNumber},
-                                                                   effectiveTimeScaleFactor{effectiveTimeScaleFactor},
-                                                                   resampler{analysisFrames.analysisHopSize}
+template <int fftOrder>
+PhaseVocoder<fftOrder>::PhaseVocoder(const int levelNumber,
+                                     const float effectiveTimeScaleFactor) : analysisFrames{levelNumber},
+                                                                             effectiveTimeScaleFactor{
+                                                                                 effectiveTimeScaleFactor
+                                                                             },
+                                                                             resampler{
+                                                                                 static_cast<int>(fftSize /
+                                                                                     AnalysisFrames::
+                                                                                     minAnalysisOverlapFactor)
+                                                                             }
 {
+    // the bins can only be shifted in the vectorized path, so the scalar one always resamples
+    if (binScalingMethod != vectorized)
+        resampler.allocateInputQueue();
+    resampler.setAnalysisHopSize(analysisFrames.analysisHopSize);
     WindowingFunctions::fillWithNonsymmetricHannWindow(fft.window.data, fftSize);
 }
 
-void PhaseVocoder::initParams(const float initPitchShiftFactor)
+template <int fftOrder>
+void PhaseVocoder<fftOrder>::initParams(const float initPitchShiftFactor)
 {
     synthesisHopSize.reset();
 
     const auto pitchShiftFactorCentsLocal = 1200.0f * std::log2(initPitchShiftFactor);
     nextPitchShiftFactorCents.store(pitchShiftFactorCentsLocal);
 
+    applyPitchShiftingMethod();
     setParams(initPitchShiftFactor, pitchShiftFactorCentsLocal);
+    // this is called before playback, so any partial analysis frame can be discarded
+    analysisFrames.reset();
+    updateAnalysisOverlapFactor();
 }
 
-void PhaseVocoder::setParams(const float newPitchShiftFactor, const float newPitchShiftFactorCents)
+template <int fftOrder>
+void PhaseVocoder<fftOrder>::setParams(const float newPitchShiftFactor, const float newPitchShiftFactorCents)
 {
     pitchShiftFactor = newPitchShiftFactor;
 
     pitchShiftFactorCents = newPitchShiftFactorCents;
 
-    actualTimeScaleFactor = effectiveTimeScaleFactor * pitchShiftFactor;
+    // shifting the bins doesn't change the duration, so the time scale doesn't have to make up for it
+    actualTimeScaleFactor = pitchShiftingMethod == spectralPitchShift
+                                ? effectiveTimeScaleFactor
+                                : effectiveTimeScaleFactor * pitchShiftFactor;
 
     synthesisOverlapFactor = analysisFrames.analysisOverlapFactorActual / actualTimeScaleFactor;
 
     synthesisHopSize.exactValue = analysisFrames.analysisHopSize * actualTimeScaleFactor;
 
-    resampler.updatePitchShiftFactor(newPitchShiftFactor);
+    if (pitchShiftingMethod == resamplingPitchShift)
+        resampler.updatePitchShiftFactor(newPitchShiftFactor);
 
     fft.window.amplitudeCompensationScale = static_cast<float>(synthesisHopSize.exactValue
         / FftStruct::FftWindow::squaredWindowSum);
 }
 
-void PhaseVocoder::loadNextParams()
+template <int fftOrder>
+void PhaseVocoder<fftOrder>::updateAnalysisOverlapFactor()
+{
+    auto newAnalysisOverlapFactor = analysisFrames.maxAnalysisOverlapFactor;
+    if (analysisOverlapMethod == pitchAdaptiveOverlap)
+    {
+        // the smallest power of two that keeps o_s >= minSynthesisOverlapFactor
+        const auto wanted = nextPowerOfTwo(static_cast<int>(std::ceil(minSynthesisOverlapFactor
+            * actualTimeScaleFactor)));
+        newAnalysisOverlapFactor = jlimit(AnalysisFrames::minAnalysisOverlapFactor,
+                                          analysisFrames.maxAnalysisOverlapFactor,
+                                          static_cast<double>(wanted));
+    }
+
+    if (analysisFrames.setAnalysisOverlapFactor(newAnalysisOverlapFactor))
+    {
+        resampler.setAnalysisHopSize(analysisFrames.analysisHopSize);
+        // the synthesis overlap and hop size depend on the analysis ones
+        setParams(static_cast<float>(pitchShiftFactor), static_cast<float>(pitchShiftFactorCents));
+    }
+}
+
+template <int fftOrder>
+void PhaseVocoder<fftOrder>::setPitchShiftingMethod(const PitchShiftingMethod newPitchShiftingMethod)
+{
+    // the bins are only shifted in the vectorized path
+    nextPitchShiftingMethod = binScalingMethod == vectorized ? newPitchShiftingMethod : resamplingPitchShift;
+}
+
+template <int fftOrder>
+bool PhaseVocoder<fftOrder>::applyPitchShiftingMethod()
+{
+    // the resampler's input queue isn't allocated on this thread, so until it's there the bins are shifted
+    const auto newPitchShiftingMethod = nextPitchShiftingMethod == resamplingPitchShift && !resampler.hasInputQueue()
+                                            ? spectralPitchShift
+                                            : nextPitchShiftingMethod;
+    if (newPitchShiftingMethod == pitchShiftingMethod)
+        return false;
+
+    pitchShiftingMethod = newPitchShiftingMethod;
+    // whatever is left on the input queue is from before the switch, and it won't be used by the spectral method
+    resampler.fullReset();
+    return true;
+}
+
+template <int fftOrder>
+void PhaseVocoder<fftOrder>::loadNextParams()
 {
     const auto nextPitchShiftFactorCentsLocal = nextPitchShiftFactorCents.load();
     if (nextPitchShiftFactorCentsLocal != pitchShiftFactorCents)
@@ -70,20 +138,27 @@ void PhaseVocoder::loadNextParams()
     }
 }
 
-void PhaseVocoder::queueParams(const float newNextPitchShiftFactorCents)
+template <int fftOrder>
+void PhaseVocoder<fftOrder>::queueParams(const float newNextPitchShiftFactorCents)
 {
     nextPitchShiftFactorCents.store(newNextPitchShiftFactorCents);
 }
 
-void PhaseVocoder::resetBetweenBeats()
+template <int fftOrder>
+void PhaseVocoder<fftOrder>::resetBetweenBeats()
 {
     previousFramePhases.initialized = false;
     analysisFrames.reset();
     resampler.resetBetweenBeats();
+    if (applyPitchShiftingMethod())
+        setParams(static_cast<float>(pitchShiftFactor), static_cast<float>(pitchShiftFactorCents));
     loadNextParams();
+    // the analysis frames were just discarded so this is a safe time to change their overlap
+    updateAnalysisOverlapFactor();
 }
 
-void PhaseVocoder::fullReset()
+template <int fftOrder>
+void PhaseVocoder<fftOrder>::fullReset()
 {
     resampler.fullReset();
     resetBetweenBeats();
@@ -91,37 +166,120 @@ void PhaseVocoder::fullReset()
 
 //==============================================================================
 
-void PhaseVocoder::pushResampledHopOnToAnalysisFrameBuffer()
+template <int fftOrder>
+void PhaseVocoder<fftOrder>::pushResampledHopOnToAnalysisFrameBuffer()
 {
-    const auto newHop = resampler.getAnalysisHopBuffer();
-    for (auto sampleValue : newHop)
+    const auto* newHop = resampler.getAnalysisHopReadPointer();
+    const auto hopSize = resampler.getAnalysisHopSize();
+    jassert(hopSize < fftSize);
+
+    auto* circularBuffer = analysisFrames.circularBuffer.data();
+    // copy the part of the hop that fits before the end of the first half, into both halves
+    const auto numBeforeWrap = jmin(hopSize, fftSize - analysisFrames.writePosition);
+    FloatVectorOperations::copy(circularBuffer + analysisFrames.writePosition, newHop, numBeforeWrap);
+    FloatVectorOperations::copy(circularBuffer + analysisFrames.writePosition + fftSize, newHop, numBeforeWrap);
+    analysisFrames.writePosition += numBeforeWrap;
+    if (analysisFrames.writePosition == fftSize)
     {
-        analysisFrames.circularBuffer[analysisFrames.writePosition] = sampleValue;
-        ++analysisFrames.writePosition;
-        if (analysisFrames.writePosition == fftSize)
-        {
-            // wrap around
-            analysisFrames.writePosition = 0;
-            // flag that it's been filled once. (this will stay true until the PV is reset at a beat boundary)
-            analysisFrames.initialized = true;
-        }
-        jassert(analysisFrames.writePosition<fftSize);
+        // wrap around and copy the rest
+        analysisFrames.writePosition = hopSize - numBeforeWrap;
+        FloatVectorOperations::copy(circularBuffer, newHop + numBeforeWrap, analysisFrames.writePosition);
+        FloatVectorOperations::copy(circularBuffer + fftSize, newHop + numBeforeWrap, analysisFrames.writePosition);
+        // flag that it's been filled once. (this will stay true until the PV is reset at a beat boundary)
+        analysisFrames.initialized = true;
+    }
+    jassert(analysisFrames.writePosition < fftSize);
+
+    if constexpr (silenceGatingMethod == energyGate)
+    {
+        auto hopEnergy = 0.0f;
+        for (auto i = 0; i < hopSize; ++i)
+            hopEnergy += newHop[i] * newHop[i];
+        analysisFrames.pushHopEnergy(hopEnergy);
     }
 }
 
-void PhaseVocoder::copyAnalysisFrameToFftInOut()
+template <int fftOrder>
+bool PhaseVocoder<fftOrder>::pushSamplesOnToAnalysisFrameBuffer(const float* samples, const int numSamples)
 {
-    for (auto i = 0; i < fftSize; ++i)
+    const auto hopSize = analysisFrames.analysisHopSize;
+    jassert(numSamples <= hopSize - analysisFrames.numSamplesInHop);
+
+    // fftSize is a multiple of the hop size, so a hop never straddles the end of the first half
+    auto* circularBuffer = analysisFrames.circularBuffer.data();
+    if (samples == nullptr)
+    {
+        FloatVectorOperations::clear(circularBuffer + analysisFrames.writePosition, numSamples);
+        FloatVectorOperations::clear(circularBuffer + analysisFrames.writePosition + fftSize, numSamples);
+    }
+    else
     {
-        const auto index = analysisFrames.writePosition - fftSize + i;
-        const auto indexRewound = ModuloSameSignAsDivisor::mod(index, fftSize);
-        jassert(indexRewound < fftSize && indexRewound >= 0);
-        fft.inOut[i] = analysisFrames.circularBuffer[indexRewound];
+        FloatVectorOperations::copy(circularBuffer + analysisFrames.writePosition, samples, numSamples);
+        FloatVectorOperations::copy(circularBuffer + analysisFrames.writePosition + fftSize, samples, numSamples);
     }
+    analysisFrames.writePosition += numSamples;
+    analysisFrames.numSamplesInHop += numSamples;
+    if (analysisFrames.numSamplesInHop < hopSize)
+        return false;
+
+    analysisFrames.numSamplesInHop = 0;
+    if (analysisFrames.writePosition == fftSize)
+    {
+        analysisFrames.writePosition = 0;
+        // flag that it's been filled once. (this will stay true until the PV is reset at a beat boundary)
+        analysisFrames.initialized = true;
+    }
+
+    if constexpr (silenceGatingMethod == energyGate)
+    {
+        // the hop that was just completed ends at the write position, in the second half
+        const auto* newHop = circularBuffer + analysisFrames.writePosition + fftSize - hopSize;
+        auto hopEnergy = 0.0f;
+        for (auto i = 0; i < hopSize; ++i)
+            hopEnergy += newHop[i] * newHop[i];
+        analysisFrames.pushHopEnergy(hopEnergy);
+    }
+    return true;
 }
 
-void PhaseVocoder::storePhasesInBuffer()
+template <int fftOrder>
+bool PhaseVocoder<fftOrder>::isAnalysisFrameSilent() const
 {
+    constexpr auto thresholdEnergy = fftSize * silenceThresholdGain * silenceThresholdGain;
+    return analysisFrames.getFrameEnergy() < thresholdEnergy;
+}
+
+template <int fftOrder>
+void PhaseVocoder<fftOrder>::windowAnalysisFrameOntoFftInOut()
+{
+    // the oldest sample of the frame is at the write position, and the rest follow it in the mirrored half
+    FloatVectorOperations::multiply(fft.inOut.data(),
+                                    analysisFrames.circularBuffer.data() + analysisFrames.writePosition,
+                                    fft.window.data.data(),
+                                    fftSize);
+}
+
+template <int fftOrder>
+void PhaseVocoder<fftOrder>::storePhasesInBuffer()
+{
+    if constexpr (binScalingMethod == vectorized)
+    {
+        SimdPhaseMath::cartesianToPolar(fft.inOut.data(), polarSpectrum.magnitudes.data(),
+                                        polarSpectrum.phases.data(), nComplexBins);
+        std::copy(polarSpectrum.phases.begin(), polarSpectrum.phases.end(), previousFramePhases.unaltered.begin());
+        polarSpectrum.isFirstFrameOfBeat = true;
+        auto& synthesisSpectrum = prepareSynthesisSpectrum();
+        std::copy(synthesisSpectrum.phases.begin(), synthesisSpectrum.phases.end(),
+                  previousFramePhases.scaled.begin());
+        if constexpr (usesPhaseLocking)
+            findSpectralPeaks(synthesisSpectrum);
+        // the shifted bins have to be written back, while the unshifted ones are still on inOut
+        if (pitchShiftingMethod == spectralPitchShift)
+            SimdPhaseMath::polarToCartesian(synthesisSpectrum.magnitudes.data(), previousFramePhases.scaled.data(),
+                                            fft.inOut.data(), nComplexBins);
+        return;
+    }
+
     // reinterpret_cast the fft buffer to complex
     auto* complexBins = reinterpret_cast<std::complex<float>*>(fft.inOut.data());
 
@@ -136,8 +294,15 @@ void PhaseVocoder::storePhasesInBuffer()
     }
 }
 
-void PhaseVocoder::scaleAllFrequencyBinsAndStorePhaseBuffers()
+template <int fftOrder>
+void PhaseVocoder<fftOrder>::scaleAllFrequencyBinsAndStorePhaseBuffers()
 {
+    if constexpr (binScalingMethod == vectorized)
+    {
+        scaleAllFrequencyBinsAndStorePhaseBuffersVectorized();
+        return;
+    }
+
     // reinterpret_cast the fft buffer to complex
     auto* complexBins = reinterpret_cast<std::complex<float>*>(fft.inOut.data());
 
@@ -156,8 +321,193 @@ void PhaseVocoder::scaleAllFrequencyBinsAndStorePhaseBuffers()
     }
 }
 
-std::complex<float> PhaseVocoder::scaleFrequencyBin(const int k, const float mag, const float currentPhase,
-                                                    const float oldPhase)
+template <int fftOrder>
+void PhaseVocoder<fftOrder>::scaleAllFrequencyBinsAndStorePhaseBuffersVectorized()
+{
+    // convert the complex bins to magnitudes and phases
+    SimdPhaseMath::cartesianToPolar(fft.inOut.data(), polarSpectrum.magnitudes.data(),
+                                    polarSpectrum.phases.data(), nComplexBins);
+    // the true frequencies, in bins, from the phase differences. This also stores the unaltered phases for next time.
+    SimdPhaseMath::estimateTrueBinIndices(polarSpectrum.phases.data(), previousFramePhases.unaltered.data(),
+                                          polarSpectrum.trueBinIndices.data(), nComplexBins,
+                                          analysisFrames.analysisOverlapFactorActual);
+    polarSpectrum.isFirstFrameOfBeat = false;
+    auto& synthesisSpectrum = prepareSynthesisSpectrum();
+    if constexpr (usesPhaseLocking)
+    {
+        findSpectralPeaks(synthesisSpectrum);
+        lockPhasesToPeaks(synthesisSpectrum);
+    }
+    else
+    {
+        // advance and wrap the scaled phases in place
+        SimdPhaseMath::accumulatePhases(previousFramePhases.scaled.data(), synthesisSpectrum.trueBinIndices.data(),
+                                        nComplexBins, static_cast<float>(synthesisOverlapFactor));
+    }
+    // combine the original magnitudes with the scaled phases and store them back on inOut
+    SimdPhaseMath::polarToCartesian(synthesisSpectrum.magnitudes.data(), previousFramePhases.scaled.data(),
+                                    fft.inOut.data(), nComplexBins);
+}
+
+template <int fftOrder>
+void PhaseVocoder<fftOrder>::storeAnalysisPhasesOnly()
+{
+    if constexpr (binScalingMethod == vectorized)
+    {
+        SimdPhaseMath::cartesianToPolar(fft.inOut.data(), polarSpectrum.magnitudes.data(),
+                                        polarSpectrum.phases.data(), nComplexBins);
+        polarSpectrum.isFirstFrameOfBeat = !previousFramePhases.initialized;
+        if (polarSpectrum.isFirstFrameOfBeat)
+            std::copy(polarSpectrum.phases.begin(), polarSpectrum.phases.end(),
+                      previousFramePhases.unaltered.begin());
+        else
+            SimdPhaseMath::estimateTrueBinIndices(polarSpectrum.phases.data(), previousFramePhases.unaltered.data(),
+                                                  polarSpectrum.trueBinIndices.data(), nComplexBins,
+                                                  analysisFrames.analysisOverlapFactorActual);
+        // levels sharing this analysis still need the shifted bins, and might be locking to the peaks
+        auto& synthesisSpectrum = prepareSynthesisSpectrum();
+        if constexpr (usesPhaseLocking)
+            findSpectralPeaks(synthesisSpectrum);
+    }
+    else
+    {
+        const auto* complexBins = reinterpret_cast<const std::complex<float>*>(fft.inOut.data());
+        for (auto k = 0; k < nComplexBins; ++k)
+            previousFramePhases.unaltered[k] = complexBinPhase(complexBins[k]);
+    }
+    previousFramePhases.initialized = true;
+}
+
+template <int fftOrder>
+void PhaseVocoder<fftOrder>::findSpectralPeaks(PolarSpectrum& spectrum)
+{
+    const auto& magnitudes = spectrum.magnitudes;
+    std::swap(spectrum.regionPeaks, spectrum.previousRegionPeaks);
+
+    // a peak is larger than the two bins on either side of it
+    auto numPeaks = 0;
+    for (auto k = 0; k < nComplexBins; ++k)
+    {
+        const auto magnitude = magnitudes[k];
+        if (magnitude > 0.0f
+            && (k < 1 || magnitude > magnitudes[k - 1])
+            && (k < 2 || magnitude > magnitudes[k - 2])
+            && (k + 1 >= nComplexBins || magnitude >= magnitudes[k + 1])
+            && (k + 2 >= nComplexBins || magnitude >= magnitudes[k + 2]))
+        {
+            spectrum.peaks[numPeaks] = k;
+            ++numPeaks;
+        }
+    }
+    spectrum.numPeaks = numPeaks;
+    if (numPeaks == 0)
+    {
+        // don't leave the regions of an older frame for the next one to track its peaks from
+        std::iota(spectrum.regionPeaks.begin(), spectrum.regionPeaks.end(), 0);
+        return;
+    }
+
+    // each peak's region of influence reaches to the smallest bin between it and the next peak
+    auto regionStart = 0;
+    for (auto i = 0; i < numPeaks; ++i)
+    {
+        const auto peak = spectrum.peaks[i];
+        auto regionEnd = nComplexBins;
+        if (i + 1 < numPeaks)
+        {
+            const auto nextPeak = spectrum.peaks[i + 1];
+            const auto trough = std::min_element(magnitudes.begin() + peak, magnitudes.begin() + nextPeak);
+            regionEnd = static_cast<int>(trough - magnitudes.begin()) + 1;
+        }
+        std::fill(spectrum.regionPeaks.begin() + regionStart, spectrum.regionPeaks.begin() + regionEnd, peak);
+        regionStart = regionEnd;
+    }
+}
+
+template <int fftOrder>
+typename PhaseVocoder<fftOrder>::PolarSpectrum& PhaseVocoder<fftOrder>::prepareSynthesisSpectrum()
+{
+    if (pitchShiftingMethod == resamplingPitchShift)
+        return polarSpectrum;
+
+    std::fill(shiftedSpectrum.magnitudes.begin(), shiftedSpectrum.magnitudes.end(), 0.0f);
+    std::fill(shiftedSpectrum.phases.begin(), shiftedSpectrum.phases.end(), 0.0f);
+    std::fill(shiftedSpectrum.trueBinIndices.begin(), shiftedSpectrum.trueBinIndices.end(), 0.0f);
+
+    // each peak's whole region of influence is moved by the same number of bins, so that the main lobes
+    // keep their shape. Moving every bin to round(kp) would leave holes in them, which loses a lot of energy.
+    // The bins can only move by whole bins, but the region's phases are advanced at its exact shifted frequency,
+    // so the fraction of a bin that's left over is made up for from frame to frame (Laroche and Dolson).
+    findSpectralPeaks(polarSpectrum);
+    const auto shift = static_cast<float>(pitchShiftFactor);
+    auto regionStart = 0;
+    for (auto i = 0; i < polarSpectrum.numPeaks; ++i)
+    {
+        const auto peak = polarSpectrum.peaks[i];
+        auto regionEnd = regionStart;
+        while (regionEnd < nComplexBins && polarSpectrum.regionPeaks[regionEnd] == peak)
+            ++regionEnd;
+
+        // the true frequency is better than the peak bin, but it isn't known on the first frame
+        const auto peakFrequency = polarSpectrum.isFirstFrameOfBeat
+                                       ? static_cast<float>(peak)
+                                       : polarSpectrum.trueBinIndices[peak];
+        // the peak moves to k_p * p, and the rest of its region moves with it
+        const auto frequencyOffset = peakFrequency * (shift - 1.0f);
+        const auto offset = roundToInt(frequencyOffset);
+        for (auto k = jmax(regionStart, -offset); k < jmin(regionEnd, nComplexBins - offset); ++k)
+        {
+            const auto target = k + offset;
+            const auto magnitude = polarSpectrum.magnitudes[k];
+            // when shifting down the regions can overlap, in which case the louder one's phase is kept
+            if (magnitude > shiftedSpectrum.magnitudes[target])
+            {
+                shiftedSpectrum.phases[target] = polarSpectrum.phases[k];
+                shiftedSpectrum.trueBinIndices[target] = polarSpectrum.trueBinIndices[k] + frequencyOffset;
+            }
+            shiftedSpectrum.magnitudes[target] += magnitude;
+        }
+        regionStart = regionEnd;
+    }
+    return shiftedSpectrum;
+}
+
+template <int fftOrder>
+void PhaseVocoder<fftOrder>::lockPhasesToPeaks(const PolarSpectrum& analysis)
+{
+    auto& scaledPhases = previousFramePhases.scaled;
+    if (analysis.numPeaks == 0)
+    {
+        // silence has nothing to lock to
+        SimdPhaseMath::accumulatePhases(scaledPhases.data(), analysis.trueBinIndices.data(),
+                                        nComplexBins, static_cast<float>(synthesisOverlapFactor));
+        return;
+    }
+
+    // advance the peaks first, because they might continue the phases of other bins
+    const auto phaseAdvancePerBin = MathConstants<float>::twoPi / static_cast<float>(synthesisOverlapFactor);
+    for (auto i = 0; i < analysis.numPeaks; ++i)
+    {
+        const auto peak = analysis.peaks[i];
+        const auto movedFrom = phaseLockingMethod == scaledPhaseLocking ? analysis.previousRegionPeaks[peak] : peak;
+        previousFramePhases.peakPhases[peak] = wrapPhase(scaledPhases[movedFrom]
+            + analysis.trueBinIndices[peak] * phaseAdvancePerBin);
+    }
+
+    const auto beta = phaseLockingMethod == scaledPhaseLocking
+                          ? static_cast<float>(2.0 / 3.0 + actualTimeScaleFactor / 3.0)
+                          : 1.0f;
+    for (auto k = 0; k < nComplexBins; ++k)
+    {
+        const auto peak = analysis.regionPeaks[k];
+        const auto analysisPhaseDifference = wrapPhase(analysis.phases[k] - analysis.phases[peak]);
+        scaledPhases[k] = wrapPhase(previousFramePhases.peakPhases[peak] + beta * analysisPhaseDifference);
+    }
+}
+
+template <int fftOrder>
+std::complex<float> PhaseVocoder<fftOrder>::scaleFrequencyBin(const int k, const float mag,
+                                                              const float currentPhase, const float oldPhase)
 {
     const auto freqDeviation = calculateFrequencyDeviation(oldPhase, currentPhase, k,
                                                            analysisFrames.analysisOverlapFactorActual,
@@ -178,14 +528,34 @@ std::complex<float> PhaseVocoder::scaleFrequencyBin(const int k, const float mag
     return std::polar(mag, scaledPhase);
 }
 
-void PhaseVocoder::scaleAnalysisFrame()
+template <int fftOrder>
+void PhaseVocoder<fftOrder>::scaleAnalysisFrame()
 {
-    copyAnalysisFrameToFftInOut();
+    synthesisFrameIsSilent = false;
+    polarSpectrum.isSilent = false;
+    if constexpr (silenceGatingMethod == energyGate)
+    {
+        if (isAnalysisFrameSilent())
+        {
+            synthesisFrameIsSilent = true;
+            polarSpectrum.isSilent = true;
+            // start the phases over on the next frame that isn't silent
+            previousFramePhases.initialized = false;
+            return;
+        }
+    }
 
-    // window the FFT buffer
-    FloatVectorOperations::multiply(fft.inOut.data(), fft.window.data.data(), fftSize);
+    // window the latest frame onto the FFT buffer
+    windowAnalysisFrameOntoFftInOut();
     // RFFT the FFT buffer
-    fft.instance.performRealOnlyForwardTransform(fft.inOut.data(), true);
+    fft.instance.performRealOnlyForwardTransform(fft.inOut.data());
+
+    if (!synthesisEnabled)
+    {
+        storeAnalysisPhasesOnly();
+        synthesisFrameIsSilent = true;
+        return;
+    }
 
     if (previousFramePhases.initialized)
     {
@@ -199,6 +569,12 @@ void PhaseVocoder::scaleAnalysisFrame()
         // both phase buffers are now initialized
         previousFramePhases.initialized = true;
     }
+    synthesizeFrame();
+}
+
+template <int fftOrder>
+void PhaseVocoder<fftOrder>::synthesizeFrame()
+{
     // inverse RFFT the complex bins
     fft.instance.performRealOnlyInverseTransform(fft.inOut.data());
     // synthesis window
@@ -207,37 +583,189 @@ void PhaseVocoder::scaleAnalysisFrame()
     FloatVectorOperations::multiply(fft.inOut.data(), fft.window.amplitudeCompensationScale, fftSize);
 }
 
-int PhaseVocoder::processSample(const float sampleValue)
+template <int fftOrder>
+int PhaseVocoder<fftOrder>::processSample(const float sampleValue)
 {
+    if (pitchShiftingMethod == spectralPitchShift)
+        return pushSamplesOnToAnalysisFrameBuffer(&sampleValue, 1) ? processFrameIfInitialized() : 0;
+
     resampler.pushSample(sampleValue);
+    return processHopIfReady();
+}
+
+template <int fftOrder>
+int PhaseVocoder<fftOrder>::processBlock(const float* samples, const int numSamples, int& numSamplesUsed)
+{
+    if (pitchShiftingMethod == spectralPitchShift)
+    {
+        numSamplesUsed = jmin(numSamples, analysisFrames.analysisHopSize - analysisFrames.numSamplesInHop);
+        if (numSamplesUsed <= 0)
+            return 0;
+
+        return pushSamplesOnToAnalysisFrameBuffer(samples, numSamplesUsed) ? processFrameIfInitialized() : 0;
+    }
+
+    numSamplesUsed = jmin(numSamples, resampler.getNumSamplesUntilReady());
+    if (numSamplesUsed <= 0)
+        return 0;
+
+    resampler.pushSamples(samples, numSamplesUsed);
+    return processHopIfReady();
+}
 
+template <int fftOrder>
+int PhaseVocoder<fftOrder>::flushWithZeros()
+{
+    // a hop of zeros doesn't give a frame until the analysis frame buffer has been filled once
+    auto hop = 0;
+    while (hop == 0)
+    {
+        if (pitchShiftingMethod == spectralPitchShift)
+        {
+            const auto numZeros = analysisFrames.analysisHopSize - analysisFrames.numSamplesInHop;
+            hop = pushSamplesOnToAnalysisFrameBuffer(nullptr, numZeros) ? processFrameIfInitialized() : 0;
+            continue;
+        }
+
+        resampler.pushZeros(resampler.getNumSamplesUntilReady());
+        hop = processHopIfReady();
+    }
+    return hop;
+}
+
+template <int fftOrder>
+int PhaseVocoder<fftOrder>::getNumHopsToFlush() const
+{
+    // the first hop is as far as the beat would reach without the delay, then the delay is resampled on top of it
+    const auto inputSamplesPerHop = analysisFrames.analysisHopSize * pitchShiftFactor;
+    return 1 + static_cast<int>(std::ceil(getInputDelayInSamples() / inputSamplesPerHop));
+}
+
+template <int fftOrder>
+int PhaseVocoder<fftOrder>::getInputDelayInSamples() const
+{
+    return pitchShiftingMethod == spectralPitchShift ? 0 : resampler.getDelayInSamples();
+}
+
+template <int fftOrder>
+int PhaseVocoder<fftOrder>::processHopIfReady()
+{
     // if the number of samples on the inputQueue is at least the number needed to get the desired output length
     const auto newHopAvailable = resampler.resampleHopToAnalysisHopBufferIfReady(pitchShiftFactor);
     if (newHopAvailable)
     {
         pushResampledHopOnToAnalysisFrameBuffer();
-        if (analysisFrames.initialized)
-        {
-            scaleAnalysisFrame();
-            return synthesisHopSize.getNextInt();
-        }
+        return processFrameIfInitialized();
     }
     return 0;
 }
 
+template <int fftOrder>
+int PhaseVocoder<fftOrder>::processFrameIfInitialized()
+{
+    if (!analysisFrames.initialized)
+        return 0;
+
+    scaleAnalysisFrame();
+    return synthesisHopSize.getNextInt();
+}
+
 //==============================================================================
 
-float PhaseVocoder::complexBinPhase(const std::complex<float> complexBin)
+template <int fftOrder>
+bool PhaseVocoder<fftOrder>::canShareAnalysisWith(const PhaseVocoderBase& other) const
+{
+    if (binScalingMethod != vectorized)
+        return false;
+
+    const auto* otherSameSize = dynamic_cast<const PhaseVocoder*>(&other);
+    return otherSameSize != nullptr
+        && otherSameSize != this
+        && otherSameSize->analysisFrames.analysisHopSize == analysisFrames.analysisHopSize
+        && otherSameSize->pitchShiftFactorCents == pitchShiftFactorCents
+        && otherSameSize->pitchShiftingMethod == pitchShiftingMethod
+        && (pitchShiftingMethod == spectralPitchShift
+            || PvResampler::resamplingMethod == PvResampler::polyphaseSincResampling);
+}
+
+template <int fftOrder>
+int PhaseVocoder<fftOrder>::synthesizeFromSharedAnalysis(const PhaseVocoderBase& source)
+{
+    const auto& analysis = static_cast<const PhaseVocoder&>(source);
+    jassert(analysis.analysisFrames.analysisHopSize == analysisFrames.analysisHopSize);
+
+    // the resampling rate of the shared analysis determines our time scale factor
+    if (analysis.pitchShiftFactorCents != pitchShiftFactorCents)
+        setParams(static_cast<float>(analysis.pitchShiftFactor), static_cast<float>(analysis.pitchShiftFactorCents));
+
+    synthesisFrameIsSilent = analysis.polarSpectrum.isSilent || !synthesisEnabled;
+    if (synthesisFrameIsSilent)
+        return synthesisHopSize.getNextInt();
+
+    const auto& spectrum = analysis.getSynthesisSpectrum();
+    if (analysis.polarSpectrum.isFirstFrameOfBeat)
+    {
+        // like storePhasesInBuffer, the first frame of the beat is output unaltered
+        std::copy(spectrum.phases.begin(), spectrum.phases.end(), previousFramePhases.scaled.begin());
+    }
+    else
+    {
+        if constexpr (usesPhaseLocking)
+            lockPhasesToPeaks(spectrum);
+        else
+            SimdPhaseMath::accumulatePhases(previousFramePhases.scaled.data(), spectrum.trueBinIndices.data(),
+                                            nComplexBins, static_cast<float>(synthesisOverlapFactor));
+    }
+    SimdPhaseMath::polarToCartesian(spectrum.magnitudes.data(), previousFramePhases.scaled.data(),
+                                    fft.inOut.data(), nComplexBins);
+
+    synthesizeFrame();
+    return synthesisHopSize.getNextInt();
+}
+
+template <int fftOrder>
+void PhaseVocoder<fftOrder>::copyAnalysisInputFrom(const PhaseVocoderBase& source)
+{
+    const auto& analysis = static_cast<const PhaseVocoder&>(source);
+    // with the spectral method nothing carries over between beats, since the final hop is always completed
+    if (pitchShiftingMethod == resamplingPitchShift)
+        resampler.copyInputQueueFrom(analysis.resampler);
+}
+
+template <int fftOrder>
+void PhaseVocoder<fftOrder>::copyAnalysisStateFrom(const PhaseVocoderBase& source)
+{
+    const auto& analysis = static_cast<const PhaseVocoder&>(source);
+    jassert(analysis.pitchShiftingMethod == pitchShiftingMethod);
+
+    // our params followed the source's a frame late, but the source's are the ones its pending hop is analyzed with.
+    // Our own queued params are left alone, so they're loaded after our next frame.
+    if (analysis.pitchShiftFactorCents != pitchShiftFactorCents)
+        setParams(static_cast<float>(analysis.pitchShiftFactor), static_cast<float>(analysis.pitchShiftFactorCents));
+    if (pitchShiftingMethod == resamplingPitchShift)
+        resampler.copyStateFrom(analysis.resampler);
+
+    analysisFrames.copyFramesFrom(analysis.analysisFrames);
+    previousFramePhases.unaltered = analysis.previousFramePhases.unaltered;
+    previousFramePhases.initialized = analysis.previousFramePhases.initialized;
+    // the previous frame's regions of influence, for scaledPhaseLocking
+    polarSpectrum = analysis.polarSpectrum;
+    shiftedSpectrum = analysis.shiftedSpectrum;
+}
+
+//==============================================================================
+
+float PhaseVocoderBase::complexBinPhase(const std::complex<float> complexBin)
 {
     return std::arg(complexBin);
 }
 
-float PhaseVocoder::complexBinMag(const std::complex<float> complexBin)
+float PhaseVocoderBase::complexBinMag(const std::complex<float> complexBin)
 {
     return std::abs(complexBin);
 }
 
-float PhaseVocoder::calculateFrequencyDeviation(const float oldPhase, const float currentPhase,
+float PhaseVocoderBase::calculateFrequencyDeviation(const float oldPhase, const float currentPhase,
                                                 const int k, const float analysisOverlapFactor,
                                                 const float analysisHopSize)
 {
@@ -249,7 +777,7 @@ float PhaseVocoder::calculateFrequencyDeviation(const float oldPhase, const floa
     return frequencyDeviation;
 }
 
-float PhaseVocoder::wrapPhase(const float phaseIn)
+float PhaseVocoderBase::wrapPhase(const float phaseIn)
 {
     constexpr auto pi = MathConstants<float>::pi;
     constexpr auto twoPi = MathConstants<float>::twoPi;
@@ -258,18 +786,35 @@ float PhaseVocoder::wrapPhase(const float phaseIn)
 
 //==============================================================================
 
-PhaseVocoder::AnalysisFrames::AnalysisFrames(const int level): analysisOverlapFactor{jmax(4.0, std::pow(2, 4 - level))},
-                                                               analysisHopSize{
-                                                                   static_cast<int>(std::round(
-                                                                       fftSize / analysisOverlapFactor))
-                                                               },
-                                                               analysisOverlapFactorActual{
-                                                                   static_cast<float>(fftSize) / static_cast<float>(
-                                                                       analysisHopSize)
-                                                               }
+template <int fftOrder>
+PhaseVocoder<fftOrder>::AnalysisFrames::AnalysisFrames(const int level): maxAnalysisOverlapFactor{
+    jmax(minAnalysisOverlapFactor, std::pow(2, fftOrder - 6 - level))
+}
+{
+    setAnalysisOverlapFactor(maxAnalysisOverlapFactor);
+}
+
+template <int fftOrder>
+bool PhaseVocoder<fftOrder>::AnalysisFrames::setAnalysisOverlapFactor(const double newAnalysisOverlapFactor)
 {
+    jassert(!initialized && writePosition == 0);
+    jassert(newAnalysisOverlapFactor >= minAnalysisOverlapFactor);
+    jassert(newAnalysisOverlapFactor <= maxAnalysisOverlapFactor);
+
+    analysisOverlapFactor = newAnalysisOverlapFactor;
+    const auto newAnalysisHopSize = static_cast<int>(std::round(fftSize / analysisOverlapFactor));
+    analysisOverlapFactorActual = static_cast<float>(fftSize) / static_cast<float>(newAnalysisHopSize);
     // it should be ok if this is false, but it will be nice to know if that ever is the case.
     jassert(analysisOverlapFactorActual == analysisOverlapFactor);
+
+    const auto changed = newAnalysisHopSize != analysisHopSize;
+    analysisHopSize = newAnalysisHopSize;
+    return changed;
 }
 
 //==============================================================================
+// the FFT orders used by SubdivisionLevel::fftOrders
+
+template class PhaseVocoder<8>;
+template class PhaseVocoder<9>;
+template class PhaseVocoder<10>;
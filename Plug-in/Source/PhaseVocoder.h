@@ -23,6 +23,7 @@
 #pragma once
 
 #include "../JuceLibraryCode/JuceHeader.h"
+#include "FftBackend.h"
 #include "PvResampler.h"
 #include "StatefulRoundedNumber.h"
 
@@ -31,29 +32,29 @@
  */
 
 /**
- * \brief An implementation of the phase vocoder technique tailored for Gamelanizer.
- * Each subdivision level will have a corresponding instance of this class.
+ * \brief The interface of the phase vocoder, independent of its FFT size.
+ * Each subdivision level will have a corresponding instance of PhaseVocoder, with an FFT size chosen for that level.
  */
-class PhaseVocoder
+class PhaseVocoderBase
 {
 public:
-    PhaseVocoder(int levelNumber, float effectiveTimeScaleFactor);
+    PhaseVocoderBase() = default;
 
-    PhaseVocoder(const PhaseVocoder&) = delete;
+    PhaseVocoderBase(const PhaseVocoderBase&) = delete;
 
-    PhaseVocoder& operator=(const PhaseVocoder&) = delete;
+    PhaseVocoderBase& operator=(const PhaseVocoderBase&) = delete;
 
-    PhaseVocoder(PhaseVocoder&&) = delete;
+    PhaseVocoderBase(PhaseVocoderBase&&) = delete;
 
-    PhaseVocoder& operator=(PhaseVocoder&&) = delete;
+    PhaseVocoderBase& operator=(PhaseVocoderBase&&) = delete;
 
-    ~PhaseVocoder() = default;
+    virtual ~PhaseVocoderBase() = default;
 
     /**
      * \brief Must be called before playback begins. Effective time scale factor will never change but pitch shift can.
      * \param initPitchShiftFactor (2 is an octave, 3/2 is a fifth, 4/3 is a fourth)
      */
-    void initParams(float initPitchShiftFactor);
+    virtual void initParams(float initPitchShiftFactor) = 0;
 
     /**
 	 * \brief Thread safe way to set the next pitch shift factor to be used. 
@@ -63,40 +64,340 @@ public:
 	 * discarded and only the current one used.
 	 * \param newNextPitchShiftFactorCents (2 is an octave, 3/2 is a fifth, 4/3 is a fourth)
 	 */
-    void queueParams(float newNextPitchShiftFactorCents);
+    virtual void queueParams(float newNextPitchShiftFactorCents) = 0;
 
     /**
      * \brief This should be called immediately after processing a phase vocoder frame, in order to set the new pitch shift factor.
      * If the pitch shift factor is the same, no processing is done.
      */
-    void loadNextParams();
+    virtual void loadNextParams() = 0;
 
     /**
      * \brief Call this at the beginning of each new beat to reinitialize the phases.
      */
-    void resetBetweenBeats();
+    virtual void resetBetweenBeats() = 0;
 
     /**
      * \brief Call this at the beginning of playback or if the timeline position jumps around.
      */
-    void fullReset();
+    virtual void fullReset() = 0;
 
     /**
      * \brief Push a single sample onto the resampler inputQueue and resample a hop and process a frame if possible.
      * \param sampleValue The audio data   
      * \return 0 if no new data available. Hop size if a new frame is available on inOut.
      */
-    int processSample(float sampleValue);
+    virtual int processSample(float sampleValue) = 0;
 
-    [[nodiscard]] const float* getFftInOutReadPointer() const { return fft.inOut.data(); }
+    /**
+     * \brief Push samples onto the resampler inputQueue until a frame is processed or the span runs out.
+     * This gives the same result as calling processSample on each sample, but the caller has to handle each frame
+     * before calling this again with the rest of the span.
+     * \param samples The audio data
+     * \param numSamples The length of the span
+     * \param numSamplesUsed Set to the number of samples that were pushed. This is at least 1 if numSamples is positive.
+     * \return 0 if no new data available. Hop size if a new frame is available on inOut.
+     */
+    virtual int processBlock(const float* samples, int numSamples, int& numSamplesUsed) = 0;
+
+    /**
+     * \brief Push zeros onto the resampler inputQueue until a frame is processed, to finish the last hop of a beat.
+     * This gives the same result as calling processSample(0) until it returns a hop, but the zeros are pushed
+     * a hop at a time. Call it getNumHopsToFlush() times to finish a beat.
+     * \return The hop size of the new frame, which is available on inOut
+     */
+    virtual int flushWithZeros() = 0;
+
+    /**
+     * \return The number of times to call flushWithZeros at the end of a beat. Usually 1, plus the hops it takes for the last
+     * samples to get through the resampler's delay.
+     */
+    [[nodiscard]] virtual int getNumHopsToFlush() const = 0;
+
+    /**
+     * \return The number of input samples that the frames lag behind the input, because of the resampler.
+     * The output lags by this times the time scale factor.
+     */
+    [[nodiscard]] virtual int getInputDelayInSamples() const = 0;
+
+    /**
+     * \return The synthesis frame. It is getFftSize() samples long.
+     */
+    [[nodiscard]] virtual const float* getFftInOutReadPointer() const = 0;
+
+    /**
+     * \return The FFT size \f$N\f$ of this instance.
+     */
+    [[nodiscard]] virtual int getFftSize() const = 0;
 
-    static int getFftSize() { return fftSize; }
     //==============================================================================
-private:
     /**
-     * \brief The FFT order
+     * \brief Whether this phase vocoder could skip its own resampling and analysis and use the analysis of other instead.
+     * That is the case when they have the same FFT size, analysis hop size and pitch shift factor,
+     * and the bins are scaled with the #vectorized #binScalingMethod. With the #resamplingPitchShift method the
+     * resampler has to be a PolyphaseSincInterpolator too, so that copyAnalysisStateFrom can copy its state.
+     * The caller is responsible for checking that their input is identical too.
+     * \param other The phase vocoder that would do the analysis
+     */
+    [[nodiscard]] virtual bool canShareAnalysisWith(const PhaseVocoderBase& other) const = 0;
+
+    /**
+     * \brief Synthesize a frame from the frame that source just analyzed, instead of from this instance's own input.
+     * Call this right after source's processSample (or flushWithZeros) returns a hop, and before source's loadNextParams.
+     * This instance follows the pitch shift factor of source.
+     * \param source A phase vocoder that canShareAnalysisWith returned true for
+     * \return The hop size of the new frame, which is available on inOut
+     */
+    virtual int synthesizeFromSharedAnalysis(const PhaseVocoderBase& source) = 0;
+
+    /**
+     * \brief Take over the unconsumed resampler input of source, so that this instance can continue its stream 
+     * after it stops sharing the analysis of source.
+     * \param source A phase vocoder that canShareAnalysisWith returned true for
+     */
+    virtual void copyAnalysisInputFrom(const PhaseVocoderBase& source) = 0;
+
+    /**
+     * \brief Take over everything source's analysis depends on: its resampler, analysis frames, analysis phases
+     * and peaks, and its params. Then this instance can continue its stream in the middle of a beat,
+     * after it stops sharing the analysis of source, with the same result as if it had never shared it.
+     * \param source A phase vocoder that canShareAnalysisWith returned true for, whose analysis this instance was sharing
+     */
+    virtual void copyAnalysisStateFrom(const PhaseVocoderBase& source) = 0;
+
+    //==============================================================================
+    /**
+     * \brief The ways the analysis overlap factor \f$o_a\f$ can be chosen.
+     */
+    enum AnalysisOverlapMethod
+    {
+        /**
+         * \brief Always use the level's maximum, \f$o_a=\max(4, \frac{N}{2^{6+i}})\f$.
+         */
+        fixedOverlap,
+        /**
+         * \brief At every beat boundary, use the smallest power of two that keeps \f$o_s=\frac{o_a}{v}\f$ at least
+         * #minSynthesisOverlapFactor, between 4 and the level's maximum. Typical fourth and fifth settings then only need 4.
+         */
+        pitchAdaptiveOverlap
+    };
+
+    static constexpr AnalysisOverlapMethod analysisOverlapMethod = pitchAdaptiveOverlap;
+
+    /**
+     * \brief The ways the frequency bins can be scaled.
+     */
+    enum BinScalingMethod
+    {
+        /**
+         * \brief One bin at a time with std::arg, std::abs, wrapPhase and std::polar. Kept as the reference.
+         */
+        scalarReference,
+        /**
+         * \brief Whole SIMD registers at a time with SimdPhaseMath, using structure-of-arrays magnitudes and phases.
+         */
+        vectorized
+    };
+
+    static constexpr BinScalingMethod binScalingMethod = vectorized;
+
+    /**
+     * \brief The ways the scaled phases of a frame can be kept coherent with each other (Laroche and Dolson).
+     * Phase locking needs the polar spectrum, so it is only used with the #vectorized #binScalingMethod.
+     */
+    enum PhaseLockingMethod
+    {
+        /**
+         * \brief Every bin's phase is advanced by its own true frequency.
+         */
+        noPhaseLocking,
+        /**
+         * \brief Only the phases of the spectral peaks are advanced. The other bins in a peak's region of influence
+         * keep their analysis phase difference to the peak.
+         * This would allow a smaller \f$o_s\f$, but #minSynthesisOverlapFactor is set by the windows, not the phases,
+         * so here it costs a peak search per frame and saves no frames. That's why it isn't the default.
+         */
+        identityPhaseLocking,
+        /**
+         * \brief Like identityPhaseLocking, but each peak continues the scaled phase of the previous frame's peak it moved from,
+         * and the phase differences to the peak are scaled by \f$\beta=\frac{2}{3}+\frac{v}{3}\f$.
+         */
+        scaledPhaseLocking
+    };
+
+    static constexpr PhaseLockingMethod phaseLockingMethod = noPhaseLocking;
+
+    static constexpr bool usesPhaseLocking = phaseLockingMethod != noPhaseLocking && binScalingMethod == vectorized;
+
+    /**
+     * \brief The smallest synthesis overlap factor \f$o_s\f$ that the #pitchAdaptiveOverlap method allows.
+     * Phase locking would tolerate less, but the Hann analysis and synthesis windows only overlap-add to a constant
+     * from \f$o_s=4\f$ up.
+     */
+    static constexpr double minSynthesisOverlapFactor = 4.0;
+
+    /**
+     * \brief The ways frames with nothing to hear in them can be handled.
+     */
+    enum SilenceGatingMethod
+    {
+        /**
+         * \brief Every frame is transformed.
+         */
+        noSilenceGating,
+        /**
+         * \brief An analysis frame whose RMS is below #silenceThresholdGain is not transformed and adds nothing to the output.
+         * The next frame that is transformed is treated like the first frame of a beat, so its phases start over unaltered.
+         */
+        energyGate
+    };
+
+    static constexpr SilenceGatingMethod silenceGatingMethod = energyGate;
+
+    /**
+     * \brief -120 dBFS
      */
-    static constexpr int fftOrder{10};
+    static constexpr float silenceThresholdGain{1.0e-6f};
+
+    /**
+     * \return True if the last frame that was synthesized was silent and should not be overlap-added.
+     */
+    [[nodiscard]] virtual bool isSynthesisFrameSilent() const = 0;
+
+    /**
+     * \brief Turn the synthesis half of the processing on or off. While it's off, frames are still analyzed,
+     * so that the analysis phases stay current and the analysis can still be shared, but every synthesis frame is silent.
+     * Only call this between beats.
+     */
+    virtual void setSynthesisEnabled(bool shouldSynthesize) = 0;
+
+    /**
+     * \brief The ways the pitch can be shifted.
+     */
+    enum PitchShiftingMethod
+    {
+        /**
+         * \brief The input is resampled by the pitch shift factor \f$p\f$ and then time scaled by \f$v=rp\f$.
+         */
+        resamplingPitchShift,
+
+        /**
+         * \brief The input is only time scaled, by \f$v=r\f$, and the region of influence of each spectral peak
+         * \f$k_p\f$ is moved by the same whole number of bins \f$\mathrm{round}(k_p(p-1))\f$. The phases of the region
+         * are advanced at its true frequencies plus the exact \f$k_p(p-1)\f$, so the peak's phase advances at
+         * \f$k_p p\f$ and the fraction of a bin that the move left out is made up for from frame to frame
+         * (Laroche and Dolson).
+         * This skips the resampler, whose input queue isn't even allocated for a level that shifts spectrally,
+         * and the number of frames per input sample no longer depends on the pitch. That makes it cheaper when
+         * shifting down, where resampling stretches the input, but not when shifting up, where resampling shrinks it.
+         * The regions moved past Nyquist are lost and the regions that land on each other when shifting down are merged.
+         * Only available with the #vectorized #binScalingMethod.
+         */
+        spectralPitchShift
+    };
+
+    /**
+     * \brief Choose the PitchShiftingMethod. It takes effect at the next initParams or resetBetweenBeats.
+     * The #resamplingPitchShift method only takes effect once allocateResampler has been called. Until then the
+     * bins are shifted.
+     */
+    virtual void setPitchShiftingMethod(PitchShiftingMethod newPitchShiftingMethod) = 0;
+
+    /**
+     * \brief Allocate the resampler's input queue, which the #resamplingPitchShift method needs.
+     * See PvResampler::allocateInputQueue for the threads this can be called on.
+     */
+    virtual void allocateResampler() = 0;
+
+    /**
+     * \return True if allocateResampler has been called, or isn't needed because the bins can't be shifted
+     */
+    [[nodiscard]] virtual bool hasResampler() const = 0;
+
+protected:
+    /**
+     * \brief Calculate the phase of a complex frequency bin
+     * \return The phase
+     */
+    static float complexBinPhase(std::complex<float> complexBin);
+
+    /**
+     * \brief Calculate the magnitude of a complex frequency bin
+     * \return The magnitude
+     */
+    static float complexBinMag(std::complex<float> complexBin);
+
+    static float calculateFrequencyDeviation(float oldPhase, float currentPhase, int k,
+                                             float analysisOverlapFactor, float analysisHopSize);
+
+    static float wrapPhase(float phaseIn);
+};
+
+//==============================================================================
+/**
+ * \brief An implementation of the phase vocoder technique tailored for Gamelanizer.
+ * The FFT size is a template parameter so that each subdivision level can use a frame size suited to its note lengths.
+ * \tparam fftOrder The FFT order. The FFT size is \f$N=2^{fftOrder}\f$.
+ */
+template <int fftOrder>
+class PhaseVocoder final : public PhaseVocoderBase
+{
+public:
+    PhaseVocoder(int levelNumber, float effectiveTimeScaleFactor);
+
+    PhaseVocoder(const PhaseVocoder&) = delete;
+
+    PhaseVocoder& operator=(const PhaseVocoder&) = delete;
+
+    PhaseVocoder(PhaseVocoder&&) = delete;
+
+    PhaseVocoder& operator=(PhaseVocoder&&) = delete;
+
+    ~PhaseVocoder() override = default;
+
+    void initParams(float initPitchShiftFactor) override;
+
+    void queueParams(float newNextPitchShiftFactorCents) override;
+
+    void loadNextParams() override;
+
+    void resetBetweenBeats() override;
+
+    void fullReset() override;
+
+    int processSample(float sampleValue) override;
+
+    int processBlock(const float* samples, int numSamples, int& numSamplesUsed) override;
+
+    int flushWithZeros() override;
+
+    [[nodiscard]] int getNumHopsToFlush() const override;
+
+    [[nodiscard]] int getInputDelayInSamples() const override;
+
+    [[nodiscard]] const float* getFftInOutReadPointer() const override { return fft.inOut.data(); }
+
+    [[nodiscard]] int getFftSize() const override { return fftSize; }
+
+    [[nodiscard]] bool isSynthesisFrameSilent() const override { return synthesisFrameIsSilent; }
+
+    void setSynthesisEnabled(bool shouldSynthesize) override { synthesisEnabled = shouldSynthesize; }
+
+    void setPitchShiftingMethod(PitchShiftingMethod newPitchShiftingMethod) override;
+
+    void allocateResampler() override { resampler.allocateInputQueue(); }
+
+    [[nodiscard]] bool hasResampler() const override { return resampler.hasInputQueue(); }
+
+    [[nodiscard]] bool canShareAnalysisWith(const PhaseVocoderBase& other) const override;
+
+    int synthesizeFromSharedAnalysis(const PhaseVocoderBase& source) override;
+
+    void copyAnalysisInputFrom(const PhaseVocoderBase& source) override;
+
+    void copyAnalysisStateFrom(const PhaseVocoderBase& source) override;
+    //==============================================================================
+private:
     /**
      * \brief The FFT size \f[N\f].
      * 
@@ -123,16 +424,64 @@ private:
         {
             initialized = false;
             writePosition = 0;
+            numSamplesInHop = 0;
+            hopEnergies.fill(0.0f);
+            hopEnergiesWritePosition = 0;
         }
 
+        /**
+         * \brief Copy the frames and hop energies of another level's buffer with the same analysis hop size
+         */
+        void copyFramesFrom(const AnalysisFrames& other)
+        {
+            jassert(other.analysisHopSize == analysisHopSize);
+            circularBuffer = other.circularBuffer;
+            writePosition = other.writePosition;
+            initialized = other.initialized;
+            numSamplesInHop = other.numSamplesInHop;
+            hopEnergies = other.hopEnergies;
+            hopEnergiesWritePosition = other.hopEnergiesWritePosition;
+        }
+
+        /**
+         * \brief Store the energy of the hop that was just written, so the energy of a frame can be found without reading it.
+         */
+        void pushHopEnergy(float hopEnergy)
+        {
+            hopEnergies[hopEnergiesWritePosition] = hopEnergy;
+            hopEnergiesWritePosition = (hopEnergiesWritePosition + 1) % maxHopsPerFrame;
+        }
+
+        /**
+         * \return The sum of the squares of the latest frame's (unwindowed) samples
+         */
+        [[nodiscard]] float getFrameEnergy() const
+        {
+            // the latest fftSize / analysisHopSize hops make up the frame
+            const auto numHops = fftSize / analysisHopSize;
+            jassert(numHops <= maxHopsPerFrame);
+            auto energy = 0.0f;
+            for (auto i = 1; i <= numHops; ++i)
+                energy += hopEnergies[(hopEnergiesWritePosition - i + maxHopsPerFrame) % maxHopsPerFrame];
+            return energy;
+        }
+
+        /**
+         * \brief Change \f$o_a\f$ and #analysisHopSize. Only call this right after reset.
+         * \param newAnalysisOverlapFactor The new overlap factor. It should divide the fftSize evenly.
+         * \return True if the hop size changed.
+         */
+        bool setAnalysisOverlapFactor(double newAnalysisOverlapFactor);
+
         /**
          * \brief The circular buffer for the (overlapping) time-domain frames that the resampler outputs.
-         * Its data will be unwrapped onto inOut every new hop.
+         * It's mirrored: every sample is written at writePosition and writePosition + fftSize,
+         * so the latest frame is always the contiguous span starting at writePosition, and is windowed straight onto inOut.
          */
-        std::array<float, fftSize> circularBuffer{};
+        std::array<float, fftSize * 2> circularBuffer{};
 
         /**
-         * \brief The write position on the circularBuffer
+         * \brief The write position on the first half of the circularBuffer. This is also where the latest frame starts.
          */
         int writePosition{};
 
@@ -141,27 +490,57 @@ private:
          */
         bool initialized{};
 
-    private:
         /**
-        * \brief The number of analysis frames overlapping at one time, \f$o_a\f$.
+         * \brief The number of samples of the current hop that have been written, with the #spectralPitchShift method.
+         * The resampler writes whole hops.
+         */
+        int numSamplesInHop{};
+
+        /**
+         * \brief The most hops a frame can be made of. This is the largest maxAnalysisOverlapFactor.
+         */
+        static constexpr int maxHopsPerFrame{16};
+
+        /**
+         * \brief The energies of the latest hops, in a circular buffer
+         */
+        std::array<float, maxHopsPerFrame> hopEnergies{};
+
+        int hopEnergiesWritePosition{};
+
+        /**
+         * \brief The smallest overlap factor that is used. Its hop size is the largest the resampler will have to output.
+         */
+        static constexpr double minAnalysisOverlapFactor{4.0};
+
+        /**
+        * \brief The largest overlap factor this level will use.
         * The 4th subdivision level does not need more than 4. 
         * The 1st subdivision level needs 16 to sound smooth at 4800 cents but only 4 for less than 1200 cents.
-        * 
+        * The smallest hop of level i is the one a 1024-point frame had, \f$2^{6+i}\f$ samples, so a level with a
+        * smaller frame uses a smaller overlap factor and doesn't transform more frames than before. It never goes below
+        * #minAnalysisOverlapFactor though, so the 256-point levels still have a 64-sample hop.
         */
-        const double analysisOverlapFactor;
+        const double maxAnalysisOverlapFactor;
+
+    private:
+        /**
+        * \brief The number of analysis frames overlapping at one time, \f$o_a\f$.
+        */
+        double analysisOverlapFactor{};
 
     public:
         /**
          * \brief The number of samples to hop for the overlapping analysis frames (after resampling, before FFT).
          * \f[h_a=\frac{N}{o_a}\f]
          */
-        const int analysisHopSize;
+        int analysisHopSize{};
 
         /**
         * \brief The actual overlap factor used due to the rounding of #analysisHopSize.
         * This probably won't actually matter because the fft size should divide evenly by the overlap factor
         */
-        const float analysisOverlapFactorActual;
+        float analysisOverlapFactorActual{};
     } analysisFrames;
 
     //==============================================================================
@@ -191,11 +570,18 @@ private:
     StatefulRoundedNumber synthesisHopSize{StatefulRoundedNumber::roundDown};
 
     /**
-    * \brief The current pitch shift factor used by the resampler
+    * \brief The current pitch shift factor used by the resampler, or by the bin shifting with the #spectralPitchShift method
     *  \f[p[i]=2^{\frac{c[i]}{1200}}\f]
     */
     double pitchShiftFactor{};
 
+    PitchShiftingMethod pitchShiftingMethod{resamplingPitchShift};
+
+    /**
+     * \brief The method set by setPitchShiftingMethod, which is applied by applyPitchShiftingMethod
+     */
+    PitchShiftingMethod nextPitchShiftingMethod{resamplingPitchShift};
+
     /**
     * \brief The current pitch shift factor in cents
     * We store it in cents so we can compare it with #nextPitchShiftFactorCents and avoid calling std::pow unnecessarily
@@ -217,9 +603,9 @@ private:
     struct FftStruct
     {
         /**
-         * \brief The Fast Fourier Transform object.
+         * \brief The Fast Fourier Transform object. The library behind it is chosen at build time.
          */
-        dsp::FFT instance{fftOrder};
+        FftBackend instance{fftOrder};
 
         /**
          * \brief The time-domain data and the complex frequency domain data will both be on here.
@@ -270,12 +656,78 @@ private:
          */
         std::array<float, nComplexBins> scaled{};
 
+        /**
+         * \brief The new scaled phases of the current frame's peaks, indexed by bin. Only used for phase locking.
+         */
+        std::array<float, nComplexBins> peakPhases{};
+
         /**
          * \brief False for the first frame of every beat
          */
         bool initialized{};
     } previousFramePhases;
 
+    /**
+     * \brief The current frame in structure-of-arrays form, for the #vectorized #binScalingMethod
+     */
+    struct PolarSpectrum
+    {
+        alignas(32) std::array<float, nComplexBins> magnitudes{};
+
+        alignas(32) std::array<float, nComplexBins> phases{};
+
+        /**
+         * \brief The estimated true frequency of each bin, in (fractional) bins
+         */
+        alignas(32) std::array<float, nComplexBins> trueBinIndices{};
+
+        /**
+         * \brief The bins that are larger than their two neighbours on each side. Only the first #numPeaks are valid.
+         * Only calculated for phase locking.
+         */
+        std::array<int, nComplexBins> peaks{};
+
+        int numPeaks{};
+
+        /**
+         * \brief The peak whose region of influence each bin is in.
+         * The regions are split at the smallest bin between neighbouring peaks. If there are no peaks, each bin is its own region.
+         */
+        std::array<int, nComplexBins> regionPeaks{};
+
+        /**
+         * \brief #regionPeaks of the previous frame, for finding where each peak moved from.
+         */
+        std::array<int, nComplexBins> previousRegionPeaks{};
+
+        /**
+         * \brief True if this is the first frame of the beat, or the first frame after a silent one,
+         * in which case #trueBinIndices has not been calculated.
+         */
+        bool isFirstFrameOfBeat{};
+
+        /**
+         * \brief True if the frame was below the silence threshold, in which case nothing else has been calculated.
+         */
+        bool isSilent{};
+    } polarSpectrum;
+
+    /**
+     * \brief #polarSpectrum with its bins moved by the pitch shift factor, with the #spectralPitchShift method.
+     * Only the magnitudes, phases, true bin indices and peaks are used. The flags are only set on #polarSpectrum.
+     */
+    PolarSpectrum shiftedSpectrum;
+
+    /**
+     * \brief Whether inOut is garbage because the last frame was silent. See #silenceGatingMethod.
+     */
+    bool synthesisFrameIsSilent{};
+
+    /**
+     * \brief See setSynthesisEnabled
+     */
+    bool synthesisEnabled{true};
+
     //==============================================================================
     /**
      * \brief Set new pitch shift factor and related member variables
@@ -284,41 +736,108 @@ private:
      */
     void setParams(float newPitchShiftFactor, float newPitchShiftFactorCents);
 
+    /**
+     * \brief Choose \f$o_a\f$ for the current pitch shift factor according to #analysisOverlapMethod.
+     * Only call this when the analysis frames have just been reset.
+     */
+    void updateAnalysisOverlapFactor();
+
+    /**
+     * \brief Switch to #nextPitchShiftingMethod if it's different, unless that's #resamplingPitchShift and the resampler
+     * hasn't been allocated yet, in which case the bins are shifted. Only call this between beats.
+     * \return True if the method changed, in which case the params have to be set again
+     */
+    bool applyPitchShiftingMethod();
+
     //==============================================================================
 
     void pushResampledHopOnToAnalysisFrameBuffer();
 
+    /**
+     * \brief Write input straight onto the analysis frame buffer, for the #spectralPitchShift method.
+     * \param samples The audio data, or nullptr for zeros. It can't be longer than the rest of the current hop.
+     * \param numSamples The length of the span
+     * \return True if the hop was completed
+     */
+    bool pushSamplesOnToAnalysisFrameBuffer(const float* samples, int numSamples);
+
+    /**
+     * \brief Resample a hop and process a frame if the resampler inputQueue has enough samples.
+     * \return 0 if no new data available. Hop size if a new frame is available on inOut.
+     */
+    int processHopIfReady();
+
+    /**
+     * \brief Process a frame if a full frame has been written since the beat started.
+     * Call this whenever a new hop has been written onto the analysis frame buffer.
+     * \return 0 if no new data available. Hop size if a new frame is available on inOut.
+     */
+    int processFrameIfInitialized();
+
     //==============================================================================
     void scaleAnalysisFrame();
 
-    void copyAnalysisFrameToFftInOut();
+    /**
+     * \brief Multiply the latest analysis frame by the window and put it on inOut
+     */
+    void windowAnalysisFrameOntoFftInOut();
+
+    /**
+     * \return True if the latest analysis frame is below the silence threshold
+     */
+    [[nodiscard]] bool isAnalysisFrameSilent() const;
+
+    /**
+     * \brief Inverse transform, window and scale the complex bins on inOut
+     */
+    void synthesizeFrame();
 
     void scaleAllFrequencyBinsAndStorePhaseBuffers();
 
-    std::complex<float> scaleFrequencyBin(int k, float mag, float currentPhase, float oldPhase);
+    /**
+     * \brief The #vectorized version of scaleAllFrequencyBinsAndStorePhaseBuffers
+     */
+    void scaleAllFrequencyBinsAndStorePhaseBuffersVectorized();
 
     /**
-     * \brief if this is the first frame we've processed of this beat, just store the phases without scaling them
+     * \brief Update the unaltered phases (and #polarSpectrum) from the frame on inOut without scaling it,
+     * for when synthesis is disabled. The scaled phases go stale, but they are reset at the next beat anyway.
      */
-    void storePhasesInBuffer();
+    void storeAnalysisPhasesOnly();
 
-    //==============================================================================
     /**
-     * \brief Calculate the phase of a complex frequency bin
-     * \return The phase
+     * \brief Find the peaks and regions of influence of a spectrum for phase locking
+     * \param spectrum #polarSpectrum or #shiftedSpectrum
      */
-    static float complexBinPhase(std::complex<float> complexBin);
+    static void findSpectralPeaks(PolarSpectrum& spectrum);
 
     /**
-     * \brief Calculate the magnitude of a complex frequency bin
-     * \return The magnitude
+     * \brief With the #spectralPitchShift method, move the peak regions of #polarSpectrum into #shiftedSpectrum.
+     * Each bin of #shiftedSpectrum takes the phase and true frequency of the loudest bin that was moved into it.
+     * \return The spectrum to synthesize from: #shiftedSpectrum, or #polarSpectrum with the #resamplingPitchShift method
      */
-    static float complexBinMag(std::complex<float> complexBin);
+    PolarSpectrum& prepareSynthesisSpectrum();
 
-    static float calculateFrequencyDeviation(float oldPhase, float currentPhase, int k,
-                                             float analysisOverlapFactor, float analysisHopSize);
+    /**
+     * \return The spectrum that prepareSynthesisSpectrum last returned
+     */
+    [[nodiscard]] const PolarSpectrum& getSynthesisSpectrum() const
+    {
+        return pitchShiftingMethod == spectralPitchShift ? shiftedSpectrum : polarSpectrum;
+    }
 
-    static float wrapPhase(float phaseIn);
+    /**
+     * \brief Advance the scaled phases of the peaks of analysis, and lock the other bins to them, according to #phaseLockingMethod.
+     * \param analysis The polar spectrum of this instance, or of the phase vocoder whose analysis is shared
+     */
+    void lockPhasesToPeaks(const PolarSpectrum& analysis);
+
+    std::complex<float> scaleFrequencyBin(int k, float mag, float currentPhase, float oldPhase);
+
+    /**
+     * \brief if this is the first frame we've processed of this beat, just store the phases without scaling them
+     */
+    void storePhasesInBuffer();
 
     //==============================================================================
     JUCE_LEAK_DETECTOR(PhaseVocoder)
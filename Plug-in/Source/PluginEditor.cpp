@@ -21,6 +21,7 @@
 */
 
 #include "PluginEditor.h"
+#include "FftBackend.h"
 
 //==============================================================================
 GamelanizerAudioProcessorEditor::GamelanizerAudioProcessorEditor(GamelanizerAudioProcessor& p,
@@ -49,6 +50,7 @@ GamelanizerAudioProcessorEditor::GamelanizerAudioProcessorEditor(GamelanizerAudi
                                     ", made by Luke M. Craig for DAFx19.\n"
                                     + "Code repo available at\n"
                                     + "https://github.com/lukemcraig/DAFx19-Gamelanizer\n"
+                                    + "FFT backend: " + FftBackend::getName() + "\n"
 #ifdef JUCE_DEBUG
                                     + "DEBUG BUILD: " + __TIMESTAMP__
 #endif
@@ -72,6 +74,12 @@ GamelanizerAudioProcessorEditor::GamelanizerAudioProcessorEditor(GamelanizerAudi
         pitchSliderLabels[i].setJustificationType(Justification::horizontallyCentred);
         addAndMakeVisible(pitchSliderLabels[i]);
 
+        spectralPitchButtons[i].setClickingTogglesState(true);
+        spectralPitchButtons[i].setButtonText("Spectral");
+        spectralPitchAttachments[i].reset(
+            new ButtonAttachment(valueTreeState, gamelanizerParameters.getSpectralPitchId(i), spectralPitchButtons[i]));
+        addAndMakeVisible(spectralPitchButtons[i]);
+
         levelGroups[i].setText("Level " + String(i + 1));
         addAndMakeVisible(levelGroups[i]);
 
@@ -268,6 +276,8 @@ void GamelanizerAudioProcessorEditor::resized()
         lpfLabels[i].setBounds(filterArea.removeFromTop(16));
         lpfSliders[i].setBounds(filterArea);
 
+        spectralPitchButtons[i].setBounds(subdivisionLevelArea.removeFromBottom(18));
+
         pitchSliderLabels[i].setBounds(subdivisionLevelArea.removeFromTop(16));
         pitchSliders[i].setBounds(subdivisionLevelArea);
     }
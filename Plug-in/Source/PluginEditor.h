@@ -99,6 +99,9 @@ private:
     std::array<Label, GamelanizerConstants::maxLevels> pitchSliderLabels;
     std::array<std::unique_ptr<SliderAttachment>, GamelanizerConstants::maxLevels> pitchSliderAttachments;
 
+    std::array<TextButton, GamelanizerConstants::maxLevels> spectralPitchButtons;
+    std::array<std::unique_ptr<ButtonAttachment>, GamelanizerConstants::maxLevels> spectralPitchAttachments;
+
     std::array<Label, GamelanizerConstants::maxLevels> dropLabels;
     std::array<std::array<TextButton, 4>, GamelanizerConstants::maxLevels> dropButtons;
     std::array<std::array<std::unique_ptr<ButtonAttachment>, 4>, GamelanizerConstants::maxLevels> dropAttachments;
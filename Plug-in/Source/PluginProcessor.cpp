@@ -24,6 +24,11 @@
 #include "WindowingFunctions.h"
 #include <numeric>
 #include "ModuloSameSignAsDivisor.h"
+#include "FftBackend.h"
+#include "RealtimeSanitizer.h"
+#if MeasurePerformance
+#include "PerformanceBenchmarks.h"
+#endif
 
 //==============================================================================
 GamelanizerAudioProcessor::GamelanizerAudioProcessor()
@@ -40,6 +45,12 @@ GamelanizerAudioProcessor::GamelanizerAudioProcessor()
 
     jassert(currentBpm.is_lock_free());
     jassert(preventGuiBpmChange.is_lock_free());
+
+    // DBG is compiled out of release builds, which are the ones whose backend matters
+    Logger::writeToLog("Gamelanizer FFT backend: " + String(FftBackend::getName()));
+#if MeasurePerformance
+    PerformanceBenchmarks::runAll();
+#endif
 }
 
 //==============================================================================
@@ -48,33 +59,34 @@ void GamelanizerAudioProcessor::prepareToPlay(const double sampleRate, const int
 #if MeasurePerformance
     performanceMeasures.reset();
 #endif
+    levelsRenderer.prepare(sampleRate, jmax(1, samplesPerBlock));
+
+    allocateResamplers();
     for (auto& subdivisionLevel : subdivisionLevels)
         subdivisionLevel.preparePhaseVocoder();
 
-    const auto maxSamplesPerBeat = static_cast<int>(std::ceil(sampleRate * (60.0 / GamelanizerConstants::minBpm)));
-
-    // maxLatency could be slightly smaller depending on initWriteHeadsAndLatencyMethod but this should always be enough
-    const auto maxLatency = (maxSamplesPerBeat * 3) + 1;
-    baseDelayBuffer.data.setSize(1, maxLatency);
-    baseDelayBuffer.data.clear();
+    hostSampleRate = sampleRate;
 
-    levelsOutputBuffer.data.setSize(GamelanizerConstants::maxLevels, maxSamplesPerBeat * 4);
-    levelsOutputBuffer.data.clear();
+    const auto samplesPerBeat = static_cast<int>(std::ceil(sampleRate * (60.0 / currentBpm.load())));
+    tempoSizedBuffers.allocateNow(calculateTempoSizedBufferSizes(samplesPerBeat));
+    useTempoSizedBuffers();
 
     gamelanizerParametersVtsHelper.resetSmoothers(sampleRate);
 
-    hostSampleRate = sampleRate;
-
     prepareSamplesPerBeat();
 
-    for (auto& sl : subdivisionLevels)
-        sl.prepareFilters(samplesPerBlock);
+    levelsFilterBank.prepare(jmax(1, samplesPerBlock));
+
+    levelsInputBuffer.setSize(GamelanizerConstants::maxLevels, jmax(1, samplesPerBlock));
+    levelsPitchBuffer.setSize(GamelanizerConstants::maxLevels, jmax(1, samplesPerBlock));
+    segmentBuffer.setSize(OutputMixMatrix::numInputs, jmax(1, samplesPerBlock));
+    outputMixMatrix.prepare(getTotalNumOutputChannels(), jmax(1, samplesPerBlock));
+    gamelanizerParametersVtsHelper.prepareRamps(jmax(1, samplesPerBlock));
 }
 
 void GamelanizerAudioProcessor::reset()
 {
-    for (auto& sl : subdivisionLevels)
-        sl.resetFilters();
+    levelsFilterBank.reset();
 
 #if MeasurePerformance
     performanceMeasures.reset();
@@ -89,6 +101,69 @@ void GamelanizerAudioProcessor::setCurrentBpm(float newBpm)
     newBpm = jmax(newBpm, GamelanizerConstants::minBpm);
     currentBpm.store(newBpm);
     prepareSamplesPerBeat();
+    reallocateTempoSizedBuffersIfNeeded();
+}
+
+//==============================================================================
+TempoSizedBuffers::Sizes GamelanizerAudioProcessor::calculateTempoSizedBufferSizes(const int samplesPerBeat) const
+{
+    // there's no point in fitting beats longer than the ones at the lowest tempo
+    const auto longestBeat = static_cast<int>(std::ceil(hostSampleRate * (60.0 / GamelanizerConstants::minBpm)));
+    TempoSizedBuffers::Sizes sizes;
+    sizes.maxSamplesPerBeat = jmin(longestBeat,
+                                   static_cast<int>(std::ceil(samplesPerBeat * TempoSizedBuffers::headroom)));
+
+    // maxLatency could be slightly smaller depending on initWriteHeadsAndLatencyMethod but this should always be enough
+    const auto maxLatency = (sizes.maxSamplesPerBeat * 3) + 1;
+    sizes.baseDelayLength = maxLatency;
+
+    for (auto level = 0; level < GamelanizerConstants::maxLevels; ++level)
+        sizes.maxNoteLengths[level] = subdivisionLevels[level].calculateMaxNoteLength(sizes.maxSamplesPerBeat);
+    return sizes;
+}
+
+void GamelanizerAudioProcessor::reallocateTempoSizedBuffersIfNeeded()
+{
+    // prepareToPlay allocates them the first time
+    if (hostSampleRate <= 0.0)
+        return;
+
+    // setStateInformation changes the BPM without changing samplesPerBeatFractional, so fit whichever is longer
+    const auto samplesPerBeat = static_cast<int>(std::ceil(jmax(hostSampleRate * (60.0 / currentBpm.load()),
+                                                                samplesPerBeatFractional)));
+    if (tempoSizedBuffers.needsReallocation(samplesPerBeat))
+        tempoSizedBuffers.requestReallocation(calculateTempoSizedBufferSizes(samplesPerBeat));
+}
+
+void GamelanizerAudioProcessor::swapInReallocatedBuffers()
+{
+    jassert(!hostIsPlaying);
+    if (tempoSizedBuffers.swapInReallocation())
+        useTempoSizedBuffers();
+}
+
+void GamelanizerAudioProcessor::useTempoSizedBuffers()
+{
+    auto& allocation = tempoSizedBuffers.getCurrent();
+
+    auto* baseDelayData = allocation.baseDelay.data();
+    baseDelayBuffer.data.setDataToReferTo(&baseDelayData, 1, allocation.sizes.baseDelayLength);
+    baseDelayBuffer.writePosition = 0;
+    baseDelayBuffer.readPosition = 0;
+
+    std::array<float*, GamelanizerConstants::maxLevels> notesSamples{};
+    for (auto level = 0; level < GamelanizerConstants::maxLevels; ++level)
+        notesSamples[level] = allocation.levelNotes[level].data();
+    levelsOutputBuffer.prepare(notesSamples, allocation.sizes.maxNoteLengths);
+
+    taperEnvelopeCache.prepare(allocation.taperEnvelopes.data(), allocation.sizes.maxSamplesPerBeat);
+}
+
+void GamelanizerAudioProcessor::allocateResamplers()
+{
+    for (auto level = 0; level < GamelanizerConstants::maxLevels; ++level)
+        if (!gamelanizerParametersVtsHelper.isPitchShiftedSpectrally(level))
+            subdivisionLevels[level].pv->allocateResampler();
 }
 
 //==============================================================================
@@ -102,10 +177,13 @@ bool GamelanizerAudioProcessor::handleNotPlaying(const AudioPlayHead::CurrentPos
             // set the internal state to match the DAW
             hostIsPlaying = false;
             preventGuiBpmChange.store(false);
-            // clear out the data that was written to the internal buffers
+            // clear out the data that was written to the internal buffers, once the levels aren't writing to them
+            levelsRenderer.finishRendering();
             baseDelayBuffer.data.clear();
-            levelsOutputBuffer.data.clear();
+            levelsOutputBuffer.clear();
         }
+        // the tempo can only change now
+        swapInReallocatedBuffers();
         // since the host isn't playing let the calling method know to return early
         return true;
     }
@@ -120,13 +198,13 @@ void GamelanizerAudioProcessor::handleTimelineJump(const int64 hostTimeInSamples
         // if hostIsPlaying but hostSamples != hostSampleOughtToBe, that means the user jumped on the timeline
         // so clear the buffers
         baseDelayBuffer.data.clear();
-        levelsOutputBuffer.data.clear();
+        levelsOutputBuffer.clear();
     }
 }
 
 void GamelanizerAudioProcessor::simulateProcessing(const int64 hostTimeInSamples)
 {
-    processSamples(hostTimeInSamples, nullptr, nullptr, nullptr, nullptr, true);
+    processSamples(hostTimeInSamples, nullptr, nullptr, nullptr, true);
 }
 
 bool GamelanizerAudioProcessor::handleStandaloneApp() const
@@ -162,6 +240,17 @@ bool GamelanizerAudioProcessor::handleTimelineStateChange()
             // if the host wasn't playing but now it is, or if we jumped around             
             if (!hostIsPlaying || hostTimeInSamples != hostSampleOughtToBe)
             {
+                if (!hostIsPlaying)
+                {
+                    swapInReallocatedBuffers();
+                    // if the buffers for a new tempo are still being reallocated, wait for them as if we weren't playing
+                    if (tempoSizedBuffers.getCurrent().sizes.maxSamplesPerBeat
+                        < static_cast<int>(std::ceil(samplesPerBeatFractional)))
+                        return true;
+                }
+
+                // the levels are reset on this thread
+                levelsRenderer.finishRendering();
                 handleTimelineJump(hostTimeInSamples);
 
                 hostIsPlaying = true;
@@ -198,11 +287,11 @@ bool GamelanizerAudioProcessor::handleTimelineStateChange()
 void GamelanizerAudioProcessor::processBlock(AudioBuffer<float>& buffer, MidiBuffer& /*midiMessages*/)
 {
     ScopedNoDenormals noDenormals;
+    const RealtimeSanitizer::ScopedRealtimeContext realtimeContext;
 
     gamelanizerParametersVtsHelper.updateSmoothers();
 
-    for (auto& sl : subdivisionLevels)
-        sl.snapFiltersToZero();
+    levelsFilterBank.snapToZero();
 
     // initialization of member fields or return early if not playing
     if (handleTimelineStateChange()) return;
@@ -220,118 +309,257 @@ void GamelanizerAudioProcessor::processBlock(AudioBuffer<float>& buffer, MidiBuf
     auto* monoInputRead = buffer.getReadPointer(0);
     auto* multiOutWrite = buffer.getArrayOfWritePointers();
     auto* baseDelayBufferWrite = baseDelayBuffer.data.getWritePointer(0);
-    auto* levelsBufferWrite = levelsOutputBuffer.data.getArrayOfWritePointers();
-    processSamples(numSamples, monoInputRead, multiOutWrite, baseDelayBufferWrite, levelsBufferWrite, false);
+    processSamples(numSamples, monoInputRead, multiOutWrite, baseDelayBufferWrite, false);
 }
 
 void GamelanizerAudioProcessor::processSamples(const int64 numSamples, const float* monoInputRead,
                                                float** multiOutWrite, float* baseDelayBufferReadWrite,
-                                               float** levelsBufferReadWrite, const bool skipProcessing)
+                                               const bool skipProcessing)
 {
 #if MeasurePerformance
     const auto startingTime = PerformanceMeasures::getNewStartingTime();
 #endif
-    const auto levelOutBufferLength = levelsOutputBuffer.data.getNumSamples();
     const auto baseDelayBufferLength = baseDelayBuffer.data.getNumSamples();
-    for (auto sample = 0; sample < numSamples; ++sample)
+    const auto numOutputChannels = outputMixMatrix.getNumOutputChannels();
+    const auto levelsInputBufferLength = levelsInputBuffer.getNumSamples();
+
+    int64 sample = 0;
+    while (sample < numSamples)
     {
+        // the block is split into segments that end on beat boundaries, or when levelsInputBuffer is full
+        const auto numSamplesLeftInBeat = beatSampleInfo.getNumSamplesLeftInBeat();
+        auto numSegmentSamples = static_cast<int>(jmin(numSamples - sample, static_cast<int64>(numSamplesLeftInBeat)));
+
         if (!skipProcessing)
         {
-            const auto sampleData = monoInputRead[sample];
+            // the host can send more samples than it said it would in prepareToPlay
+            numSegmentSamples = jmin(numSegmentSamples, levelsInputBufferLength);
 
-            // store new input sample into delay buffer
-            baseDelayBufferReadWrite[baseDelayBuffer.writePosition] = sampleData;
+            // a taper that finishes smoothing partway through the segment still changed its input, so this is
+            // checked before the ramps move the smoothers on
+            const auto haveIdenticalInput = findLevelsWithIdenticalInput();
 
             // have to apply gain changes here to get it to sync with automation
-            const auto baseGain = gamelanizerParametersVtsHelper.getGain(0)
-                * (1.0f - gamelanizerParametersVtsHelper.getMute(0));
-            const auto baseOutput = baseDelayBufferReadWrite[baseDelayBuffer.readPosition] * baseGain;
-            const auto basePanAmplitude = gamelanizerParametersVtsHelper.getPan(0) / 200.0f + 0.5f;
+            gamelanizerParametersVtsHelper.generateRamps(numSegmentSamples);
+            outputMixMatrix.update(gamelanizerParametersVtsHelper, numSegmentSamples);
+
+            // the input and the left output are the same channel, so the input is used up before the outputs are written
+            processLevelsInputSegment(monoInputRead + sample, numSegmentSamples, haveIdenticalInput);
+            processBaseSegment(monoInputRead + sample, baseDelayBufferReadWrite, numSegmentSamples);
+            processLevelsOutputSegment(numSegmentSamples);
+
+            std::array<const float*, OutputMixMatrix::numInputs> mixInputs{};
+            for (auto input = 0; input < OutputMixMatrix::numInputs; ++input)
+                mixInputs[input] = segmentBuffer.getReadPointer(input);
+
+            std::array<float*, OutputMixMatrix::maxOutputChannels> segmentOutWrite{};
+            for (auto channel = 0; channel < numOutputChannels; ++channel)
+                segmentOutWrite[channel] = multiOutWrite[channel] + sample;
+            outputMixMatrix.mix(mixInputs, segmentOutWrite.data(), numSegmentSamples);
+        }
 
-            // base - stereo out
-            multiOutWrite[0][sample] = std::sqrt(1.0f - basePanAmplitude) * baseOutput;
-            multiOutWrite[1][sample] = std::sqrt(basePanAmplitude) * baseOutput;
+        // if the segment ends on a beat boundary
+        if (numSegmentSamples == numSamplesLeftInBeat)
+            nextBeat();
+        else
+            beatSampleInfo.incrementSamplesIntoBeat(numSegmentSamples);
 
-            // base - individual out
-            if (getTotalNumOutputChannels() > 3)
-                multiOutWrite[2][sample] = baseOutput;
+        // update indices and circle them back around if necessary
+        levelsOutputBuffer.readPosition += numSegmentSamples;
 
-            // subdivision levels
-            for (auto level = 0; level < GamelanizerConstants::maxLevels; ++level)
-            {
-                // +1 is because base level is stored in this too
-                const auto levelGain = gamelanizerParametersVtsHelper.getGain(level + 1)
-                    * (1.0f - gamelanizerParametersVtsHelper.getMute(level + 1));
+        baseDelayBuffer.writePosition += numSegmentSamples;
+        if (baseDelayBuffer.writePosition >= baseDelayBufferLength)
+            baseDelayBuffer.writePosition -= baseDelayBufferLength;
 
-                const auto levelOutput = levelsBufferReadWrite[level][levelsOutputBuffer.readPosition] * levelGain;
+        baseDelayBuffer.readPosition += numSegmentSamples;
+        if (baseDelayBuffer.readPosition >= baseDelayBufferLength)
+            baseDelayBuffer.readPosition -= baseDelayBufferLength;
 
-                // erase head so the circular buffer can overlap when it wraps around 
-                levelsBufferReadWrite[level][levelsOutputBuffer.readPosition] = 0.0f;
+        hostSampleOughtToBe += numSegmentSamples;
+        sample += numSegmentSamples;
+    }
+#if MeasurePerformance
+    // the measurements are written to a file when they're done
+    const RealtimeSanitizer::ScopedSuspend suspendRealtimeChecks;
+    performanceMeasures.finishMeasurements(startingTime, hostSampleOughtToBe);
+#endif
+}
 
-                subdivisionLevels[level].updateFilters();
+void GamelanizerAudioProcessor::processBaseSegment(const float* monoInputRead, float* baseDelayBufferReadWrite,
+                                                   const int numSamples)
+{
+    auto* baseOutput = segmentBuffer.getWritePointer(0);
 
-                auto levelOutputFiltered = subdivisionLevels[level].lpFilter.processSample(levelOutput);
-                levelOutputFiltered = subdivisionLevels[level].hpFilter.processSample(levelOutputFiltered);
-                const auto levelPanAmplitude = gamelanizerParametersVtsHelper.getPan(level + 1) / 200.0f + 0.5f;
-                // stereo out
-                multiOutWrite[0][sample] += std::sqrt(1.0f - levelPanAmplitude) * levelOutputFiltered;
-                multiOutWrite[1][sample] += std::sqrt(levelPanAmplitude) * levelOutputFiltered;
+    // the delay is longer than a beat, so every sample read here was written before this segment.
+    // Reading first means the write can't overwrite any of them, even when the delay is almost the buffer's length.
+    const auto baseDelayBufferLength = baseDelayBuffer.data.getNumSamples();
+    for (auto done = 0, readPosition = baseDelayBuffer.readPosition; done < numSamples;)
+    {
+        const auto numBeforeWrap = jmin(numSamples - done, baseDelayBufferLength - readPosition);
+        FloatVectorOperations::copy(baseOutput + done, baseDelayBufferReadWrite + readPosition, numBeforeWrap);
+        done += numBeforeWrap;
+        readPosition = 0;
+    }
+    outputMixMatrix.applyGain(0, baseOutput, numSamples);
 
-                // individual out (+3 is to skip the stereo out and base channels)
-                if (level + 3 < getTotalNumOutputChannels())
-                    multiOutWrite[level + 3][sample] = levelOutputFiltered;
+    // store the new input samples into the delay buffer, before the mix overwrites them
+    for (auto done = 0, writePosition = baseDelayBuffer.writePosition; done < numSamples;)
+    {
+        const auto numBeforeWrap = jmin(numSamples - done, baseDelayBufferLength - writePosition);
+        FloatVectorOperations::copy(baseDelayBufferReadWrite + writePosition, monoInputRead + done, numBeforeWrap);
+        done += numBeforeWrap;
+        writePosition = 0;
+    }
+}
 
-                // =========================
+void GamelanizerAudioProcessor::processLevelsOutputSegment(const int numSamples)
+{
+    // a level rendered on the background thread might not have finished the notes that are heard in this segment yet,
+    // in which case the audio thread renders them itself
+    const auto segmentEnd = levelsOutputBuffer.readPosition + numSamples;
+    const auto areAllFinished = levelsRenderer.catchUp([this, segmentEnd]
+    {
+        for (auto level = 0; level < GamelanizerConstants::maxLevels; ++level)
+            if (!levelsOutputBuffer.isFinishedUpTo(level, segmentEnd))
+                return false;
+        return true;
+    });
+    // everything the notes depend on was passed on before this segment
+    jassert(areAllFinished);
+    ignoreUnused(areAllFinished);
+
+    // the inactive levels are read too, so the notes they rendered before they were deactivated are heard
+    std::array<float*, GamelanizerConstants::maxLevels> levelOutputs{};
+    for (auto level = 0; level < GamelanizerConstants::maxLevels; ++level)
+    {
+        // +1 is because base level is stored in this too
+        levelOutputs[level] = segmentBuffer.getWritePointer(level + 1);
+        // every copy of the level's notes that is heard in this segment
+        levelsOutputBuffer.readSamples(level, levelOutputs[level], numSamples);
 
-                subdivisionLevels[level].queuePhaseVocoderNextParams();
+        // the gain and mute ramps are applied before the filters, like the per-sample loop did
+        outputMixMatrix.applyGain(level + 1, levelOutputs[level], numSamples);
+    }
 
-                const auto taperAlpha = gamelanizerParametersVtsHelper.getTaper(level);
-                const auto taperedSampleData = sampleData * WindowingFunctions::tukeyWindow(
-                    beatSampleInfo.getSamplesIntoBeat(), beatSampleInfo.getBeatSampleLength(), taperAlpha);
-                subdivisionLevels[level].processSample(taperedSampleData);
-            }
-        }
+    // all the levels are filtered together, but the cutoffs still change on the same samples as they would on their own
+    levelsFilterBank.process(levelOutputs, numSamples, [this, &levelOutputs]
+    {
+        for (auto& subdivisionLevel : subdivisionLevels)
+            subdivisionLevel.updateFilters();
+    });
+}
 
-        // if we're on a beat boundary
-        if (beatSampleInfo.isPastBeatEnd())
-            nextBeat();
-        else
-            beatSampleInfo.incrementSamplesIntoBeat();
+void GamelanizerAudioProcessor::processLevelsInputSegment(const float* monoInputRead, const int numSamples,
+                                                          const SubdivisionLevelsRenderer::IdenticalInputs&
+                                                          haveIdenticalInput)
+{
+    const auto samplesIntoBeat = beatSampleInfo.getSamplesIntoBeat();
+    const auto beatSampleLength = beatSampleInfo.getBeatSampleLength();
+
+    // the inactive levels stay nullptr
+    std::array<const float*, GamelanizerConstants::maxLevels> levelInputs{};
+    // and so do the ones whose pitch isn't changing
+    std::array<const float*, GamelanizerConstants::maxLevels> levelPitches{};
+    for (auto level = 0; level < GamelanizerConstants::maxLevels; ++level)
+    {
+        if (!subdivisionLevels[level].isActive())
+            continue;
 
-        // update indices and circle them back around if necessary
-        ++levelsOutputBuffer.readPosition;
-        if (levelsOutputBuffer.readPosition == levelOutBufferLength)
-            levelsOutputBuffer.readPosition = 0;
+        const auto& taper = gamelanizerParametersVtsHelper.getTaperRamp(level);
+        auto* levelInputWrite = levelsInputBuffer.getWritePointer(level);
+        if (taper.isConstant())
+        {
+            taperEnvelopeCache.applyTaper(monoInputRead, levelInputWrite, numSamples, samplesIntoBeat,
+                                          beatSampleLength, taper.value);
+        }
+        else
+        {
+            // the envelope changes every sample while the taper is being smoothed
+            for (auto i = 0; i < numSamples; ++i)
+                levelInputWrite[i] = monoInputRead[i] * WindowingFunctions::tukeyWindow(
+                    samplesIntoBeat + i, beatSampleLength, taper[i]);
+        }
+        levelInputs[level] = levelInputWrite;
 
-        ++baseDelayBuffer.writePosition;
-        if (baseDelayBuffer.writePosition == baseDelayBufferLength)
-            baseDelayBuffer.writePosition = 0;
+        auto* levelPitchWrite = levelsPitchBuffer.getWritePointer(level);
+        auto pitchWasChanged = false;
+        for (auto i = 0; i < numSamples; ++i)
+        {
+            const auto pitch = gamelanizerParametersVtsHelper.getPitch(level, true);
+            levelPitchWrite[i] = pitch.value;
+            pitchWasChanged = pitchWasChanged || pitch.wasChanged;
+        }
+        if (pitchWasChanged)
+            levelPitches[level] = levelPitchWrite;
+    }
 
-        ++baseDelayBuffer.readPosition;
-        if (baseDelayBuffer.readPosition == baseDelayBufferLength)
-            baseDelayBuffer.readPosition = 0;
+    levelsRenderer.processSegment(levelInputs, levelPitches, numSamples, haveIdenticalInput);
+}
 
-        ++hostSampleOughtToBe;
+SubdivisionLevelsRenderer::IdenticalInputs GamelanizerAudioProcessor::findLevelsWithIdenticalInput() const
+{
+    SubdivisionLevelsRenderer::IdenticalInputs haveIdenticalInput{};
+    if (SubdivisionLevelsRenderer::analysisSharingMethod == SubdivisionLevelsRenderer::sharedAnalysis)
+    {
+        for (auto level = 0; level < GamelanizerConstants::maxLevels; ++level)
+            for (auto producer = 0; producer < level; ++producer)
+                haveIdenticalInput[producer][level] =
+                    gamelanizerParametersVtsHelper.levelsHaveIdenticalPhaseVocoderInput(producer, level);
     }
-#if MeasurePerformance
-    performanceMeasures.finishMeasurements(startingTime, hostSampleOughtToBe);
-#endif
+    return haveIdenticalInput;
 }
 
 //==============================================================================
 
 void GamelanizerAudioProcessor::nextBeat()
 {
-    for (auto& sl : subdivisionLevels)
+    SubdivisionLevelsRenderer::BeatEnd beatEnd;
+    beatEnd.wasBeatB = beatSampleInfo.isBeatB();
+    auto needsResamplers = false;
+    for (auto level = 0; level < GamelanizerConstants::maxLevels; ++level)
+    {
+        beatEnd.pitchShiftedSpectrally[level] = gamelanizerParametersVtsHelper.isPitchShiftedSpectrally(level);
+        needsResamplers = needsResamplers
+            || (!beatEnd.pitchShiftedSpectrally[level] && !subdivisionLevels[level].pv->hasResampler());
+    }
+    // the levels that were switched to resampling keep shifting their bins until their resamplers are allocated
+    if (needsResamplers)
     {
-        sl.processFinalHop();
-        sl.fastForwardWriteHeadsToNextBeat();
-        sl.pv.resetBetweenBeats();
-        if (beatSampleInfo.isBeatB())
-            sl.moveWritePosOnBeatB();
+        if (isNonRealtime())
+            allocateResamplers();
+        else
+            triggerAsyncUpdate();
+    }
+    levelsRenderer.finishBeat(beatEnd);
+
+    if (levelDeactivationMethod == deactivateInaudibleLevels)
+    {
+        std::array<bool, GamelanizerConstants::maxLevels> shouldBeActive{};
+        auto activationChanged = false;
+        for (auto level = 0; level < GamelanizerConstants::maxLevels; ++level)
+        {
+            shouldBeActive[level] = !gamelanizerParametersVtsHelper.isInaudible(level + 1);
+            activationChanged = activationChanged || shouldBeActive[level] != subdivisionLevels[level].isActive();
+        }
+
+        if (activationChanged)
+        {
+            // the levels are (de)activated on this thread
+            levelsRenderer.finishRendering();
+            for (auto level = 0; level < GamelanizerConstants::maxLevels; ++level)
+                subdivisionLevels[level].setActive(shouldBeActive[level]);
+        }
     }
 
+    SubdivisionLevelsRenderer::BeatStart beatStart;
+    beatStart.haveIdenticalInput = findLevelsWithIdenticalInput();
+
     beatSampleInfo.setNextBeatInfo();
+
+    beatStart.beatSampleLength = beatSampleInfo.getBeatSampleLength();
+    for (auto level = 0; level < GamelanizerConstants::maxLevels; ++level)
+        beatStart.droppedCopies[level] = subdivisionLevels[level].calculateDroppedCopies();
+    levelsRenderer.startBeat(beatStart);
 }
 
 //==============================================================================
@@ -459,6 +687,7 @@ void GamelanizerAudioProcessor::setStateInformation(const void* data, const int
         {
             currentBpm.store(static_cast<float>(xmlState->getDoubleAttribute("currentBpm", 120.0)));
             xmlState->removeAttribute("currentBpm");
+            reallocateTempoSizedBuffersIfNeeded();
         }
         if (xmlState->hasTagName(audioProcessorValueTreeState.state.getType()))
         {
@@ -29,6 +29,10 @@
 #include "BeatSampleInfo.h"
 #include "SubdivisionLevel.h"
 #include "SubdivisionLevelsOutputBuffer.h"
+#include "SubdivisionLevelsRenderer.h"
+#include "TempoSizedBuffers.h"
+#include "TaperEnvelopeCache.h"
+#include "OutputMixMatrix.h"
 #if MeasurePerformance
 #include "PerformanceMeasures.h"
 #endif
@@ -40,8 +44,14 @@
 /**
  * \brief The main class for the plug-in
  */
-class GamelanizerAudioProcessor final : public AudioProcessor
+class GamelanizerAudioProcessor final : public AudioProcessor, private AsyncUpdater
 {
+    /**
+     * \brief Renders through the processor for the tests, and compares processSamples to processing one sample
+     * at a time, so it drives the private stages directly
+     */
+    friend class TestRender;
+
 public:
     //==============================================================================
     /**
@@ -70,9 +80,9 @@ public:
     GamelanizerAudioProcessor& operator=(GamelanizerAudioProcessor&&) = delete;
 
     /**
-     * \brief Default destructor.
+     * \brief Destructor. Cancels any resampler allocation that hasn't happened yet.
      */
-    ~GamelanizerAudioProcessor() = default;
+    ~GamelanizerAudioProcessor() override { cancelPendingUpdate(); }
 
     //==============================================================================
 
@@ -116,6 +126,12 @@ public:
      */
     void setCurrentBpm(float newBpm);
 
+    /**
+     * \brief Thread safe way to know how much memory the base delay buffer, #levelsOutputBuffer and #taperEnvelopeCache take.
+     * \return The size in bytes
+     */
+    size_t getTempoSizedBuffersSizeInBytes() const { return tempoSizedBuffers.getSizeInBytes(); }
+
     //==============================================================================
 
     /**
@@ -151,7 +167,7 @@ private:
      * \brief The sample rate that the host reports in prepareToPlay().
      * \f[f_s\f]
      *  
-     * Used for #samplesPerBeatFractional and the SubdivisionLevel::lpFilter and SubdivisionLevel::hpFilter.
+     * Used for #samplesPerBeatFractional and the filter cutoffs of #levelsFilterBank.
      */
     double hostSampleRate{};
 
@@ -193,13 +209,18 @@ private:
 
     //==============================================================================
 
+    /**
+     * \brief The memory of #baseDelayBuffer, #levelsOutputBuffer and #taperEnvelopeCache, sized for #currentBpm.
+     */
+    TempoSizedBuffers tempoSizedBuffers;
+
     /**
      * \brief The circular buffer for delaying the base level.
      */
     struct BaseDelayBuffer
     {
         /**
-         * \brief The actual buffer
+         * \brief The actual buffer. It refers to memory in #tempoSizedBuffers.
          */
         AudioBuffer<float> data;
         /**
@@ -235,18 +256,33 @@ private:
      */
     SubdivisionLevelsOutputBuffer levelsOutputBuffer;
 
+    /**
+     * \brief The low-pass and high-pass filters of the subdivision levels
+     */
+    SubdivisionLevelsFilterBank levelsFilterBank;
+
+    /**
+     * \brief The taper envelopes of the subdivision levels' input
+     */
+    TaperEnvelopeCache taperEnvelopeCache;
+
     /**
      * \brief The subdivision level processors
      */
     std::array<SubdivisionLevel, GamelanizerConstants::maxLevels> subdivisionLevels{
         {
-            {0, beatSampleInfo, gamelanizerParametersVtsHelper, levelsOutputBuffer, hostSampleRate},
-            {1, beatSampleInfo, gamelanizerParametersVtsHelper, levelsOutputBuffer, hostSampleRate},
-            {2, beatSampleInfo, gamelanizerParametersVtsHelper, levelsOutputBuffer, hostSampleRate},
-            {3, beatSampleInfo, gamelanizerParametersVtsHelper, levelsOutputBuffer, hostSampleRate}
+            {0, beatSampleInfo, gamelanizerParametersVtsHelper, levelsOutputBuffer, levelsFilterBank, hostSampleRate},
+            {1, beatSampleInfo, gamelanizerParametersVtsHelper, levelsOutputBuffer, levelsFilterBank, hostSampleRate},
+            {2, beatSampleInfo, gamelanizerParametersVtsHelper, levelsOutputBuffer, levelsFilterBank, hostSampleRate},
+            {3, beatSampleInfo, gamelanizerParametersVtsHelper, levelsOutputBuffer, levelsFilterBank, hostSampleRate}
         }
     };
 
+    /**
+     * \brief Runs the #subdivisionLevels on their input, on the audio thread or a background thread
+     */
+    SubdivisionLevelsRenderer levelsRenderer{subdivisionLevels};
+
     //==============================================================================
 
     /**
@@ -255,11 +291,63 @@ private:
      * \param monoInputRead A read only pointer to the incoming audio block (mono)
      * \param multiOutWrite Write pointers to the outgoing audio block (stereo + 5 mono)
      * \param baseDelayBufferReadWrite A write pointer to BaseDelayBuffer::data
-     * \param levelsBufferReadWrite Write pointers to #SubdivisionLevelsOutputBuffer::data
      * \param skipProcessing If true, skip intense processing in order to get the buffer position states correct
      */
     void processSamples(int64 numSamples, const float* monoInputRead, float** multiOutWrite,
-                        float* baseDelayBufferReadWrite, float** levelsBufferReadWrite, bool skipProcessing);
+                        float* baseDelayBufferReadWrite, bool skipProcessing);
+
+    /**
+     * \brief Delay a segment of the input for the base level and apply its gain, into #segmentBuffer.
+     * A segment never goes past a beat boundary.
+     * \param monoInputRead The input samples of the segment
+     * \param baseDelayBufferReadWrite A write pointer to BaseDelayBuffer::data
+     * \param numSamples The length of the segment
+     */
+    void processBaseSegment(const float* monoInputRead, float* baseDelayBufferReadWrite, int numSamples);
+
+    /**
+     * \brief Read a segment of each active level from #levelsOutputBuffer, apply its gain and filter it, into #segmentBuffer.
+     * \param numSamples The length of the segment
+     */
+    void processLevelsOutputSegment(int numSamples);
+
+    /**
+     * \brief Taper a segment of the input for each active level into #levelsInputBuffer, get the pitches of the ones
+     * whose pitch is being smoothed into #levelsPitchBuffer, and pass them on to #levelsRenderer.
+     * \param monoInputRead The input samples of the segment
+     * \param numSamples The length of the segment
+     * \param haveIdenticalInput findLevelsWithIdenticalInput from before the segment's ramps were generated
+     */
+    void processLevelsInputSegment(const float* monoInputRead, int numSamples,
+                                   const SubdivisionLevelsRenderer::IdenticalInputs& haveIdenticalInput);
+
+    /**
+     * \return GamelanizerParametersVtsHelper::levelsHaveIdenticalPhaseVocoderInput for each producer and higher level,
+     * or all false with SubdivisionLevelsRenderer::independentAnalysis
+     */
+    [[nodiscard]] SubdivisionLevelsRenderer::IdenticalInputs findLevelsWithIdenticalInput() const;
+
+    /**
+     * \brief The output of each level before it's mixed, for one segment at a time. Channel 0 is the base level and
+     * channel n + 1 is subdivision level n, like the inputs of #outputMixMatrix.
+     * It's as long as #levelsInputBuffer, which limits the length of a segment.
+     */
+    AudioBuffer<float> segmentBuffer;
+
+    /**
+     * \brief Applies the gains and mutes to #segmentBuffer, and mixes it into the output channels with the pans
+     */
+    OutputMixMatrix outputMixMatrix;
+
+    /**
+     * \brief The tapered input of each subdivision level, for one segment at a time
+     */
+    AudioBuffer<float> levelsInputBuffer;
+
+    /**
+     * \brief The pitch of each subdivision level for every sample of the segment, for SubdivisionLevelsRenderer::processSegment
+     */
+    AudioBuffer<float> levelsPitchBuffer;
 
     //==============================================================================
     /**
@@ -267,6 +355,31 @@ private:
      */
     void nextBeat();
 
+    /**
+     * \brief Whether subdivision levels that can't be heard keep processing.
+     */
+    enum LevelDeactivationMethod
+    {
+        /**
+         * \brief Every level always processes its input, even while it's muted or has 0 gain.
+         */
+        alwaysActive,
+
+        /**
+         * \brief At every beat boundary, levels that are muted or have 0 gain (and aren't being smoothed) are deactivated,
+         * so they stop getting input and rendering notes. They are still read, so the notes they had already rendered
+         * play out, and their phase vocoders keep their state. A level is reactivated at the first beat boundary after
+         * its gain or mute starts changing. See SubdivisionLevel::setActive.
+         * That happens on the audio thread, so #levelsRenderer has to catch up first.
+         * The beats a level skipped stay silent, so when it's unmuted after its rendered notes have ended, it's only heard
+         * again once the output reaches the beat it was reactivated at, up to the latency later.
+         * That's why this isn't the default.
+         */
+        deactivateInaudibleLevels
+    };
+
+    static constexpr LevelDeactivationMethod levelDeactivationMethod = alwaysActive;
+
     //==============================================================================
     /**
      * \brief calculates #samplesPerBeatFractional and resets #beatSampleInfo.
@@ -365,6 +478,45 @@ private:
      */
     void simulateProcessing(int64 hostTimeInSamples);
 
+    //==============================================================================
+
+    /**
+     * \brief Calculate how long the tempo sized buffers have to be, with TempoSizedBuffers::headroom.
+     * \param samplesPerBeat The length of the beats that they have to fit
+     */
+    TempoSizedBuffers::Sizes calculateTempoSizedBufferSizes(int samplesPerBeat) const;
+
+    /**
+     * \brief If the buffers don't fit #currentBpm, or are much bigger than they need to be, reallocate them
+     * on the background thread. They're swapped in before playback starts.
+     */
+    void reallocateTempoSizedBuffersIfNeeded();
+
+    /**
+     * \brief Called from the audio thread while the host isn't playing. If the reallocated buffers are ready,
+     * point #baseDelayBuffer and #levelsOutputBuffer at them.
+     */
+    void swapInReallocatedBuffers();
+
+    /**
+     * \brief Point #baseDelayBuffer, #levelsOutputBuffer and #taperEnvelopeCache at the current memory of #tempoSizedBuffers.
+     */
+    void useTempoSizedBuffers();
+
+    //==============================================================================
+    /**
+     * \brief Allocate the resamplers of the levels that don't shift their pitch spectrally, if they haven't been yet.
+     * See PvResampler::allocateInputQueue. This is called from prepareToPlay and on the message thread,
+     * except when rendering offline, where the audio thread doesn't have to stay real time.
+     */
+    void allocateResamplers();
+
+    /**
+     * \brief Called on the message thread when a level was switched to resampling during playback.
+     * That level keeps shifting its bins until the next beat after this.
+     */
+    void handleAsyncUpdate() override { allocateResamplers(); }
+
     //==============================================================================
     JUCE_LEAK_DETECTOR(GamelanizerAudioProcessor)
 
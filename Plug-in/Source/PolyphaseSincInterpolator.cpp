@@ -0,0 +1,338 @@
+/*
+  ==============================================================================
+
+	This file is part of Gamelanizer.
+	Copyright (c) 2019 - Luke McDuffie Craig.
+
+	Gamelanizer is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Gamelanizer is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Gamelanizer. If not, see <https://www.gnu.org/licenses/>.
+
+  ==============================================================================
+*/
+
+#include "PolyphaseSincInterpolator.h"
+#include "WindowingFunctions.h"
+
+#if defined(__AVX2__)
+ #include <immintrin.h>
+ #define GAMELANIZER_SIMD_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+ #include <emmintrin.h>
+ #define GAMELANIZER_SIMD_SSE2 1
+#endif
+
+namespace
+{
+    struct QualitySettings
+    {
+        /**
+         * \brief The kernel length when the speed ratio is 1 or less
+         */
+        int numTaps;
+
+        int numPhases;
+
+        /**
+         * \brief The shape parameter of WindowingFunctions::kaiserWindow
+         */
+        double kaiserBeta;
+
+        /**
+         * \brief The cutoff as a proportion of the output's Nyquist frequency, which leaves room for the transition band
+         */
+        double cutoff;
+    };
+
+    constexpr QualitySettings qualitySettings[]{
+        {8, 16, 6.0, 0.8},
+        {16, 32, 8.0, 0.88},
+        {32, 64, 10.0, 0.92}
+    };
+
+    /**
+     * \brief The inner product of input with one phase. numTaps has to be a multiple of 8.
+     */
+    float dotProduct(const float* input, const float* phase, const int numTaps) noexcept
+    {
+        jassert(numTaps % 8 == 0);
+#if GAMELANIZER_SIMD_AVX2
+        auto accumulator = _mm256_setzero_ps();
+        for (auto i = 0; i < numTaps; i += 8)
+            accumulator = _mm256_add_ps(accumulator, _mm256_mul_ps(_mm256_loadu_ps(input + i),
+                                                                   _mm256_loadu_ps(phase + i)));
+        alignas(32) float lanes[8];
+        _mm256_store_ps(lanes, accumulator);
+        return ((lanes[0] + lanes[4]) + (lanes[1] + lanes[5])) + ((lanes[2] + lanes[6]) + (lanes[3] + lanes[7]));
+#elif GAMELANIZER_SIMD_SSE2
+        auto accumulator = _mm_setzero_ps();
+        for (auto i = 0; i < numTaps; i += 4)
+            accumulator = _mm_add_ps(accumulator, _mm_mul_ps(_mm_loadu_ps(input + i), _mm_loadu_ps(phase + i)));
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, accumulator);
+        return (lanes[0] + lanes[2]) + (lanes[1] + lanes[3]);
+#else
+        auto sum = 0.0f;
+        for (auto i = 0; i < numTaps; ++i)
+            sum += input[i] * phase[i];
+        return sum;
+#endif
+    }
+
+    /**
+     * \brief The inner products of input with two adjacent phases. numTaps has to be a multiple of 8.
+     */
+    void dotProductWithTwoPhases(const float* input, const float* phaseA, const float* phaseB, const int numTaps,
+                                 float& sumA, float& sumB) noexcept
+    {
+        jassert(numTaps % 8 == 0);
+#if GAMELANIZER_SIMD_AVX2
+        auto accumulatorA = _mm256_setzero_ps();
+        auto accumulatorB = _mm256_setzero_ps();
+        for (auto i = 0; i < numTaps; i += 8)
+        {
+            const auto x = _mm256_loadu_ps(input + i);
+            accumulatorA = _mm256_add_ps(accumulatorA, _mm256_mul_ps(x, _mm256_loadu_ps(phaseA + i)));
+            accumulatorB = _mm256_add_ps(accumulatorB, _mm256_mul_ps(x, _mm256_loadu_ps(phaseB + i)));
+        }
+        alignas(32) float lanesA[8];
+        alignas(32) float lanesB[8];
+        _mm256_store_ps(lanesA, accumulatorA);
+        _mm256_store_ps(lanesB, accumulatorB);
+        sumA = ((lanesA[0] + lanesA[4]) + (lanesA[1] + lanesA[5])) + ((lanesA[2] + lanesA[6]) + (lanesA[3] + lanesA[7]));
+        sumB = ((lanesB[0] + lanesB[4]) + (lanesB[1] + lanesB[5])) + ((lanesB[2] + lanesB[6]) + (lanesB[3] + lanesB[7]));
+#elif GAMELANIZER_SIMD_SSE2
+        auto accumulatorA = _mm_setzero_ps();
+        auto accumulatorB = _mm_setzero_ps();
+        for (auto i = 0; i < numTaps; i += 4)
+        {
+            const auto x = _mm_loadu_ps(input + i);
+            accumulatorA = _mm_add_ps(accumulatorA, _mm_mul_ps(x, _mm_loadu_ps(phaseA + i)));
+            accumulatorB = _mm_add_ps(accumulatorB, _mm_mul_ps(x, _mm_loadu_ps(phaseB + i)));
+        }
+        alignas(16) float lanesA[4];
+        alignas(16) float lanesB[4];
+        _mm_store_ps(lanesA, accumulatorA);
+        _mm_store_ps(lanesB, accumulatorB);
+        sumA = (lanesA[0] + lanesA[2]) + (lanesA[1] + lanesA[3]);
+        sumB = (lanesB[0] + lanesB[2]) + (lanesB[1] + lanesB[3]);
+#else
+        sumA = 0.0f;
+        sumB = 0.0f;
+        for (auto i = 0; i < numTaps; ++i)
+        {
+            sumA += input[i] * phaseA[i];
+            sumB += input[i] * phaseB[i];
+        }
+#endif
+    }
+}
+
+//==============================================================================
+PolyphaseSincInterpolator::Tables::Tables(const Quality quality): numPhases{qualitySettings[quality].numPhases}
+{
+    const auto& settings = qualitySettings[quality];
+
+    size_t numCoefficients = 0;
+    for (auto stretchIndex = 0; stretchIndex < numStretches; ++stretchIndex)
+    {
+        const auto stretch = std::pow(2.0, static_cast<double>(stretchIndex) / stretchStepsPerOctave);
+        numTaps[stretchIndex] = static_cast<int>(std::ceil(settings.numTaps * stretch / 8.0)) * 8;
+        offsets[stretchIndex] = numCoefficients;
+        numCoefficients += static_cast<size_t>(numPhases + 1) * static_cast<size_t>(numTaps[stretchIndex]);
+        maxNumTaps = jmax(maxNumTaps, numTaps[stretchIndex]);
+    }
+    coefficients.resize(numCoefficients);
+
+    for (auto stretchIndex = 0; stretchIndex < numStretches; ++stretchIndex)
+    {
+        const auto stretch = std::pow(2.0, static_cast<double>(stretchIndex) / stretchStepsPerOctave);
+        // in cycles per input sample
+        const auto cutoffFrequency = 0.5 * settings.cutoff / stretch;
+        const auto stretchNumTaps = numTaps[stretchIndex];
+        const auto halfNumTaps = stretchNumTaps / 2;
+
+        for (auto phase = 0; phase <= numPhases; ++phase)
+        {
+            auto* kernel = coefficients.data() + offsets[stretchIndex] + static_cast<size_t>(phase * stretchNumTaps);
+            const auto fraction = static_cast<double>(phase) / numPhases;
+
+            auto sum = 0.0;
+            for (auto tap = 0; tap < stretchNumTaps; ++tap)
+            {
+                // the distance from the output position, which is between tap halfNumTaps - 1 and tap halfNumTaps
+                const auto t = tap - (halfNumTaps - 1) - fraction;
+                const auto x = 2.0 * cutoffFrequency * t;
+                const auto sinc = x == 0.0 ? 1.0 : std::sin(MathConstants<double>::pi * x) / (MathConstants<double>::pi * x);
+                const auto value = sinc * WindowingFunctions::kaiserWindow(t / halfNumTaps, settings.kaiserBeta);
+                kernel[tap] = static_cast<float>(value);
+                sum += value;
+            }
+
+            // unity gain at DC for every phase, so the interpolation between phases doesn't ripple
+            for (auto tap = 0; tap < stretchNumTaps; ++tap)
+                kernel[tap] = static_cast<float>(kernel[tap] / sum);
+        }
+    }
+}
+
+const PolyphaseSincInterpolator::Tables& PolyphaseSincInterpolator::getTables(const Quality quality)
+{
+    switch (quality)
+    {
+    case draftQuality:
+        {
+            static const Tables draftTables(draftQuality);
+            return draftTables;
+        }
+    case highQuality:
+        {
+            static const Tables highTables(highQuality);
+            return highTables;
+        }
+    case normalQuality:
+    default:
+        {
+            static const Tables normalTables(normalQuality);
+            return normalTables;
+        }
+    }
+}
+
+//==============================================================================
+PolyphaseSincInterpolator::PolyphaseSincInterpolator(const Quality quality): tables{getTables(quality)},
+                                                                             history(2 * static_cast<size_t>(tables.maxNumTaps))
+{
+    setSpeedRatio(speedRatio);
+    reset();
+}
+
+void PolyphaseSincInterpolator::reset() noexcept
+{
+    std::fill(history.begin(), history.end(), 0.0f);
+    historyWritePosition = 0;
+    subSamplePosition = 1.0;
+}
+
+void PolyphaseSincInterpolator::copyStateFrom(const PolyphaseSincInterpolator& other) noexcept
+{
+    jassert(&other.tables == &tables);
+    std::copy(other.history.begin(), other.history.end(), history.begin());
+    historyWritePosition = other.historyWritePosition;
+    subSamplePosition = other.subSamplePosition;
+    if (other.speedRatio != speedRatio)
+        setSpeedRatio(other.speedRatio);
+}
+
+void PolyphaseSincInterpolator::pushSample(const float sampleValue) noexcept
+{
+    history[static_cast<size_t>(historyWritePosition)] = sampleValue;
+    history[static_cast<size_t>(historyWritePosition + tables.maxNumTaps)] = sampleValue;
+    if (++historyWritePosition == tables.maxNumTaps)
+        historyWritePosition = 0;
+}
+
+void PolyphaseSincInterpolator::setSpeedRatio(const double newSpeedRatio) noexcept
+{
+    speedRatio = newSpeedRatio;
+
+    // the smallest stretch that's at least the speed ratio
+    stretchIndex = 0;
+    if (speedRatio > 1.0)
+        stretchIndex = jmin(numStretches - 1,
+                            static_cast<int>(std::ceil(std::log2(speedRatio) * stretchStepsPerOctave - 1.0e-9)));
+
+    const auto reciprocal = 1.0 / speedRatio;
+    const auto isInteger = speedRatio == std::floor(speedRatio);
+    // powers of two are exact, so adding them to the position never rounds
+    const auto isReciprocalOfPowerOfTwo = reciprocal == std::floor(reciprocal) && isPowerOfTwo(static_cast<int>(reciprocal))
+        && tables.numPhases % static_cast<int>(reciprocal) == 0;
+
+    if (speedRatio == 1.0)
+        ratioKernel = passThrough;
+    else if (isInteger || isReciprocalOfPowerOfTwo)
+        ratioKernel = fixedPhases;
+    else
+        ratioKernel = interpolatedPhases;
+}
+
+template <typename OutputFunction>
+int PolyphaseSincInterpolator::processWith(const float* inputSamples, float* outputSamples,
+                                           const int numOutputSamplesToProduce, OutputFunction computeOutput) noexcept
+{
+    auto position = subSamplePosition;
+    auto numUsed = 0;
+    for (auto i = 0; i < numOutputSamplesToProduce; ++i)
+    {
+        while (position >= 1.0)
+        {
+            pushSample(inputSamples[numUsed++]);
+            position -= 1.0;
+        }
+
+        outputSamples[i] = computeOutput(position);
+        position += speedRatio;
+    }
+
+    subSamplePosition = position;
+    return numUsed;
+}
+
+int PolyphaseSincInterpolator::process(const double newSpeedRatio, const float* inputSamples, float* outputSamples,
+                                       const int numOutputSamplesToProduce) noexcept
+{
+    if (newSpeedRatio != speedRatio)
+        setSpeedRatio(newSpeedRatio);
+
+    const auto numTaps = tables.numTaps[stretchIndex];
+    const auto numPhases = tables.numPhases;
+    const auto* kernels = tables.coefficients.data() + tables.offsets[stretchIndex];
+    // the smaller kernels end before the newest sample, so that all of them are centred on the same sample
+    const auto numSamplesAfterKernel = (tables.maxNumTaps - numTaps) / 2;
+    // the newest sample is at historyWritePosition - 1 + maxNumTaps
+    const auto getKernelInput = [&]
+    {
+        return history.data() + historyWritePosition + tables.maxNumTaps - numSamplesAfterKernel - numTaps;
+    };
+
+    // the fast paths only work if the position was on a phase when the ratio changed, which is always true after a reset.
+    // Passing the input through also needs it to be on a sample, otherwise the output would jump by the fraction
+    const auto startingPhasePosition = subSamplePosition * numPhases;
+    if (ratioKernel != interpolatedPhases && startingPhasePosition == std::floor(startingPhasePosition))
+    {
+        if (ratioKernel == passThrough && subSamplePosition == std::floor(subSamplePosition))
+        {
+            return processWith(inputSamples, outputSamples, numOutputSamplesToProduce, [&](double)
+            {
+                return history[static_cast<size_t>(historyWritePosition - 1 + tables.maxNumTaps - getDelayInSamples())];
+            });
+        }
+
+        return processWith(inputSamples, outputSamples, numOutputSamplesToProduce, [&](const double position)
+        {
+            const auto phase = static_cast<int>(position * numPhases);
+            return dotProduct(getKernelInput(), kernels + static_cast<size_t>(phase * numTaps), numTaps);
+        });
+    }
+
+    return processWith(inputSamples, outputSamples, numOutputSamplesToProduce, [&](const double position)
+    {
+        const auto phasePosition = position * numPhases;
+        const auto phase = static_cast<int>(phasePosition);
+        const auto fraction = static_cast<float>(phasePosition - phase);
+        const auto* phaseA = kernels + static_cast<size_t>(phase * numTaps);
+
+        float sumA, sumB;
+        dotProductWithTwoPhases(getKernelInput(), phaseA, phaseA + numTaps, numTaps, sumA, sumB);
+        return sumA + fraction * (sumB - sumA);
+    });
+}
@@ -0,0 +1,234 @@
+/*
+  ==============================================================================
+
+	This file is part of Gamelanizer.
+	Copyright (c) 2019 - Luke McDuffie Craig.
+
+	Gamelanizer is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Gamelanizer is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Gamelanizer. If not, see <https://www.gnu.org/licenses/>.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "../JuceLibraryCode/JuceHeader.h"
+
+/** \addtogroup Utility
+ *  @{
+ */
+
+/**
+ * \brief A windowed-sinc resampler with the same interface as CatmullRomInterpolator, used by PvResampler.
+ *
+ * The kernels are Kaiser windowed sincs, precomputed at numPhases fractional offsets and linearly interpolated between
+ * adjacent phases. When the speed ratio is above 1 the cutoff is lowered to the output's Nyquist frequency and the kernel
+ * is stretched by the same amount, so it doesn't alias. There is a table for every stretch in steps of
+ * 1/stretchStepsPerOctave of an octave, up to a ratio of 16, and the next larger one is used.
+ * The tables are shared by every instance with the same Quality.
+ *
+ * Each output sample is the inner product of the kernel with the last input samples, which are kept in a mirrored ring buffer
+ * so that they are always contiguous. It uses AVX2 or SSE2 if the compiler targets them.
+ *
+ * The kernels of every stretch are centred getDelayInSamples() samples before the newest input sample,
+ * so the delay doesn't change when the speed ratio does.
+ *
+ * Some speed ratios only ever use a few of the phases (see RatioKernel), so they skip the interpolation between phases,
+ * or all of the filtering.
+ */
+class PolyphaseSincInterpolator
+{
+public:
+    /**
+     * \brief The kernel length, the number of phases and the stopband attenuation.
+     */
+    enum Quality
+    {
+        /**
+         * \brief 8 taps when the ratio is 1 or less, 16 phases, about 60 dB
+         */
+        draftQuality,
+
+        /**
+         * \brief 16 taps when the ratio is 1 or less, 32 phases, about 80 dB
+         */
+        normalQuality,
+
+        /**
+         * \brief 32 taps when the ratio is 1 or less, 64 phases, about 100 dB
+         */
+        highQuality
+    };
+
+    /**
+     * \brief Creates the interpolator. The first one of each Quality computes the shared tables,
+     * so don't create it on the audio thread.
+     */
+    explicit PolyphaseSincInterpolator(Quality quality);
+
+    PolyphaseSincInterpolator(const PolyphaseSincInterpolator&) = delete;
+
+    PolyphaseSincInterpolator& operator=(const PolyphaseSincInterpolator&) = delete;
+
+    PolyphaseSincInterpolator(PolyphaseSincInterpolator&&) = delete;
+
+    PolyphaseSincInterpolator& operator=(PolyphaseSincInterpolator&&) = delete;
+
+    ~PolyphaseSincInterpolator() = default;
+
+    //==============================================================================
+    /**
+     * \brief Clear the input history and the fractional position, like CatmullRomInterpolator::reset
+     */
+    void reset() noexcept;
+
+    /**
+     * \brief Continue from the input history, fractional position and speed ratio of another interpolator
+     * \param other An interpolator with the same Quality
+     */
+    void copyStateFrom(const PolyphaseSincInterpolator& other) noexcept;
+
+    /**
+     * \brief Choose the kernel table and the RatioKernel for a speed ratio. process does this itself if the ratio it's given
+     * is different, so this just moves that work to when the ratio changes.
+     * \param newSpeedRatio The number of input samples per output sample
+     */
+    void setSpeedRatio(double newSpeedRatio) noexcept;
+
+    /**
+     * \brief Resample a span of input, like CatmullRomInterpolator::process.
+     * \param speedRatio The number of input samples per output sample
+     * \param inputSamples The input. It must have at least as many samples as this will use.
+     * \param outputSamples Where numOutputSamplesToProduce samples are written
+     * \param numOutputSamplesToProduce The number of samples to output
+     * \return The number of input samples that were used
+     */
+    int process(double speedRatio, const float* inputSamples, float* outputSamples,
+                int numOutputSamplesToProduce) noexcept;
+
+    /**
+     * \return The number of input samples that the output lags behind the input
+     */
+    [[nodiscard]] int getDelayInSamples() const noexcept { return tables.maxNumTaps / 2; }
+
+private:
+    /**
+     * \brief 1/8th of an octave doesn't lower the cutoff by much more than the transition band already does
+     */
+    static constexpr int stretchStepsPerOctave{8};
+
+    /**
+     * \brief The largest speed ratio that won't alias
+     */
+    static constexpr int maxStretchOctaves{4};
+
+    static constexpr int numStretches{stretchStepsPerOctave * maxStretchOctaves + 1};
+
+    /**
+     * \brief The kernels of one Quality, for every stretch.
+     */
+    struct Tables
+    {
+        explicit Tables(Quality quality);
+
+        /**
+         * \brief The number of fractional offsets each kernel is computed at. There is an extra phase at the end,
+         * so that the phase after the last one can be interpolated with.
+         */
+        int numPhases;
+
+        /**
+         * \brief The length of each stretch's kernels. Always a multiple of 8, so the inner products don't need a scalar tail.
+         */
+        std::array<int, numStretches> numTaps{};
+
+        /**
+         * \brief Where each stretch's phases start in #coefficients. The phases of a stretch are numTaps apart.
+         */
+        std::array<size_t, numStretches> offsets{};
+
+        /**
+         * \brief The length of the kernel of the largest stretch
+         */
+        int maxNumTaps{};
+
+        std::vector<float> coefficients;
+    };
+
+    /**
+     * \return The tables of a Quality. They're computed the first time this is called.
+     */
+    static const Tables& getTables(Quality quality);
+
+    const Tables& tables;
+
+    /**
+     * \brief How the outputs are computed for the current #speedRatio
+     */
+    enum RatioKernel
+    {
+        /**
+         * \brief Interpolate between the two phases around each output position. Used for every ratio that isn't below,
+         * including the equal tempered intervals, which are irrational and so never repeat their phases.
+         */
+        interpolatedPhases,
+
+        /**
+         * \brief Integer ratios (octaves up) and the reciprocals of powers of two that divide Tables::numPhases (octaves down).
+         * Every output position is exactly on a phase, so only that phase's inner product is needed.
+         */
+        fixedPhases,
+
+        /**
+         * \brief A ratio of 1. The output is the input, delayed by getDelayInSamples(). Only when the position is on a sample,
+         * otherwise the ratio is treated like the others until a reset.
+         */
+        passThrough
+    };
+
+    RatioKernel ratioKernel{interpolatedPhases};
+
+    double speedRatio{1.0};
+
+    /**
+     * \brief The index of the kernel table for #speedRatio
+     */
+    int stretchIndex{};
+
+    /**
+     * \brief The input history. It is 2 * Tables::maxNumTaps long and every sample is written in both halves.
+     */
+    std::vector<float> history;
+
+    int historyWritePosition{};
+
+    /**
+     * \brief The position of the next output sample after the newest input sample, like CatmullRomInterpolator's
+     */
+    double subSamplePosition{1.0};
+
+    void pushSample(float sampleValue) noexcept;
+
+    /**
+     * \brief Consume the input and advance the position like CatmullRomInterpolator::process, and compute every output
+     * sample with computeOutput. Only instantiated in the .cpp.
+     * \param computeOutput Called with the position after the newest input sample, from 0 to 1.
+     * It returns the output sample at that position.
+     */
+    template <typename OutputFunction>
+    int processWith(const float* inputSamples, float* outputSamples, int numOutputSamplesToProduce,
+                    OutputFunction computeOutput) noexcept;
+
+    JUCE_LEAK_DETECTOR(PolyphaseSincInterpolator)
+};
+
+/** @}*/
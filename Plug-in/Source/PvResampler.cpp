@@ -22,18 +22,46 @@
 
 #include "PvResampler.h"
 
-PvResampler::PvResampler(const int analysisHopSize): inputQueue{
-                                                         calculateMaxNeededSamples(analysisHopSize, 16.0, 16.0) + 1
-                                                     },
-                                                     analysisHopBuffer(analysisHopSize)
+PvResampler::PvResampler(const int maxAnalysisHopSize): inputQueue{
+                                                            calculateMaxNeededSamples(maxAnalysisHopSize, 16.0, 16.0) + 1
+                                                        },
+                                                        analysisHopBuffer(maxAnalysisHopSize)
 {
     interpolator.reset();
 }
 
+void PvResampler::allocateInputQueue()
+{
+    if (!hasInputQueue())
+        inputQueue.allocate();
+}
+
 void PvResampler::pushSample(const float sampleValue)
 {
-    inputQueue.data[inputQueue.writePosition] = sampleValue;
-    ++inputQueue.writePosition;
+    inputQueue.push(sampleValue);
+}
+
+void PvResampler::pushSamples(const float* samples, const int numSamples)
+{
+    jassert(numSamples <= getNumSamplesUntilReady());
+    inputQueue.push(samples, numSamples);
+}
+
+void PvResampler::pushZeros(const int numSamples)
+{
+    jassert(numSamples <= getNumSamplesUntilReady());
+    inputQueue.pushZeros(numSamples);
+}
+
+int PvResampler::getNumSamplesUntilReady() const
+{
+    return jmax(1, maxNeedSamples + 1 - inputQueue.numQueued);
+}
+
+int PvResampler::getDelayInSamples() const
+{
+    // CatmullRomInterpolator's delay is less than a sample
+    return resamplingMethod == polyphaseSincResampling ? sincInterpolator.getDelayInSamples() : 0;
 }
 
 int PvResampler::calculateMaxNeededSamples(const int desiredNumOut,
@@ -53,11 +81,20 @@ void PvResampler::updatePitchShiftFactor(const double newPitchShiftFactor)
     maxNeedSamples = calculateMaxNeededSamples(static_cast<int>(analysisHopBuffer.size()),
                                                newPitchShiftFactor,
                                                oldPitchShiftFactor);
+    if (resamplingMethod == polyphaseSincResampling)
+        sincInterpolator.setSpeedRatio(newPitchShiftFactor);
+}
+
+void PvResampler::setAnalysisHopSize(const int newAnalysisHopSize)
+{
+    // the capacity was reserved for the largest hop size, so this will not allocate
+    jassert(static_cast<size_t>(newAnalysisHopSize) <= analysisHopBuffer.capacity());
+    analysisHopBuffer.resize(newAnalysisHopSize);
 }
 
 bool PvResampler::readyToResampleHop() const
 {
-    return inputQueue.writePosition > maxNeedSamples;
+    return inputQueue.numQueued > maxNeedSamples;
 }
 
 bool PvResampler::resampleHopToAnalysisHopBufferIfReady(const double pitchShiftFactor)
@@ -66,24 +103,25 @@ bool PvResampler::resampleHopToAnalysisHopBufferIfReady(const double pitchShiftF
     if (!readyToResampleHop())
         return false;
 
-    const auto numUsed = interpolator.process(pitchShiftFactor,
-                                              inputQueue.data.data(),
-                                              analysisHopBuffer.data(),
-                                              static_cast<int>(analysisHopBuffer.size()));
-
-    jassert(numUsed <= inputQueue.writePosition);
+    const auto numUsed = resamplingMethod == polyphaseSincResampling
+                             ? sincInterpolator.process(pitchShiftFactor,
+                                                        inputQueue.getReadPointer(),
+                                                        analysisHopBuffer.data(),
+                                                        static_cast<int>(analysisHopBuffer.size()))
+                             : interpolator.process(pitchShiftFactor,
+                                                    inputQueue.getReadPointer(),
+                                                    analysisHopBuffer.data(),
+                                                    static_cast<int>(analysisHopBuffer.size()));
+
+    jassert(numUsed <= inputQueue.numQueued);
     inputQueue.popUsedSamples(numUsed);
     return true;
 }
 
-std::vector<float> PvResampler::getAnalysisHopBuffer() const
-{
-    return analysisHopBuffer;
-}
-
 void PvResampler::resetBetweenBeats()
 {
     interpolator.reset();
+    sincInterpolator.reset();
 }
 
 void PvResampler::fullReset()
@@ -93,24 +131,93 @@ void PvResampler::fullReset()
     resetBetweenBeats();
 }
 
+void PvResampler::copyInputQueueFrom(const PvResampler& other)
+{
+    jassert(other.inputQueue.capacity == inputQueue.capacity);
+    jassert(hasInputQueue() && other.hasInputQueue());
+    std::copy(other.inputQueue.data.begin(), other.inputQueue.data.end(), inputQueue.data.begin());
+    inputQueue.readPosition = other.inputQueue.readPosition;
+    inputQueue.numQueued = other.inputQueue.numQueued;
+}
+
+void PvResampler::copyStateFrom(const PvResampler& other)
+{
+    jassert(resamplingMethod == polyphaseSincResampling);
+    jassert(other.analysisHopBuffer.size() == analysisHopBuffer.size());
+    copyInputQueueFrom(other);
+    sincInterpolator.copyStateFrom(other.sincInterpolator);
+    currentPitchShiftFactor = other.currentPitchShiftFactor;
+    maxNeedSamples = other.maxNeedSamples;
+}
+
 //==============================================================================
-PvResampler::Queue::Queue(const int resamplerLength): data(resamplerLength)
+PvResampler::Queue::Queue(const int capacity): capacity{capacity}
 {
 }
 
-void PvResampler::Queue::popUsedSamples(const int numUsed)
+void PvResampler::Queue::allocate()
+{
+    data.assign(static_cast<size_t>(capacity) * 2, 0.0f);
+    isAllocated.store(true);
+}
+
+void PvResampler::Queue::push(const float sampleValue)
+{
+    jassert(numQueued < capacity);
+    auto writePosition = readPosition + numQueued;
+    if (writePosition >= capacity)
+        writePosition -= capacity;
+
+    // write it in both halves
+    data[writePosition] = sampleValue;
+    data[writePosition + capacity] = sampleValue;
+    ++numQueued;
+}
+
+void PvResampler::Queue::push(const float* samples, const int numSamples)
 {
-    const auto nUnconsumed = writePosition - numUsed;
-    jassert(nUnconsumed >= 0);
+    jassert(numQueued + numSamples <= capacity);
+    auto writePosition = readPosition + numQueued;
+    if (writePosition >= capacity)
+        writePosition -= capacity;
+
+    // the part before the end of the first half, then the part that wraps around to the start of it
+    const auto numBeforeWrap = jmin(numSamples, capacity - writePosition);
+    const auto numAfterWrap = numSamples - numBeforeWrap;
+    FloatVectorOperations::copy(data.data() + writePosition, samples, numBeforeWrap);
+    FloatVectorOperations::copy(data.data() + writePosition + capacity, samples, numBeforeWrap);
+    FloatVectorOperations::copy(data.data(), samples + numBeforeWrap, numAfterWrap);
+    FloatVectorOperations::copy(data.data() + capacity, samples + numBeforeWrap, numAfterWrap);
+    numQueued += numSamples;
+}
 
-    // copy the unconsumed samples to the front of the queue
-    for (auto i = 0; i < nUnconsumed; ++i)
-        data[i] = data[numUsed + i];
+void PvResampler::Queue::pushZeros(const int numSamples)
+{
+    jassert(numQueued + numSamples <= capacity);
+    auto writePosition = readPosition + numQueued;
+    if (writePosition >= capacity)
+        writePosition -= capacity;
+
+    const auto numBeforeWrap = jmin(numSamples, capacity - writePosition);
+    const auto numAfterWrap = numSamples - numBeforeWrap;
+    FloatVectorOperations::clear(data.data() + writePosition, numBeforeWrap);
+    FloatVectorOperations::clear(data.data() + writePosition + capacity, numBeforeWrap);
+    FloatVectorOperations::clear(data.data(), numAfterWrap);
+    FloatVectorOperations::clear(data.data() + capacity, numAfterWrap);
+    numQueued += numSamples;
+}
 
-    writePosition -= numUsed;
+void PvResampler::Queue::popUsedSamples(const int numUsed)
+{
+    jassert(numUsed <= numQueued);
+    readPosition += numUsed;
+    if (readPosition >= capacity)
+        readPosition -= capacity;
+    numQueued -= numUsed;
 }
 
 void PvResampler::Queue::reset()
 {
-    writePosition = 0;
+    readPosition = 0;
+    numQueued = 0;
 }
@@ -21,6 +21,7 @@
 */
 #pragma once
 #include "../JuceLibraryCode/JuceHeader.h"
+#include "PolyphaseSincInterpolator.h"
 
 /** \addtogroup Core
  *  @{
@@ -32,7 +33,11 @@
 class PvResampler
 {
 public:
-    explicit PvResampler(int analysisHopSize);
+    /**
+     * \brief The input queue isn't allocated until allocateInputQueue is called.
+     * \param maxAnalysisHopSize The largest number of samples that will be output per hop
+     */
+    explicit PvResampler(int maxAnalysisHopSize);
 
     PvResampler(const PvResampler&) = delete;
 
@@ -46,28 +51,121 @@ public:
 
     //==============================================================================   
 
+    /**
+     * \brief Allocate the input queue if it hasn't been yet. It fits a pitch shift factor of 16, so it's only allocated
+     * for the levels that resample. Don't call this on the audio thread. It can be called while the audio thread
+     * is running, as long as that isn't using this resampler until hasInputQueue() returns true.
+     */
+    void allocateInputQueue();
+
+    /**
+     * \return True once allocateInputQueue() has finished, so the resampler can be used.
+     */
+    [[nodiscard]] bool hasInputQueue() const noexcept { return inputQueue.isAllocated.load(); }
+
+    //==============================================================================   
+
     void resetBetweenBeats();
 
     void fullReset();
 
+    /**
+     * \brief Replace the unconsumed input with the unconsumed input of another resampler with the same hop size.
+     * \param other The resampler to copy from
+     */
+    void copyInputQueueFrom(const PvResampler& other);
+
+    /**
+     * \brief Replace the unconsumed input, the interpolator state and the pitch shift factor with those of another
+     * resampler with the same hop size, so that this one continues exactly where the other one is.
+     * Only possible with polyphaseSincResampling, because CatmullRomInterpolator can't be copied.
+     * \param other The resampler to copy from
+     */
+    void copyStateFrom(const PvResampler& other);
+
     //==============================================================================   
 
     void updatePitchShiftFactor(double newPitchShiftFactor);
 
+    /**
+     * \brief Change the number of samples output per hop. Call updatePitchShiftFactor afterwards.
+     * \param newAnalysisHopSize No larger than the hop size this was constructed with.
+     */
+    void setAnalysisHopSize(int newAnalysisHopSize);
+
     //==============================================================================   
 
     void pushSample(float sampleValue);
 
+    /**
+     * \brief Push a span of samples onto the inputQueue. Don't push more than getNumSamplesUntilReady() at a time.
+     * \param samples The audio data
+     * \param numSamples The length of the span
+     */
+    void pushSamples(const float* samples, int numSamples);
+
+    /**
+     * \brief Push zeros onto the inputQueue. Don't push more than getNumSamplesUntilReady() at a time.
+     * \param numSamples The number of zeros
+     */
+    void pushZeros(int numSamples);
+
+    /**
+     * \return The number of samples to push before the next hop can be resampled.
+     * This is always at least 1, because the per-sample path only checks for a hop after pushing.
+     */
+    [[nodiscard]] int getNumSamplesUntilReady() const;
+
+    /**
+     * \return The number of input samples that the output lags behind the input. The last
+     * samples of a beat only come out after this many zeros have been resampled.
+     */
+    [[nodiscard]] int getDelayInSamples() const;
+
     bool resampleHopToAnalysisHopBufferIfReady(double pitchShiftFactor);
 
-    [[nodiscard]] std::vector<float> getAnalysisHopBuffer() const;
+    /**
+     * \return The hop that resampleHopToAnalysisHopBufferIfReady last produced. It is getAnalysisHopSize() samples long
+     * and stays valid until the next call to resampleHopToAnalysisHopBufferIfReady or setAnalysisHopSize.
+     */
+    [[nodiscard]] const float* getAnalysisHopReadPointer() const noexcept { return analysisHopBuffer.data(); }
+
+    /**
+     * \return The number of samples output per hop
+     */
+    [[nodiscard]] int getAnalysisHopSize() const noexcept { return static_cast<int>(analysisHopBuffer.size()); }
+
+    /**
+     * \brief The interpolators that can do the resampling.
+     */
+    enum ResamplingMethod
+    {
+        /**
+         * \brief juce::CatmullRomInterpolator. It aliases when the pitch is shifted up.
+         */
+        catmullRomResampling,
+
+        /**
+         * \brief PolyphaseSincInterpolator with #sincQuality
+         */
+        polyphaseSincResampling
+    };
+
+    static constexpr ResamplingMethod resamplingMethod = polyphaseSincResampling;
+
+    static constexpr PolyphaseSincInterpolator::Quality sincQuality = PolyphaseSincInterpolator::normalQuality;
 
 private:
     /**
-    * \brief The actual interpolator instance to do pitch shifting before time stretching is done.
+    * \brief The actual interpolator instance to do pitch shifting before time stretching is done. Used with catmullRomResampling.
     */
     CatmullRomInterpolator interpolator;
 
+    /**
+     * \brief The interpolator used with polyphaseSincResampling
+     */
+    PolyphaseSincInterpolator sincInterpolator{sincQuality};
+
     /**
     * \brief The maximum number of samples that the resampler could need in order to always output analysisHopSize samples.
     */
@@ -77,25 +175,55 @@ private:
 
     /**
      * \brief Class for the FIFO queue of time domain data that's given as input to the resampler.
+     * It's a mirrored ring buffer: every sample is written twice, capacity samples apart,
+     * so the queued samples can always be read as one contiguous span and popping them only moves #readPosition.
      */
     class Queue
     {
     public:
-        explicit Queue(int resamplerLength);
+        explicit Queue(int capacity);
+
+        void allocate();
+
+        void push(float sampleValue);
+
+        void push(const float* samples, int numSamples);
+
+        void pushZeros(int numSamples);
+
+        /**
+         * \return The oldest queued sample. The next getNumQueued() samples are contiguous.
+         */
+        [[nodiscard]] const float* getReadPointer() const { return data.data() + readPosition; }
 
         void popUsedSamples(int numUsed);
 
         void reset();
 
         /**
-         * \brief The actual data of the queue
+         * \brief The maximum number of queued samples
+         */
+        const int capacity;
+
+        /**
+         * \brief The actual data of the queue. It is 2 * capacity long once it's allocated, and empty before.
          */
         std::vector<float> data;
 
         /**
-         * \brief The write position of the resamplerQueue
+         * \brief Set after #data is allocated. It's atomic because that happens on another thread than the audio thread.
+         */
+        std::atomic<bool> isAllocated{};
+
+        /**
+         * \brief The position of the oldest queued sample. Always less than capacity.
+         */
+        int readPosition{};
+
+        /**
+         * \brief The number of queued samples that haven't been used by the resampler
          */
-        int writePosition{};
+        int numQueued{};
     };
 
     /**
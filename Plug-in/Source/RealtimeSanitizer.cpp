@@ -0,0 +1,289 @@
+/*
+  ==============================================================================
+
+	This file is part of Gamelanizer.
+	Copyright (c) 2019 - Luke McDuffie Craig.
+
+	Gamelanizer is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Gamelanizer is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Gamelanizer. If not, see <https://www.gnu.org/licenses/>.
+
+  ==============================================================================
+*/
+
+#include "RealtimeSanitizer.h"
+
+#if GamelanizerRealtimeSanitizer
+
+#if defined(__has_feature)
+ #if __has_feature(realtime_sanitizer)
+  #define GamelanizerUseClangRtsan 1
+ #endif
+#endif
+
+#ifndef GamelanizerUseClangRtsan
+ #define GamelanizerUseClangRtsan 0
+#endif
+
+#if GamelanizerUseClangRtsan
+ #include <sanitizer/rtsan_interface.h>
+#elif JUCE_LINUX
+ #include <dlfcn.h>
+ #include <pthread.h>
+ #include <semaphore.h>
+ #include <unistd.h>
+ #include <cerrno>
+ #include <ctime>
+#endif
+
+//==============================================================================
+namespace
+{
+#if defined(__GNUC__)
+    // initial-exec TLS never allocates when it's read, so the malloc interceptor can use it
+    thread_local int realtimeDepth __attribute__((tls_model("initial-exec"))) = 0;
+    thread_local int suspendDepth __attribute__((tls_model("initial-exec"))) = 0;
+#else
+    thread_local int realtimeDepth = 0;
+    thread_local int suspendDepth = 0;
+#endif
+}
+
+RealtimeSanitizer::ScopedRealtimeContext::ScopedRealtimeContext()
+{
+    ++realtimeDepth;
+#if GamelanizerUseClangRtsan
+    __rtsan_realtime_enter();
+#endif
+}
+
+RealtimeSanitizer::ScopedRealtimeContext::~ScopedRealtimeContext()
+{
+#if GamelanizerUseClangRtsan
+    __rtsan_realtime_exit();
+#endif
+    --realtimeDepth;
+}
+
+RealtimeSanitizer::ScopedSuspend::ScopedSuspend()
+{
+    ++suspendDepth;
+#if GamelanizerUseClangRtsan
+    __rtsan_disable();
+#endif
+}
+
+RealtimeSanitizer::ScopedSuspend::~ScopedSuspend()
+{
+#if GamelanizerUseClangRtsan
+    __rtsan_enable();
+#endif
+    --suspendDepth;
+}
+
+bool RealtimeSanitizer::isCheckingThisThread() noexcept
+{
+    return realtimeDepth > 0 && suspendDepth == 0;
+}
+
+void RealtimeSanitizer::reportViolation(const char* functionName) noexcept
+{
+    if (!isCheckingThisThread())
+        return;
+
+    // logging the report allocates and locks too
+    const ScopedSuspend suspend;
+    Logger::outputDebugString(String("Real-time safety violation: ") + functionName + " called in processBlock"
+        + newLine + SystemStats::getStackBacktrace());
+    jassertfalse;
+}
+
+//==============================================================================
+#if !GamelanizerUseClangRtsan && JUCE_LINUX
+
+extern "C"
+{
+    // glibc's own allocator, so that malloc can be intercepted without calling dlsym
+    void* __libc_malloc(size_t size);
+    void* __libc_calloc(size_t numElements, size_t size);
+    void* __libc_realloc(void* pointer, size_t size);
+    void __libc_free(void* pointer);
+}
+
+namespace
+{
+    /**
+     * \brief Look up the definition that this file's interceptor hides.
+     * The cache is constant initialized, so this doesn't need a guard that could lock.
+     */
+    template <typename FunctionType>
+    FunctionType getNextFunction(std::atomic<void*>& cache, const char* name) noexcept
+    {
+        auto* function = cache.load(std::memory_order_relaxed);
+        if (function == nullptr)
+        {
+            function = dlsym(RTLD_NEXT, name);
+            cache.store(function, std::memory_order_relaxed);
+        }
+        return reinterpret_cast<FunctionType>(function);
+    }
+}
+
+extern "C"
+{
+    void* malloc(size_t size) noexcept
+    {
+        RealtimeSanitizer::reportViolation("malloc");
+        return __libc_malloc(size);
+    }
+
+    void* calloc(size_t numElements, size_t size) noexcept
+    {
+        RealtimeSanitizer::reportViolation("calloc");
+        return __libc_calloc(numElements, size);
+    }
+
+    void* realloc(void* pointer, size_t size) noexcept
+    {
+        RealtimeSanitizer::reportViolation("realloc");
+        return __libc_realloc(pointer, size);
+    }
+
+    void free(void* pointer) noexcept
+    {
+        if (pointer != nullptr)
+            RealtimeSanitizer::reportViolation("free");
+        __libc_free(pointer);
+    }
+
+    int posix_memalign(void** pointer, size_t alignment, size_t size) noexcept
+    {
+        RealtimeSanitizer::reportViolation("posix_memalign");
+        static std::atomic<void*> next{};
+        return getNextFunction<int (*)(void**, size_t, size_t)>(next, "posix_memalign")(pointer, alignment, size);
+    }
+
+    void* aligned_alloc(size_t alignment, size_t size) noexcept
+    {
+        RealtimeSanitizer::reportViolation("aligned_alloc");
+        static std::atomic<void*> next{};
+        return getNextFunction<void* (*)(size_t, size_t)>(next, "aligned_alloc")(alignment, size);
+    }
+
+    //==============================================================================
+    int pthread_mutex_lock(pthread_mutex_t* mutex) noexcept
+    {
+        RealtimeSanitizer::reportViolation("pthread_mutex_lock");
+        static std::atomic<void*> next{};
+        return getNextFunction<int (*)(pthread_mutex_t*)>(next, "pthread_mutex_lock")(mutex);
+    }
+
+    int pthread_rwlock_rdlock(pthread_rwlock_t* lock) noexcept
+    {
+        RealtimeSanitizer::reportViolation("pthread_rwlock_rdlock");
+        static std::atomic<void*> next{};
+        return getNextFunction<int (*)(pthread_rwlock_t*)>(next, "pthread_rwlock_rdlock")(lock);
+    }
+
+    int pthread_rwlock_wrlock(pthread_rwlock_t* lock) noexcept
+    {
+        RealtimeSanitizer::reportViolation("pthread_rwlock_wrlock");
+        static std::atomic<void*> next{};
+        return getNextFunction<int (*)(pthread_rwlock_t*)>(next, "pthread_rwlock_wrlock")(lock);
+    }
+
+    int pthread_cond_wait(pthread_cond_t* condition, pthread_mutex_t* mutex)
+    {
+        RealtimeSanitizer::reportViolation("pthread_cond_wait");
+        static std::atomic<void*> next{};
+        return getNextFunction<int (*)(pthread_cond_t*, pthread_mutex_t*)>(next, "pthread_cond_wait")(condition,
+                                                                                                     mutex);
+    }
+
+    int pthread_join(pthread_t thread, void** result)
+    {
+        RealtimeSanitizer::reportViolation("pthread_join");
+        static std::atomic<void*> next{};
+        return getNextFunction<int (*)(pthread_t, void**)>(next, "pthread_join")(thread, result);
+    }
+
+    int sem_wait(sem_t* semaphore)
+    {
+        RealtimeSanitizer::reportViolation("sem_wait");
+        static std::atomic<void*> next{};
+        return getNextFunction<int (*)(sem_t*)>(next, "sem_wait")(semaphore);
+    }
+
+    //==============================================================================
+    int nanosleep(const timespec* duration, timespec* remaining)
+    {
+        RealtimeSanitizer::reportViolation("nanosleep");
+        static std::atomic<void*> next{};
+        return getNextFunction<int (*)(const timespec*, timespec*)>(next, "nanosleep")(duration, remaining);
+    }
+
+    int usleep(useconds_t microseconds)
+    {
+        RealtimeSanitizer::reportViolation("usleep");
+        static std::atomic<void*> next{};
+        return getNextFunction<int (*)(useconds_t)>(next, "usleep")(microseconds);
+    }
+
+    unsigned int sleep(unsigned int seconds)
+    {
+        RealtimeSanitizer::reportViolation("sleep");
+        static std::atomic<void*> next{};
+        return getNextFunction<unsigned int (*)(unsigned int)>(next, "sleep")(seconds);
+    }
+}
+
+//==============================================================================
+#elif !GamelanizerUseClangRtsan
+
+void* operator new(const std::size_t size)
+{
+    RealtimeSanitizer::reportViolation("operator new");
+    if (auto* pointer = std::malloc(size))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void* operator new[](const std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* pointer) noexcept
+{
+    if (pointer != nullptr)
+        RealtimeSanitizer::reportViolation("operator delete");
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+    operator delete(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+    operator delete(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept
+{
+    operator delete(pointer);
+}
+
+#endif
+
+#endif
@@ -0,0 +1,119 @@
+/*
+  ==============================================================================
+
+	This file is part of Gamelanizer.
+	Copyright (c) 2019 - Luke McDuffie Craig.
+
+	Gamelanizer is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Gamelanizer is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Gamelanizer. If not, see <https://www.gnu.org/licenses/>.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "../JuceLibraryCode/JuceHeader.h"
+
+/**
+ * \brief Set GamelanizerRealtimeSanitizer to 1 in the .jucer file to report calls that aren't real-time safe
+ * while GamelanizerAudioProcessor::processBlock runs. This is only meant for debug and test builds.
+ */
+#ifndef GamelanizerRealtimeSanitizer
+ #define GamelanizerRealtimeSanitizer 0
+#endif
+
+/** \addtogroup Utility
+ *  @{
+ */
+
+/**
+ * \brief Reports heap allocations, mutex locks and blocking system calls made on a thread
+ * while it is inside a RealtimeSanitizer::ScopedRealtimeContext. Each report has the call stack of the offending call.
+ *
+ * - If the plug-in is compiled with clang's -fsanitize=realtime, the contexts are passed on to that instead.
+ * - Otherwise on Linux the glibc allocation functions, the pthread lock, wait and join functions, sem_wait
+ *   and the sleep functions are intercepted. Interceptors in a shared object only see every call when it is loaded
+ *   before the C library, so use the Standalone target or preload the plug-in.
+ * - On other platforms only the global operator new and operator delete are intercepted.
+ *
+ * When GamelanizerRealtimeSanitizer is 0 none of this is compiled and the scopes do nothing.
+ */
+class RealtimeSanitizer
+{
+public:
+    /**
+     * \brief Everything this thread calls during the lifetime of this object has to be real-time safe.
+     */
+    class ScopedRealtimeContext
+    {
+    public:
+#if GamelanizerRealtimeSanitizer
+        ScopedRealtimeContext();
+
+        ~ScopedRealtimeContext();
+#else
+        // user-provided, so that an unused scope doesn't warn
+        ScopedRealtimeContext() {}
+
+        ~ScopedRealtimeContext() {}
+#endif
+
+        ScopedRealtimeContext(const ScopedRealtimeContext&) = delete;
+
+        ScopedRealtimeContext& operator=(const ScopedRealtimeContext&) = delete;
+
+        ScopedRealtimeContext(ScopedRealtimeContext&&) = delete;
+
+        ScopedRealtimeContext& operator=(ScopedRealtimeContext&&) = delete;
+    };
+
+    /**
+     * \brief Suspend the checks for calls that are known to be unsafe and are only made in debug or measurement builds,
+     * like PerformanceMeasures.
+     */
+    class ScopedSuspend
+    {
+    public:
+#if GamelanizerRealtimeSanitizer
+        ScopedSuspend();
+
+        ~ScopedSuspend();
+#else
+        ScopedSuspend() {}
+
+        ~ScopedSuspend() {}
+#endif
+
+        ScopedSuspend(const ScopedSuspend&) = delete;
+
+        ScopedSuspend& operator=(const ScopedSuspend&) = delete;
+
+        ScopedSuspend(ScopedSuspend&&) = delete;
+
+        ScopedSuspend& operator=(ScopedSuspend&&) = delete;
+    };
+
+#if GamelanizerRealtimeSanitizer
+    /**
+     * \return True if this thread is in a ScopedRealtimeContext and not in a ScopedSuspend
+     */
+    static bool isCheckingThisThread() noexcept;
+
+    /**
+     * \brief Log the call stack of a call that isn't real-time safe, if this thread is being checked.
+     * \param functionName The name of the intercepted function
+     */
+    static void reportViolation(const char* functionName) noexcept;
+#endif
+};
+
+/** @}*/
@@ -0,0 +1,442 @@
+/*
+  ==============================================================================
+
+	This file is part of Gamelanizer.
+	Copyright (c) 2019 - Luke McDuffie Craig.
+
+	Gamelanizer is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Gamelanizer is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Gamelanizer. If not, see <https://www.gnu.org/licenses/>.
+
+  ==============================================================================
+*/
+
+#include "SimdPhaseMath.h"
+#include <cmath>
+#include <cstdint>
+
+#if defined(__AVX2__)
+ #include <immintrin.h>
+ #define GAMELANIZER_SIMD_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+ #include <emmintrin.h>
+ #define GAMELANIZER_SIMD_SSE2 1
+#endif
+
+namespace
+{
+    //==============================================================================
+    // Constants shared by every lane type
+
+    constexpr auto pi = 3.14159265358979323846f;
+    constexpr auto halfPi = 1.57079632679489661923f;
+    constexpr auto quarterPi = 0.78539816339744830962f;
+    constexpr auto tanPiOverEight = 0.41421356237309504880f;
+    constexpr auto twoOverPi = 0.63661977236758134308f;
+    constexpr auto oneOverTwoPi = 0.15915494309189533577f;
+
+    // pi/2 and 2 pi split into parts so that the range reduction stays accurate (Cody-Waite)
+    constexpr auto halfPiPart1 = 1.5703125f;
+    constexpr auto halfPiPart2 = 4.837512969970703125e-4f;
+    constexpr auto halfPiPart3 = 7.54978995489188216e-8f;
+    constexpr auto twoPiPart1 = 6.28125f;
+    constexpr auto twoPiPart2 = 1.9353071795864769253e-3f;
+
+    // Cephes single precision polynomial coefficients
+    constexpr float atanCoefficients[]{8.05374449538e-2f, -1.38776856032e-1f, 1.99777106478e-1f, -3.33329491539e-1f};
+    constexpr float sinCoefficients[]{-1.9515295891e-4f, 8.3321608736e-3f, -1.6666654611e-1f};
+    constexpr float cosCoefficients[]{2.443315711809948e-5f, -1.388731625493765e-3f, 4.166664568298827e-2f};
+
+    //==============================================================================
+    /**
+     * \brief One float at a time. Used on its own when there is no SIMD, and for the tail of the SIMD loops.
+     */
+    struct ScalarLanes
+    {
+        using Float = float;
+        using Mask = bool;
+        using Int = int32_t;
+        static constexpr int width = 1;
+
+        static Float load(const float* p) { return *p; }
+        static void store(float* p, const Float x) { *p = x; }
+
+        static void loadComplex(const float* p, Float& re, Float& im)
+        {
+            re = p[0];
+            im = p[1];
+        }
+
+        static void storeComplex(float* p, const Float re, const Float im)
+        {
+            p[0] = re;
+            p[1] = im;
+        }
+
+        static Float set(const float x) { return x; }
+        static Float ramp() { return 0.0f; }
+        static Float add(const Float a, const Float b) { return a + b; }
+        static Float sub(const Float a, const Float b) { return a - b; }
+        static Float mul(const Float a, const Float b) { return a * b; }
+        static Float div(const Float a, const Float b) { return a / b; }
+        static Float sqrt(const Float a) { return std::sqrt(a); }
+        static Float abs(const Float a) { return std::abs(a); }
+        static Float min(const Float a, const Float b) { return b < a ? b : a; }
+        static Float max(const Float a, const Float b) { return a < b ? b : a; }
+        static Float neg(const Float a) { return -a; }
+        static Mask greater(const Float a, const Float b) { return a > b; }
+        static Mask less(const Float a, const Float b) { return a < b; }
+        static Float select(const Mask m, const Float ifTrue, const Float ifFalse) { return m ? ifTrue : ifFalse; }
+        static Int roundToInt(const Float a) { return static_cast<Int>(std::lrint(a)); }
+        static Float toFloat(const Int a) { return static_cast<Float>(a); }
+        static Mask isOdd(const Int a) { return (a & 1) != 0; }
+
+        /** \brief Negate a where bit 1 of q is set */
+        static Float negateIfBitOne(const Float a, const Int q) { return (q & 2) != 0 ? -a : a; }
+
+        static Int setInt(const int32_t x) { return x; }
+        static Int addInt(const Int a, const Int b) { return a + b; }
+    };
+
+#if GAMELANIZER_SIMD_AVX2
+    /**
+     * \brief Eight floats at a time with AVX2 (and FMA-free arithmetic so the results match the other paths).
+     */
+    struct Avx2Lanes
+    {
+        using Float = __m256;
+        using Mask = __m256;
+        using Int = __m256i;
+        static constexpr int width = 8;
+
+        static Float load(const float* p) { return _mm256_loadu_ps(p); }
+        static void store(float* p, const Float x) { _mm256_storeu_ps(p, x); }
+
+        static void loadComplex(const float* p, Float& re, Float& im)
+        {
+            const auto a = _mm256_loadu_ps(p);
+            const auto b = _mm256_loadu_ps(p + 8);
+            // per 128 bit lane: [r0 r1 r4 r5 | r2 r3 r6 r7], then put the 64 bit pairs back in order
+            const auto reShuffled = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+            const auto imShuffled = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+            re = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(reShuffled), _MM_SHUFFLE(3, 1, 2, 0)));
+            im = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(imShuffled), _MM_SHUFFLE(3, 1, 2, 0)));
+        }
+
+        static void storeComplex(float* p, const Float re, const Float im)
+        {
+            const auto rePermuted = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(re),
+                                                                           _MM_SHUFFLE(3, 1, 2, 0)));
+            const auto imPermuted = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(im),
+                                                                           _MM_SHUFFLE(3, 1, 2, 0)));
+            _mm256_storeu_ps(p, _mm256_unpacklo_ps(rePermuted, imPermuted));
+            _mm256_storeu_ps(p + 8, _mm256_unpackhi_ps(rePermuted, imPermuted));
+        }
+
+        static Float set(const float x) { return _mm256_set1_ps(x); }
+        static Float ramp() { return _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f); }
+        static Float add(const Float a, const Float b) { return _mm256_add_ps(a, b); }
+        static Float sub(const Float a, const Float b) { return _mm256_sub_ps(a, b); }
+        static Float mul(const Float a, const Float b) { return _mm256_mul_ps(a, b); }
+        static Float div(const Float a, const Float b) { return _mm256_div_ps(a, b); }
+        static Float sqrt(const Float a) { return _mm256_sqrt_ps(a); }
+        static Float abs(const Float a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+        static Float min(const Float a, const Float b) { return _mm256_min_ps(a, b); }
+        static Float max(const Float a, const Float b) { return _mm256_max_ps(a, b); }
+        static Float neg(const Float a) { return _mm256_xor_ps(_mm256_set1_ps(-0.0f), a); }
+        static Mask greater(const Float a, const Float b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+        static Mask less(const Float a, const Float b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+        static Float select(const Mask m, const Float ifTrue, const Float ifFalse)
+        {
+            return _mm256_blendv_ps(ifFalse, ifTrue, m);
+        }
+
+        static Int roundToInt(const Float a) { return _mm256_cvtps_epi32(a); }
+        static Float toFloat(const Int a) { return _mm256_cvtepi32_ps(a); }
+
+        static Mask isOdd(const Int a)
+        {
+            const auto one = _mm256_set1_epi32(1);
+            return _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(a, one), one));
+        }
+
+        static Float negateIfBitOne(const Float a, const Int q)
+        {
+            const auto signBit = _mm256_slli_epi32(_mm256_and_si256(q, _mm256_set1_epi32(2)), 30);
+            return _mm256_xor_ps(a, _mm256_castsi256_ps(signBit));
+        }
+
+        static Int setInt(const int32_t x) { return _mm256_set1_epi32(x); }
+        static Int addInt(const Int a, const Int b) { return _mm256_add_epi32(a, b); }
+    };
+
+    using VectorLanes = Avx2Lanes;
+#elif GAMELANIZER_SIMD_SSE2
+    /**
+     * \brief Four floats at a time with SSE2.
+     */
+    struct Sse2Lanes
+    {
+        using Float = __m128;
+        using Mask = __m128;
+        using Int = __m128i;
+        static constexpr int width = 4;
+
+        static Float load(const float* p) { return _mm_loadu_ps(p); }
+        static void store(float* p, const Float x) { _mm_storeu_ps(p, x); }
+
+        static void loadComplex(const float* p, Float& re, Float& im)
+        {
+            const auto a = _mm_loadu_ps(p);
+            const auto b = _mm_loadu_ps(p + 4);
+            re = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+            im = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        }
+
+        static void storeComplex(float* p, const Float re, const Float im)
+        {
+            _mm_storeu_ps(p, _mm_unpacklo_ps(re, im));
+            _mm_storeu_ps(p + 4, _mm_unpackhi_ps(re, im));
+        }
+
+        static Float set(const float x) { return _mm_set1_ps(x); }
+        static Float ramp() { return _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f); }
+        static Float add(const Float a, const Float b) { return _mm_add_ps(a, b); }
+        static Float sub(const Float a, const Float b) { return _mm_sub_ps(a, b); }
+        static Float mul(const Float a, const Float b) { return _mm_mul_ps(a, b); }
+        static Float div(const Float a, const Float b) { return _mm_div_ps(a, b); }
+        static Float sqrt(const Float a) { return _mm_sqrt_ps(a); }
+        static Float abs(const Float a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+        static Float min(const Float a, const Float b) { return _mm_min_ps(a, b); }
+        static Float max(const Float a, const Float b) { return _mm_max_ps(a, b); }
+        static Float neg(const Float a) { return _mm_xor_ps(_mm_set1_ps(-0.0f), a); }
+        static Mask greater(const Float a, const Float b) { return _mm_cmpgt_ps(a, b); }
+        static Mask less(const Float a, const Float b) { return _mm_cmplt_ps(a, b); }
+
+        static Float select(const Mask m, const Float ifTrue, const Float ifFalse)
+        {
+            return _mm_or_ps(_mm_and_ps(m, ifTrue), _mm_andnot_ps(m, ifFalse));
+        }
+
+        static Int roundToInt(const Float a) { return _mm_cvtps_epi32(a); }
+        static Float toFloat(const Int a) { return _mm_cvtepi32_ps(a); }
+
+        static Mask isOdd(const Int a)
+        {
+            const auto one = _mm_set1_epi32(1);
+            return _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(a, one), one));
+        }
+
+        static Float negateIfBitOne(const Float a, const Int q)
+        {
+            const auto signBit = _mm_slli_epi32(_mm_and_si128(q, _mm_set1_epi32(2)), 30);
+            return _mm_xor_ps(a, _mm_castsi128_ps(signBit));
+        }
+
+        static Int setInt(const int32_t x) { return _mm_set1_epi32(x); }
+        static Int addInt(const Int a, const Int b) { return _mm_add_epi32(a, b); }
+    };
+
+    using VectorLanes = Sse2Lanes;
+#else
+    using VectorLanes = ScalarLanes;
+#endif
+
+    //==============================================================================
+    /**
+     * \brief Wrap to [-pi, pi] by subtracting the nearest multiple of 2 pi.
+     */
+    template <typename L>
+    typename L::Float wrap(const typename L::Float x)
+    {
+        const auto multiple = L::toFloat(L::roundToInt(L::mul(x, L::set(oneOverTwoPi))));
+        const auto reduced = L::sub(x, L::mul(multiple, L::set(twoPiPart1)));
+        return L::sub(reduced, L::mul(multiple, L::set(twoPiPart2)));
+    }
+
+    /**
+     * \brief atan2 with the Cephes atanf polynomial on [0, 1] and octant reconstruction.
+     */
+    template <typename L>
+    typename L::Float atan2(const typename L::Float y, const typename L::Float x)
+    {
+        const auto absX = L::abs(x);
+        const auto absY = L::abs(y);
+        const auto largest = L::max(absX, absY);
+        const auto smallest = L::min(absX, absY);
+        const auto zero = L::set(0.0f);
+        // the ratio is in [0, 1]. The lanes where both are 0 divide 0 by 0, so they select 0 instead.
+        // Clamping the divisor would be wrong for the tiniest and denormal bins
+        const auto ratio = L::select(L::greater(largest, zero), L::div(smallest, largest), zero);
+
+        // reduce [tan(pi/8), 1] to [-tan(pi/8), 0]
+        const auto isLarge = L::greater(ratio, L::set(tanPiOverEight));
+        const auto t = L::select(isLarge,
+                                 L::div(L::sub(ratio, L::set(1.0f)), L::add(ratio, L::set(1.0f))),
+                                 ratio);
+        const auto offset = L::select(isLarge, L::set(quarterPi), zero);
+
+        const auto z = L::mul(t, t);
+        auto polynomial = L::set(atanCoefficients[0]);
+        polynomial = L::add(L::mul(polynomial, z), L::set(atanCoefficients[1]));
+        polynomial = L::add(L::mul(polynomial, z), L::set(atanCoefficients[2]));
+        polynomial = L::add(L::mul(polynomial, z), L::set(atanCoefficients[3]));
+        auto angle = L::add(offset, L::add(L::mul(L::mul(polynomial, z), t), t));
+
+        // back to the full circle
+        angle = L::select(L::greater(absY, absX), L::sub(L::set(halfPi), angle), angle);
+        angle = L::select(L::less(x, zero), L::sub(L::set(pi), angle), angle);
+        return L::select(L::less(y, zero), L::neg(angle), angle);
+    }
+
+    /**
+     * \brief sine and cosine with the Cephes sinf/cosf polynomials on [-pi/4, pi/4] and quadrant reconstruction.
+     */
+    template <typename L>
+    void sinCos(const typename L::Float x, typename L::Float& sine, typename L::Float& cosine)
+    {
+        const auto quadrant = L::roundToInt(L::mul(x, L::set(twoOverPi)));
+        const auto quadrantFloat = L::toFloat(quadrant);
+        auto r = L::sub(x, L::mul(quadrantFloat, L::set(halfPiPart1)));
+        r = L::sub(r, L::mul(quadrantFloat, L::set(halfPiPart2)));
+        r = L::sub(r, L::mul(quadrantFloat, L::set(halfPiPart3)));
+        const auto z = L::mul(r, r);
+
+        auto sinPolynomial = L::set(sinCoefficients[0]);
+        sinPolynomial = L::add(L::mul(sinPolynomial, z), L::set(sinCoefficients[1]));
+        sinPolynomial = L::add(L::mul(sinPolynomial, z), L::set(sinCoefficients[2]));
+        const auto s = L::add(r, L::mul(L::mul(sinPolynomial, z), r));
+
+        auto cosPolynomial = L::set(cosCoefficients[0]);
+        cosPolynomial = L::add(L::mul(cosPolynomial, z), L::set(cosCoefficients[1]));
+        cosPolynomial = L::add(L::mul(cosPolynomial, z), L::set(cosCoefficients[2]));
+        const auto c = L::add(L::sub(L::set(1.0f), L::mul(z, L::set(0.5f))),
+                              L::mul(L::mul(cosPolynomial, z), z));
+
+        // odd quadrants swap sine and cosine
+        const auto swap = L::isOdd(quadrant);
+        sine = L::negateIfBitOne(L::select(swap, c, s), quadrant);
+        cosine = L::negateIfBitOne(L::select(swap, s, c), L::addInt(quadrant, L::setInt(1)));
+    }
+
+    //==============================================================================
+
+    template <typename L>
+    int cartesianToPolarLanes(const float* complexBins, float* magnitudes, float* phases, const int start,
+                              const int numBins)
+    {
+        auto k = start;
+        for (; k + L::width <= numBins; k += L::width)
+        {
+            typename L::Float re, im;
+            L::loadComplex(complexBins + 2 * k, re, im);
+            L::store(magnitudes + k, L::sqrt(L::add(L::mul(re, re), L::mul(im, im))));
+            L::store(phases + k, atan2<L>(im, re));
+        }
+        return k;
+    }
+
+    template <typename L>
+    int polarToCartesianLanes(const float* magnitudes, const float* phases, float* complexBins, const int start,
+                              const int numBins)
+    {
+        auto k = start;
+        for (; k + L::width <= numBins; k += L::width)
+        {
+            const auto mag = L::load(magnitudes + k);
+            typename L::Float sine, cosine;
+            sinCos<L>(L::load(phases + k), sine, cosine);
+            L::storeComplex(complexBins + 2 * k, L::mul(mag, cosine), L::mul(mag, sine));
+        }
+        return k;
+    }
+
+    template <typename L>
+    int estimateTrueBinIndicesLanes(const float* phases, float* previousPhases, float* trueBinIndices,
+                                    const int start, const int numBins, const float analysisOverlapFactor)
+    {
+        const auto phaseAdvancePerBin = L::set(2.0f * pi / analysisOverlapFactor);
+        const auto deviationToBins = L::set(analysisOverlapFactor * oneOverTwoPi);
+        auto binIndex = L::add(L::ramp(), L::set(static_cast<float>(start)));
+        const auto binIndexIncrement = L::set(static_cast<float>(L::width));
+
+        auto k = start;
+        for (; k + L::width <= numBins; k += L::width)
+        {
+            const auto currentPhase = L::load(phases + k);
+            const auto phaseDifference = L::sub(currentPhase, L::load(previousPhases + k));
+            const auto deviation = wrap<L>(L::sub(phaseDifference, L::mul(binIndex, phaseAdvancePerBin)));
+            L::store(trueBinIndices + k, L::add(binIndex, L::mul(deviation, deviationToBins)));
+            L::store(previousPhases + k, currentPhase);
+            binIndex = L::add(binIndex, binIndexIncrement);
+        }
+        return k;
+    }
+
+    template <typename L>
+    int accumulatePhasesLanes(float* scaledPhases, const float* trueBinIndices, const int start, const int numBins,
+                              const float synthesisOverlapFactor)
+    {
+        const auto phaseAdvancePerBin = L::set(2.0f * pi / synthesisOverlapFactor);
+        auto k = start;
+        for (; k + L::width <= numBins; k += L::width)
+        {
+            const auto advanced = L::add(L::load(scaledPhases + k),
+                                         L::mul(L::load(trueBinIndices + k), phaseAdvancePerBin));
+            L::store(scaledPhases + k, wrap<L>(advanced));
+        }
+        return k;
+    }
+}
+
+//==============================================================================
+
+void SimdPhaseMath::cartesianToPolar(const float* complexBins, float* magnitudes, float* phases, const int numBins)
+{
+    const auto k = cartesianToPolarLanes<VectorLanes>(complexBins, magnitudes, phases, 0, numBins);
+    cartesianToPolarLanes<ScalarLanes>(complexBins, magnitudes, phases, k, numBins);
+}
+
+void SimdPhaseMath::polarToCartesian(const float* magnitudes, const float* phases, float* complexBins,
+                                     const int numBins)
+{
+    const auto k = polarToCartesianLanes<VectorLanes>(magnitudes, phases, complexBins, 0, numBins);
+    polarToCartesianLanes<ScalarLanes>(magnitudes, phases, complexBins, k, numBins);
+}
+
+void SimdPhaseMath::estimateTrueBinIndices(const float* phases, float* previousPhases, float* trueBinIndices,
+                                           const int numBins, const float analysisOverlapFactor)
+{
+    const auto k = estimateTrueBinIndicesLanes<VectorLanes>(phases, previousPhases, trueBinIndices, 0, numBins,
+                                                            analysisOverlapFactor);
+    estimateTrueBinIndicesLanes<ScalarLanes>(phases, previousPhases, trueBinIndices, k, numBins,
+                                             analysisOverlapFactor);
+}
+
+void SimdPhaseMath::accumulatePhases(float* scaledPhases, const float* trueBinIndices, const int numBins,
+                                     const float synthesisOverlapFactor)
+{
+    const auto k = accumulatePhasesLanes<VectorLanes>(scaledPhases, trueBinIndices, 0, numBins,
+                                                      synthesisOverlapFactor);
+    accumulatePhasesLanes<ScalarLanes>(scaledPhases, trueBinIndices, k, numBins, synthesisOverlapFactor);
+}
+
+const char* SimdPhaseMath::getInstructionSetName()
+{
+#if GAMELANIZER_SIMD_AVX2
+    return "AVX2";
+#elif GAMELANIZER_SIMD_SSE2
+    return "SSE2";
+#else
+    return "Scalar";
+#endif
+}
@@ -0,0 +1,91 @@
+/*
+  ==============================================================================
+
+	This file is part of Gamelanizer.
+	Copyright (c) 2019 - Luke McDuffie Craig.
+
+	Gamelanizer is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Gamelanizer is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Gamelanizer. If not, see <https://www.gnu.org/licenses/>.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+/** \addtogroup Utility
+ *  @{
+ */
+
+/**
+ * \brief Vectorized kernels for the per-bin math of the phase vocoder.
+ *
+ * The complex bins are converted to structure-of-arrays magnitudes and phases so that whole SIMD registers
+ * can be processed at once. AVX2 is used if the compiler targets it, otherwise SSE2, otherwise a scalar fallback.
+ * All three paths share the same approximations, so they produce the same results up to rounding.
+ *
+ * The approximations are all within 3e-7 of the exact values: the arctangent for any input, the sine and cosine
+ * for the wrapped phases the phase vocoder uses, and the wrap as an angle, for phases up to 2 pi times the number of
+ * bins of a 1024 point FFT. Near pi, the rounding of the float result alone is 1.2e-7. A wrapped phase can be outside
+ * [-pi, pi] by less than 1e-7 times the phase before wrapping. SimdPhaseMathTest checks this against the standard library.
+ */
+struct SimdPhaseMath
+{
+    /**
+     * \brief Convert interleaved complex bins (real, imaginary, real, ...) to magnitudes and phases.
+     * \param complexBins The interleaved complex data. It must hold 2 * numBins floats.
+     * \param magnitudes Output array of numBins magnitudes.
+     * \param phases Output array of numBins phases in [-pi, pi].
+     * \param numBins The number of complex bins.
+     */
+    static void cartesianToPolar(const float* complexBins, float* magnitudes, float* phases, int numBins);
+
+    /**
+     * \brief Convert magnitudes and phases back to interleaved complex bins.
+     * \param magnitudes Array of numBins magnitudes.
+     * \param phases Array of numBins phases. They should already be wrapped to [-pi, pi].
+     * \param complexBins The interleaved complex output. It must hold 2 * numBins floats.
+     * \param numBins The number of complex bins.
+     */
+    static void polarToCartesian(const float* magnitudes, const float* phases, float* complexBins, int numBins);
+
+    /**
+     * \brief Estimate the true (fractional) bin index of every bin from the phase difference between two frames,
+     * then replace the previous phases with the current ones.
+     * \f[k_{true}=k+\frac{o_a}{2\pi}\mathrm{wrap}\left(\phi_k-\phi'_k-\frac{2\pi k}{o_a}\right)\f]
+     * \param phases The phases of the current frame.
+     * \param previousPhases The phases of the previous frame. Overwritten with the current phases.
+     * \param trueBinIndices Output array of numBins fractional bin indices.
+     * \param numBins The number of complex bins.
+     * \param analysisOverlapFactor \f$o_a\f$
+     */
+    static void estimateTrueBinIndices(const float* phases, float* previousPhases, float* trueBinIndices,
+                                       int numBins, float analysisOverlapFactor);
+
+    /**
+     * \brief Advance and wrap the synthesis phases.
+     * \f[\phi_s \leftarrow \mathrm{wrap}\left(\phi_s+k_{true}\frac{2\pi}{o_s}\right)\f]
+     * \param scaledPhases The synthesis phases of the previous frame. Overwritten with the new ones.
+     * \param trueBinIndices The fractional bin indices from estimateTrueBinIndices.
+     * \param numBins The number of complex bins.
+     * \param synthesisOverlapFactor \f$o_s\f$
+     */
+    static void accumulatePhases(float* scaledPhases, const float* trueBinIndices, int numBins,
+                                 float synthesisOverlapFactor);
+
+    /**
+     * \return The name of the instruction set the kernels were compiled for.
+     */
+    static const char* getInstructionSetName();
+};
+
+/** @}*/
@@ -23,19 +23,21 @@
 #include "SubdivisionLevel.h"
 
 SubdivisionLevel::SubdivisionLevel(const int levelNumber, BeatSampleInfo& bsi, GamelanizerParametersVtsHelper& gpvh,
-                                   SubdivisionLevelsOutputBuffer& lob, double& hostSampleRate):
+                                   SubdivisionLevelsOutputBuffer& lob, SubdivisionLevelsFilterBank& lfb,
+                                   double& hostSampleRate):
     levelNumber(levelNumber),
     powerOfTwo{
         static_cast<int>(std::pow(2, levelNumber + 1))
     },
     numberOfNotesToJumpOver{calculateNumberOfNotesToJumpOver(levelNumber)},
-    pv(levelNumber, 1.0f / static_cast<float>(powerOfTwo)),
+    pv{createPhaseVocoder(levelNumber, 1.0f / static_cast<float>(powerOfTwo))},
+    allCopiesMask{(1u << powerOfTwo) - 1u},
     beatSampleInfo(bsi),
     gamelanizerParametersVtsHelper(gpvh),
     levelsOutputBuffer(lob),
+    levelsFilterBank(lfb),
     hostSampleRate{hostSampleRate}
 {
-    hpFilter.parameters->type = dsp::StateVariableFilter::Parameters<float>::Type::highPass;
 }
 
 int SubdivisionLevel::calculateNumberOfNotesToJumpOver(const int levelNumber)
@@ -46,42 +48,95 @@ int SubdivisionLevel::calculateNumberOfNotesToJumpOver(const int levelNumber)
     return numberNotesInThisLvlEqualToTwoInTheOriginal - 2;
 }
 
+std::unique_ptr<PhaseVocoderBase> SubdivisionLevel::createPhaseVocoder(const int levelNumber,
+                                                                      const float effectiveTimeScaleFactor)
+{
+    switch (fftOrders[levelNumber])
+    {
+    case 8:
+        return std::make_unique<PhaseVocoder<8>>(levelNumber, effectiveTimeScaleFactor);
+    case 9:
+        return std::make_unique<PhaseVocoder<9>>(levelNumber, effectiveTimeScaleFactor);
+    case 10:
+        return std::make_unique<PhaseVocoder<10>>(levelNumber, effectiveTimeScaleFactor);
+    default:
+        // add a case and an explicit instantiation for any new order in fftOrders
+        jassertfalse;
+        return nullptr;
+    }
+}
+
 void SubdivisionLevel::moveWriteHeadOneHop(const int hop)
 {
     accumulatedSamples += hop;
     writePosition += hop;
-
-    wrapLevelWritePosition();
 }
 
 void SubdivisionLevel::processSample(const float sampleValue)
 {
-    const auto hop = pv.processSample(sampleValue);
+    // the analysis source will synthesize our frames when it has analyzed its own
+    if (analysisSource != nullptr)
+        return;
+
+    const auto hop = pv->processSample(sampleValue);
     // hop is greater than 0 when the phase vocoder has new data for us to OLA
     if (hop > 0)
-    {
-        addSamplesToLevelsOutputBuffer(pv.getFftInOutReadPointer(), PhaseVocoder::getFftSize());
-        pv.loadNextParams();
-
-        moveWriteHeadOneHop(hop);
-    }
+        processAnalyzedFrame(hop);
 }
 
-void SubdivisionLevel::processFinalHop()
+void SubdivisionLevel::processBlock(const float* samples, int numSamples)
 {
-    auto hop = 0;
-    // hop returns greater than 0 when the phase vocoder has new data for us to OLA
-    while (hop == 0)
+    // the analysis source will synthesize our frames when it has analyzed its own
+    if (analysisSource != nullptr)
+        return;
+
+    while (numSamples > 0)
     {
-        hop = pv.processSample(0);
+        auto numSamplesUsed = 0;
+        const auto hop = pv->processBlock(samples, numSamples, numSamplesUsed);
+        samples += numSamplesUsed;
+        numSamples -= numSamplesUsed;
+        // hop is greater than 0 when the phase vocoder has new data for us to OLA
+        if (hop > 0)
+            processAnalyzedFrame(hop);
     }
+}
 
-    addSamplesToLevelsOutputBuffer(pv.getFftInOutReadPointer(), PhaseVocoder::getFftSize());
-    pv.loadNextParams();
+void SubdivisionLevel::processAnalyzedFrame(const int hop)
+{
+    // a silent frame has nothing to add
+    if (!pv->isSynthesisFrameSilent())
+        addSamplesToLevelsOutputBuffer(pv->getFftInOutReadPointer(), pv->getFftSize());
+    if (analysisConsumer != nullptr)
+        analysisConsumer->processSharedAnalysisFrame();
+    pv->loadNextParams();
 
     moveWriteHeadOneHop(hop);
 }
 
+void SubdivisionLevel::processSharedAnalysisFrame()
+{
+    jassert(analysisSource != nullptr);
+    const auto hop = pv->synthesizeFromSharedAnalysis(*analysisSource->pv);
+    // a silent frame has nothing to add
+    if (!pv->isSynthesisFrameSilent())
+        addSamplesToLevelsOutputBuffer(pv->getFftInOutReadPointer(), pv->getFftSize());
+    if (analysisConsumer != nullptr)
+        analysisConsumer->processSharedAnalysisFrame();
+
+    moveWriteHeadOneHop(hop);
+}
+
+void SubdivisionLevel::processFinalHop()
+{
+    // the analysis source's final hops include ours
+    if (analysisSource != nullptr)
+        return;
+
+    for (auto numHops = pv->getNumHopsToFlush(); numHops > 0; --numHops)
+        processAnalyzedFrame(pv->flushWithZeros());
+}
+
 bool SubdivisionLevel::shouldDropThisNote(const int copyNumber) const
 {
     // drop the 1st note
@@ -104,64 +159,48 @@ bool SubdivisionLevel::shouldDropThisNote(const int copyNumber) const
     return onFourthNote && (gamelanizerParametersVtsHelper.getDropNote(levelNumber, 3) != 0);
 }
 
-void SubdivisionLevel::addSamplesToLevelsOutputBuffer(const float* samples, const int nSamples) const
+uint32 SubdivisionLevel::calculateDroppedCopies() const
 {
-    const auto noteLength = static_cast<double>(beatSampleInfo.getBeatSampleLength()) / powerOfTwo;
-    const auto twoNoteLengths = noteLength * 2;
+    uint32 newDroppedCopies = 0;
+    for (auto i = 0; i < powerOfTwo; ++i)
+        if (shouldDropThisNote(i))
+            newDroppedCopies |= 1u << i;
+    return newDroppedCopies;
+}
 
-    const auto numCopies = powerOfTwo;
+void SubdivisionLevel::setDroppedCopies(const uint32 newDroppedCopies)
+{
+    droppedCopies = newDroppedCopies;
+    // the phase vocoder is reset between beats, so it can stop and start synthesizing now
+    pv->setSynthesisEnabled(!areAllCopiesDropped());
+}
 
-    const auto levelBufLength = levelsOutputBuffer.data.getNumSamples();
-    for (auto i = 0; i < numCopies; ++i)
-    {
-        if (shouldDropThisNote(i))
-            continue;
-
-        // multiple write heads for each copy of the scaled beat, depending on the subdivision lvl
-        //todo subsample
-        const auto writeHeadUnwrapped = writePosition + static_cast<int>(twoNoteLengths * i);
-        jassert(writeHeadUnwrapped >= 0);
-        jassert(levelBufLength > 0);
-        const auto writeHead = writeHeadUnwrapped % levelBufLength;
-        jassert(writeHead >= 0);
-        jassert(writeHead < levelBufLength);
-
-        // if the samples array doesn't need to wrap around the output buffer
-        if (writeHead + nSamples < levelBufLength)
-        {
-            levelsOutputBuffer.data.addFrom(levelNumber, writeHead, samples, nSamples);
-        }
-            // the samples array does need to wrap around the output buffer
-        else
-        {
-            // number of samples on the left part of the samples array
-            const auto nSamplesLeft = levelBufLength - writeHead;
-            jassert(nSamplesLeft > 0);
-            jassert(nSamplesLeft < nSamples);
-            // make sure we aren't writing past the read head
-            if (writeHead < levelsOutputBuffer.readPosition)
-            {
-                jassert(writeHead + nSamplesLeft < levelsOutputBuffer.readPosition);
-            }
-            levelsOutputBuffer.data.addFrom(levelNumber, writeHead, samples, nSamplesLeft);
-            // number of samples on the right part of the samples array
-            const auto nSamplesRight = nSamples - nSamplesLeft;
-            jassert(nSamplesRight > 0);
-            jassert(nSamplesRight < nSamples);
-            // make sure we aren't writing past the read head
-            jassert(nSamplesLeft + nSamplesRight < levelsOutputBuffer.readPosition);
-            levelsOutputBuffer.data.addFrom(levelNumber, 0, samples + nSamplesLeft, nSamplesRight);
-        }
-    }
+void SubdivisionLevel::startNote(const int beatSampleLength)
+{
+    const auto noteLength = static_cast<double>(beatSampleLength) / powerOfTwo;
+    const auto twoNoteLengths = noteLength * 2;
+    // multiple write heads for each copy of the scaled beat, depending on the subdivision lvl
+    //todo subsample
+    noteStart = writePosition;
+    levelsOutputBuffer.startNote(levelNumber, writePosition, twoNoteLengths, powerOfTwo, droppedCopies);
 }
 
-void SubdivisionLevel::wrapLevelWritePosition()
+int SubdivisionLevel::calculateMaxNoteLength(const int maxSamplesPerBeat) const
 {
-    const auto levelBufLength = levelsOutputBuffer.data.getNumSamples();
-    if (writePosition >= levelBufLength)
-    {
-        writePosition -= levelBufLength;
-    }
+    // the last hop can go past the end of the note, and the tail of its frame after that
+    return static_cast<int>(std::ceil(static_cast<double>(maxSamplesPerBeat) / powerOfTwo)) + 2 * pv->getFftSize();
+}
+
+void SubdivisionLevel::addSamplesToLevelsOutputBuffer(const float* samples, const int nSamples) const
+{
+    // the frames lag behind by the resampler's delay, scaled down to the note. Moving them back puts the onsets where they
+    // were in the beat, and what that moves before the start of the note is the silence the resampler started the beat with
+    const auto position = writePosition - roundToInt(pv->getInputDelayInSamples() / static_cast<double>(powerOfTwo));
+    const auto numBeforeNote = static_cast<int>(jlimit(static_cast<int64>(0), static_cast<int64>(nSamples),
+                                                       noteStart - position));
+    // the copies are made when the levels are read
+    levelsOutputBuffer.addToNote(levelNumber, position + numBeforeNote, samples + numBeforeNote,
+                                 nSamples - numBeforeNote);
 }
 
 void SubdivisionLevel::moveWritePosOnBeatB()
@@ -169,7 +208,6 @@ void SubdivisionLevel::moveWritePosOnBeatB()
     // TODO subsample        
     const auto samplesToJump = static_cast<int>(std::round(noteLengthInSamplesFractional * numberOfNotesToJumpOver));
     writePosition += samplesToJump;
-    wrapLevelWritePosition();
 }
 
 void SubdivisionLevel::fastForwardWriteHeadsToNextBeat()
@@ -177,46 +215,62 @@ void SubdivisionLevel::fastForwardWriteHeadsToNextBeat()
     //TODO subsample
     const auto missing = noteLengthInSamples - accumulatedSamples;
     writePosition += missing;
-    wrapLevelWritePosition();
     accumulatedSamples = 0;
 }
 
 void SubdivisionLevel::fullReset()
 {
-    pv.fullReset();
+    pv->fullReset();
     accumulatedSamples = 0;
+    setDroppedCopies(calculateDroppedCopies());
+    startNote(beatSampleInfo.getBeatSampleLength());
+    analysisSource = nullptr;
+    analysisConsumer = nullptr;
+    active = true;
+}
+
+void SubdivisionLevel::setActive(const bool shouldBeActive)
+{
+    if (shouldBeActive == active)
+        return;
+
+    active = shouldBeActive;
+    // the pitch might have changed while the level wasn't getting its input
+    if (active)
+        preparePhaseVocoder();
 }
 
 //==============================================================================
 
-void SubdivisionLevel::prepareFilters(const int samplesPerBlock)
+bool SubdivisionLevel::canShareAnalysisOf(const SubdivisionLevel& producer) const
 {
-    lpFilter.prepare({
-        hostSampleRate, static_cast<uint32>(samplesPerBlock), static_cast<uint32>(1)
-    });
-
-    hpFilter.prepare({
-        hostSampleRate, static_cast<uint32>(samplesPerBlock), static_cast<uint32>(1)
-    });
+    return pv->canShareAnalysisWith(*producer.pv);
 }
 
-void SubdivisionLevel::resetFilters()
+void SubdivisionLevel::setAnalysisSource(SubdivisionLevel* newAnalysisSource)
 {
-    lpFilter.reset();
-    hpFilter.reset();
+    // when we stop sharing, continue from the input the source had left over, since that was our input too
+    if (analysisSource != nullptr && newAnalysisSource == nullptr)
+        pv->copyAnalysisInputFrom(*analysisSource->pv);
+
+    analysisSource = newAnalysisSource;
 }
 
-void SubdivisionLevel::snapFiltersToZero()
+void SubdivisionLevel::takeOverAnalysis()
 {
-    lpFilter.snapToZero();
-    hpFilter.snapToZero();
+    jassert(analysisSource != nullptr);
+    pv->copyAnalysisStateFrom(*analysisSource->pv);
+    analysisSource = nullptr;
 }
 
+//==============================================================================
+
 void SubdivisionLevel::preparePhaseVocoder()
 {
     const auto pitchParam = gamelanizerParametersVtsHelper.getPitch(levelNumber, false);
     const auto pitchShiftFactor = std::pow(2.0, pitchParam.value / 1200.0);
-    pv.initParams(static_cast<float>(pitchShiftFactor));
+    queuePhaseVocoderPitchShiftingMethod(gamelanizerParametersVtsHelper.isPitchShiftedSpectrally(levelNumber));
+    pv->initParams(static_cast<float>(pitchShiftFactor));
 }
 
 void SubdivisionLevel::queuePhaseVocoderNextParams()
@@ -224,10 +278,17 @@ void SubdivisionLevel::queuePhaseVocoderNextParams()
     const auto newPitch = gamelanizerParametersVtsHelper.getPitch(levelNumber, true);
     if (newPitch.wasChanged)
     {
-        pv.queueParams(newPitch.value);
+        pv->queueParams(newPitch.value);
     }
 }
 
+void SubdivisionLevel::queuePhaseVocoderPitchShiftingMethod(const bool shiftSpectrally)
+{
+    pv->setPitchShiftingMethod(shiftSpectrally
+                                   ? PhaseVocoderBase::spectralPitchShift
+                                   : PhaseVocoderBase::resamplingPitchShift);
+}
+
 // ReSharper disable once CppMemberFunctionMayBeConst
 void SubdivisionLevel::updateFilters()
 {
@@ -235,9 +296,9 @@ void SubdivisionLevel::updateFilters()
 
     const auto lpFilterCutoff = gamelanizerParametersVtsHelper.getLpFilterCutoff(levelNumber);
     if (lpFilterCutoff.wasChanged)
-        lpFilter.parameters->setCutOffFrequency(hostSampleRate, jmin(nyquist, lpFilterCutoff.value));
+        levelsFilterBank.setLowPassCutoff(levelNumber, hostSampleRate, jmin(nyquist, lpFilterCutoff.value));
 
     const auto hpFilterCutoff = gamelanizerParametersVtsHelper.getHpFilterCutoff(levelNumber);
     if (hpFilterCutoff.wasChanged)
-        hpFilter.parameters->setCutOffFrequency(hostSampleRate, jmin(nyquist, hpFilterCutoff.value));
+        levelsFilterBank.setHighPassCutoff(levelNumber, hostSampleRate, jmin(nyquist, hpFilterCutoff.value));
 }
@@ -23,8 +23,10 @@
 #pragma once
 #include "PhaseVocoder.h"
 #include "BeatSampleInfo.h"
+#include "GamelanizerConstants.h"
 #include "GamelanizerParametersVTSHelper.h"
 #include "SubdivisionLevelsOutputBuffer.h"
+#include "SubdivisionLevelsFilterBank.h"
 
 /** \addtogroup Core
  *  @{
@@ -42,12 +44,14 @@ public:
      * \param bsi a reference to GamelanizerAudioProcessor::beatSampleInfo
      * \param gpvh a reference to GamelanizerAudioProcessor::gamelanizerParametersVtsHelper
      * \param lob a reference to GamelanizerAudioProcessor::levelsOutputBuffer
+     * \param lfb a reference to GamelanizerAudioProcessor::levelsFilterBank
      * \param hostSampleRate a reference to GamelanizerAudioProcessor::hostSampleRate
      */
     SubdivisionLevel(int levelNumber,
                      BeatSampleInfo& bsi,
                      GamelanizerParametersVtsHelper& gpvh,
                      SubdivisionLevelsOutputBuffer& lob,
+                     SubdivisionLevelsFilterBank& lfb,
                      double& hostSampleRate);
 
     SubdivisionLevel(const SubdivisionLevel&) = delete;
@@ -69,7 +73,16 @@ public:
     void processSample(float sampleValue);
 
     /**
-     * \brief Push 0s to all of the PVs until they process whatever extra data they have. 
+     * \brief Pass a span of samples to the #pv and add every synthesis frame that is completed in it to this level's output buffer.
+     * The output is identical to calling processSample on each sample.
+     * \param samples The sample data
+     * \param numSamples The length of the span
+     */
+    void processBlock(const float* samples, int numSamples);
+
+    /**
+     * \brief Push 0s to all of the PVs until they process whatever extra data they have, including the input that is
+     * still in the resampler's delay.
      */
     void processFinalHop();
 
@@ -80,6 +93,32 @@ public:
      */
     [[nodiscard]] bool shouldDropThisNote(int copyNumber) const;
 
+    /**
+     * \brief Take a snapshot of which copies shouldDropThisNote for the beat that is starting.
+     * Call this whenever BeatSampleInfo starts a new beat.
+     * \return Bit n is set if copy n is dropped
+     */
+    [[nodiscard]] uint32 calculateDroppedCopies() const;
+
+    /**
+     * \brief Use the copies that calculateDroppedCopies returned for the beat that is starting,
+     * and turn off the synthesis of the #pv if all of them are dropped.
+     * \param newDroppedCopies Bit n is set if copy n is dropped
+     */
+    void setDroppedCopies(uint32 newDroppedCopies);
+
+    /**
+     * \brief Start this beat's note in the #levelsOutputBuffer, at #writePosition, with the copies that aren't dropped.
+     * Call this after setDroppedCopies.
+     * \param beatSampleLength The BeatSampleInfo::getBeatSampleLength of the beat that is starting
+     */
+    void startNote(int beatSampleLength);
+
+    /**
+     * \return True if every copy of the current beat is dropped, so nothing this level synthesizes is heard.
+     */
+    [[nodiscard]] bool areAllCopiesDropped() const { return droppedCopies == allCopiesMask; }
+
     /**
      * \brief Only call this method at the END of beat b 
      * \f[{w}[i] \leftarrow {w}[i] + {s}[i](2^{i+1}-2)\f]
@@ -93,36 +132,86 @@ public:
     void fastForwardWriteHeadsToNextBeat();
 
     /**
-     * \brief Reset the phase vocoder and state
+     * \brief Reset the phase vocoder and state, and start the first note. Call this after #writePosition is initialized.
      */
     void fullReset();
 
+    /**
+     * \param maxSamplesPerBeat The number of samples in a beat at the lowest tempo
+     * \return The most samples a note of this level could need in the #levelsOutputBuffer
+     */
+    [[nodiscard]] int calculateMaxNoteLength(int maxSamplesPerBeat) const;
+
+    /**
+     * \brief Only call this at a beat boundary, after the write heads have been moved to the next beat.
+     * An inactive level gets no input and renders nothing, it only has its write heads moved and starts empty notes.
+     * Its output is still read and filtered, so the notes it had already rendered are heard until they end.
+     * The #pv keeps its state, and reactivating only gives it the current pitch, so the level starts the new beat
+     * like any other. Nothing was rendered for the beats it was inactive for, so those are silent.
+     * \param shouldBeActive Whether the level should process the next beat
+     */
+    void setActive(bool shouldBeActive);
+
+    /**
+     * \return False if this level is skipping its processing because it can't be heard. See setActive.
+     */
+    [[nodiscard]] bool isActive() const { return active; }
+
     //==============================================================================
+    /**
+     * \brief Whether the phase vocoder of this level could use the analysis of producer's instead of doing its own,
+     * for the next beat. The levels also need GamelanizerParametersVtsHelper::levelsHaveIdenticalPhaseVocoderInput.
+     * \param producer A lower subdivision level
+     */
+    [[nodiscard]] bool canShareAnalysisOf(const SubdivisionLevel& producer) const;
 
     /**
-     * \brief Update the high and low-pass filter coefficients.
-     * This method is called every sample but will only take effect every GamelanizerParametersVtsHelper::filterUpdateRateInSamples
-     * and will not calculate anything if the cutoff frequency has not changed.
+     * \brief Only call this at a beat boundary, after the phase vocoders have been reset.
+     * While a level has an analysis source it skips its own resampling and analysis and only synthesizes,
+     * whenever the source analyzes a frame.
+     * \param newAnalysisSource The level doing the analysis, or nullptr for this level to do its own.
      */
-    void updateFilters();
+    void setAnalysisSource(SubdivisionLevel* newAnalysisSource);
 
     /**
-     * \brief Prepare the filters when GamelanizerAudioProcessor::prepareToPlay is called
-     * \param samplesPerBlock the maximum samples per block the host will give
+     * \brief Stop using the analysis of the #analysisSource in the middle of a beat, because our input is no longer
+     * identical to its. Its analysis state was also ours up to now, so it's copied and our own analysis continues from it.
+     * The chain of #analysisConsumer has to be rebuilt afterwards.
      */
-    void prepareFilters(int samplesPerBlock);
+    void takeOverAnalysis();
 
     /**
-     * \brief Reset the high-pass and low-pass filters.
+     * \brief Set the next level in the chain of levels sharing this level's analysis (or its source's analysis).
+     * \param newAnalysisConsumer The next level, or nullptr
      */
-    void resetFilters();
+    void setAnalysisConsumer(SubdivisionLevel* newAnalysisConsumer) { analysisConsumer = newAnalysisConsumer; }
 
     /**
-     * \brief Prevent instability from limit cycles because the filter objects are processing a sample at a time and so do not handle this themselves.
-     * \see http://www.wlxt.uestc.edu.cn/wlxt/ncourse/dsp/web/kj/chapter%209/9.4%20Limit%20Cycles%20in%20IIR%20Digital%20Filters.htm
-     * \see https://forum.juce.com/t/dsp-snaptozero-need-help-to-understand/33033/2
+     * \return Whether this level is currently using the analysis of another level.
      */
-    void snapFiltersToZero();
+    [[nodiscard]] bool isSharingAnalysis() const { return analysisSource != nullptr; }
+
+    /**
+     * \return The level whose analysis this level is using, or nullptr
+     */
+    [[nodiscard]] SubdivisionLevel* getAnalysisSource() const { return analysisSource; }
+
+    /**
+     * \return Whether this level is currently using the analysis of producer.
+     */
+    [[nodiscard]] bool isSharingAnalysisOf(const SubdivisionLevel& producer) const
+    {
+        return analysisSource == &producer;
+    }
+
+    //==============================================================================
+
+    /**
+     * \brief Update the high and low-pass filter coefficients of this level's lane of the #levelsFilterBank.
+     * This method is called every sample but will only take effect every GamelanizerParametersVtsHelper::filterUpdateRateInSamples
+     * and will not calculate anything if the cutoff frequency has not changed.
+     */
+    void updateFilters();
 
     //==============================================================================
     /**
@@ -135,6 +224,12 @@ public:
      */
     void queuePhaseVocoderNextParams();
 
+    /**
+     * \brief queue the pitch shifting method parameter for the PV to change to at the next beat
+     * \param shiftSpectrally GamelanizerParametersVtsHelper::isPitchShiftedSpectrally
+     */
+    void queuePhaseVocoderPitchShiftingMethod(bool shiftSpectrally);
+
 private:
     /**
      * \brief \f[i\f] 0 indexed in code. 1 indexed in the paper and formulas.
@@ -153,18 +248,26 @@ private:
 
     //==============================================================================
 public:
+    /**
+     * \brief The FFT order of the phase vocoder of each subdivision level.
+     * The notes get shorter with each level, so the higher levels can use smaller frames.
+     * Every order in here needs an explicit instantiation of PhaseVocoder at the bottom of PhaseVocoder.cpp.
+     */
+    static constexpr std::array<int, GamelanizerConstants::maxLevels> fftOrders{10, 9, 8, 8};
+
     /**
      * \brief The Phase Vocoder instance of this subdivision level. Used for pitch shifting and time scaling.
+     * Its FFT size comes from #fftOrders.
      */
-    PhaseVocoder pv;
+    std::unique_ptr<PhaseVocoderBase> pv;
 
     //==============================================================================
 
     /**
-     * \brief The lead write head for this level.
+     * \brief The lead write head for this level, in samples since playback started.
      * \f[w[i]\f]
      */
-    int writePosition{};
+    int64 writePosition{};
 
     /**
      * \brief The number of samples per subdivided note of this level.
@@ -177,25 +280,43 @@ public:
      */
     double noteLengthInSamplesFractional{};
 
-    //==============================================================================
+private:
 
     /**
-     * \brief Low pass filters for this subdivision level.
+     * \brief The number of samples written of this subdivision level before changing to the next beat.
+     * \f[\Delta w[i]\f]
      */
-    dsp::StateVariableFilter::Filter<float> lpFilter;
+    int accumulatedSamples{};
 
     /**
-     * \brief High pass filters for this subdivision level.
+     * \brief Where the note of the current beat starts, in samples since playback started
      */
-    dsp::StateVariableFilter::Filter<float> hpFilter;
+    int64 noteStart{};
 
-private:
+    /**
+     * \brief See setActive
+     */
+    bool active{true};
 
     /**
-     * \brief The number of samples written of this subdivision level before changing to the next beat.
-     * \f[\Delta w[i]\f]
+     * \brief Bit n is set if copy n is dropped in the current beat. See setDroppedCopies.
      */
-    int accumulatedSamples{};
+    uint32 droppedCopies{};
+
+    /**
+     * \brief The bits of #droppedCopies that are used by this level
+     */
+    const uint32 allCopiesMask;
+
+    /**
+     * \brief The level whose phase vocoder analysis this level uses instead of its own. nullptr if it does its own.
+     */
+    SubdivisionLevel* analysisSource{};
+
+    /**
+     * \brief The next level that uses the same analysis as this level. nullptr if there isn't one.
+     */
+    SubdivisionLevel* analysisConsumer{};
 
     //==============================================================================    
     /**
@@ -213,6 +334,11 @@ private:
      */
     SubdivisionLevelsOutputBuffer& levelsOutputBuffer;
 
+    /**
+     * \brief Reference to GamelanizerAudioProcessor::levelsFilterBank
+     */
+    SubdivisionLevelsFilterBank& levelsFilterBank;
+
     /**
      * \brief Reference to GamelanizerAudioProcessor::hostSampleRate
      */
@@ -221,13 +347,25 @@ private:
     //==============================================================================   
 
     /**
-     * \brief Overlap-and-add and duplicate the phase vocoded notes in the correct positions.
-     * (Algorithm 1 in the paper)
+     * \brief Overlap-and-add the phase vocoded notes in the correct positions. They are duplicated
+     * (Algorithm 1 in the paper) when the #levelsOutputBuffer is read.
      * \param samples The audio data.
      * \param nSamples The number of samples in the first parameter.
      */
     void addSamplesToLevelsOutputBuffer(const float* samples, int nSamples) const;
 
+    /**
+     * \brief Synthesize and overlap-add a frame from the frame #analysisSource just analyzed,
+     * then pass it on to #analysisConsumer.
+     */
+    void processSharedAnalysisFrame();
+
+    /**
+     * \brief Overlap-add the frame #pv just synthesized, pass it on to #analysisConsumer, and move on to the next hop.
+     * \param hop The synthesis hop size returned by the #pv
+     */
+    void processAnalyzedFrame(int hop);
+
     /**
      * \brief \f[w[i] \leftarrow w[i]+h_s[i]\f]
      * \f[\Delta w[i] \leftarrow \Delta w[i]+h_s[i]\f]
@@ -235,11 +373,6 @@ private:
      */
     void moveWriteHeadOneHop(int hop);
 
-    /**
-     * \brief Adjust the lead write head position for the circular buffer
-     */
-    void wrapLevelWritePosition();
-
     /**
      * \brief Helper function for construction of #numberOfNotesToJumpOver .
      * \param levelNumber The level number (0 indexed)
@@ -247,6 +380,14 @@ private:
      */
     static int calculateNumberOfNotesToJumpOver(int levelNumber);
 
+    /**
+     * \brief Helper function for construction of #pv .
+     * \param levelNumber The level number (0 indexed)
+     * \param effectiveTimeScaleFactor PhaseVocoder::effectiveTimeScaleFactor
+     * \return A PhaseVocoder with the FFT order from #fftOrders
+     */
+    static std::unique_ptr<PhaseVocoderBase> createPhaseVocoder(int levelNumber, float effectiveTimeScaleFactor);
+
     //==============================================================================    
     JUCE_LEAK_DETECTOR(SubdivisionLevel)
 };
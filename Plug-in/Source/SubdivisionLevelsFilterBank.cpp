@@ -0,0 +1,127 @@
+/*
+  ==============================================================================
+
+	This file is part of Gamelanizer.
+	Copyright (c) 2019 - Luke McDuffie Craig.
+
+	Gamelanizer is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Gamelanizer is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Gamelanizer. If not, see <https://www.gnu.org/licenses/>.
+
+  ==============================================================================
+*/
+
+#include "SubdivisionLevelsFilterBank.h"
+
+SubdivisionLevelsFilterBank::SubdivisionLevelsFilterBank()
+{
+    // start with the coefficients of a default constructed filter, like the scalar filters did
+    const dsp::StateVariableFilter::Parameters<float> defaultParameters;
+    for (auto* lanes : {&lowPass, &highPass})
+    {
+        lanes->g = Register::expand(defaultParameters.g);
+        lanes->r2 = Register::expand(defaultParameters.R2);
+        lanes->h = Register::expand(defaultParameters.h);
+    }
+    reset();
+}
+
+//==============================================================================
+void SubdivisionLevelsFilterBank::prepare(const int maxNumSamples)
+{
+    maxNumFrames = maxNumSamples;
+    // the extra frame is room to align the start
+    framesMemory.allocate(sizeof(float) * static_cast<size_t>((maxNumSamples + 1) * numLanes), true);
+    frames = Register::getNextSIMDAlignedPtr(reinterpret_cast<float*>(framesMemory.get()));
+    reset();
+}
+
+void SubdivisionLevelsFilterBank::reset()
+{
+    for (auto* lanes : {&lowPass, &highPass})
+    {
+        lanes->s1 = Register::expand(0.0f);
+        lanes->s2 = Register::expand(0.0f);
+    }
+}
+
+void SubdivisionLevelsFilterBank::snapToZero()
+{
+    for (auto* lanes : {&lowPass, &highPass})
+    {
+        snapToZero(lanes->s1);
+        snapToZero(lanes->s2);
+    }
+}
+
+void SubdivisionLevelsFilterBank::snapToZero(Register& state)
+{
+    // the same threshold as dsp::util::snapToZero. NaNs fail both comparisons, so they're zeroed too
+    const auto threshold = Register::expand(1.0e-8f);
+    const auto isLarge = Register::greaterThan(state, threshold)
+        | Register::lessThan(state, Register::expand(0.0f) - threshold);
+    state = state & isLarge;
+}
+
+void SubdivisionLevelsFilterBank::setLowPassCutoff(const int level, const double sampleRate, const float cutoff)
+{
+    setCutoff(lowPass, level, sampleRate, cutoff);
+}
+
+void SubdivisionLevelsFilterBank::setHighPassCutoff(const int level, const double sampleRate, const float cutoff)
+{
+    setCutoff(highPass, level, sampleRate, cutoff);
+}
+
+void SubdivisionLevelsFilterBank::setCutoff(Lanes& lanes, const int level, const double sampleRate,
+                                            const float cutoff)
+{
+    // let the scalar parameters do the math, so the coefficients are exactly the same
+    dsp::StateVariableFilter::Parameters<float> parameters;
+    parameters.setCutOffFrequency(sampleRate, cutoff);
+    lanes.g.set(static_cast<size_t>(level), parameters.g);
+    lanes.r2.set(static_cast<size_t>(level), parameters.R2);
+    lanes.h.set(static_cast<size_t>(level), parameters.h);
+}
+
+//==============================================================================
+void SubdivisionLevelsFilterBank::interleave(
+    const std::array<float*, GamelanizerConstants::maxLevels>& levelSamples, const int numSamples)
+{
+    for (auto level = 0; level < numLanes; ++level)
+    {
+        const auto* samples = level < GamelanizerConstants::maxLevels ? levelSamples[level] : nullptr;
+        if (samples == nullptr)
+        {
+            for (auto i = 0; i < numSamples; ++i)
+                frames[i * numLanes + level] = 0.0f;
+            continue;
+        }
+
+        for (auto i = 0; i < numSamples; ++i)
+            frames[i * numLanes + level] = samples[i];
+    }
+}
+
+void SubdivisionLevelsFilterBank::deinterleave(
+    const std::array<float*, GamelanizerConstants::maxLevels>& levelSamples, const int numSamples) const
+{
+    for (auto level = 0; level < GamelanizerConstants::maxLevels; ++level)
+    {
+        auto* samples = levelSamples[level];
+        if (samples == nullptr)
+            continue;
+
+        for (auto i = 0; i < numSamples; ++i)
+            samples[i] = frames[i * numLanes + level];
+    }
+}
@@ -0,0 +1,169 @@
+/*
+  ==============================================================================
+
+	This file is part of Gamelanizer.
+	Copyright (c) 2019 - Luke McDuffie Craig.
+
+	Gamelanizer is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Gamelanizer is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Gamelanizer. If not, see <https://www.gnu.org/licenses/>.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "GamelanizerConstants.h"
+
+/** \addtogroup Core
+ *  @{
+ */
+
+/**
+ * \brief The low-pass and high-pass filters of every subdivision level, processed together.
+ *
+ * Each level is a lane of a dsp::SIMDRegister, with its own coefficients and state, so one sample of all the levels
+ * is low-passed and then high-passed with a single pass of the state variable filter equations.
+ * The equations are the same as dsp::StateVariableFilter::Filter's, in the same order, so each lane gives the same
+ * result as the scalar filter would.
+ */
+class SubdivisionLevelsFilterBank
+{
+public:
+    using Register = dsp::SIMDRegister<float>;
+
+    static_assert(Register::SIMDNumElements >= GamelanizerConstants::maxLevels,
+                  "every level needs a lane of its own");
+
+    /**
+     * \brief The number of floats in a frame, which is one sample of every lane
+     */
+    static constexpr int numLanes{static_cast<int>(Register::SIMDNumElements)};
+
+    SubdivisionLevelsFilterBank();
+
+    SubdivisionLevelsFilterBank(const SubdivisionLevelsFilterBank&) = delete;
+
+    SubdivisionLevelsFilterBank& operator=(const SubdivisionLevelsFilterBank&) = delete;
+
+    SubdivisionLevelsFilterBank(SubdivisionLevelsFilterBank&&) = delete;
+
+    SubdivisionLevelsFilterBank& operator=(SubdivisionLevelsFilterBank&&) = delete;
+
+    ~SubdivisionLevelsFilterBank() = default;
+
+    //==============================================================================
+    /**
+     * \brief Allocate the interleaved frames and reset the filters. Called from GamelanizerAudioProcessor::prepareToPlay
+     * \param maxNumSamples The most samples that process() will be called with
+     */
+    void prepare(int maxNumSamples);
+
+    /**
+     * \brief Reset the state of every filter.
+     */
+    void reset();
+
+    /**
+     * \brief Prevent instability from limit cycles, like dsp::StateVariableFilter::Filter::snapToZero.
+     * Denormal and tiny states are set to 0 in every lane.
+     */
+    void snapToZero();
+
+    /**
+     * \brief Set the cutoff of one level's low-pass filter. It takes effect from the next sample processed.
+     */
+    void setLowPassCutoff(int level, double sampleRate, float cutoff);
+
+    /**
+     * \brief Set the cutoff of one level's high-pass filter. It takes effect from the next sample processed.
+     */
+    void setHighPassCutoff(int level, double sampleRate, float cutoff);
+
+    //==============================================================================
+    /**
+     * \brief Low-pass and then high-pass a segment of every level in place.
+     * \param levelSamples The segment of each level. Levels that are nullptr are skipped, and their lanes run on silence.
+     * \param numSamples The length of the segment
+     * \param updateCoefficients Called before each sample, so that the cutoffs can be changed with sample accuracy
+     */
+    template <typename CoefficientUpdater>
+    void process(const std::array<float*, GamelanizerConstants::maxLevels>& levelSamples, const int numSamples,
+                 CoefficientUpdater&& updateCoefficients)
+    {
+        jassert(numSamples <= maxNumFrames);
+        interleave(levelSamples, numSamples);
+
+        for (auto i = 0; i < numSamples; ++i)
+        {
+            updateCoefficients();
+            processFrame(frames + i * numLanes);
+        }
+
+        deinterleave(levelSamples, numSamples);
+    }
+
+private:
+    /**
+     * \brief The coefficients and state of one filter in every lane
+     */
+    struct Lanes
+    {
+        Register g, r2, h;
+        Register s1, s2;
+    };
+
+    Lanes lowPass;
+    Lanes highPass;
+
+    //==============================================================================
+    HeapBlock<char> framesMemory;
+    /**
+     * \brief SIMD aligned, numLanes floats per sample
+     */
+    float* frames{};
+    int maxNumFrames{};
+
+    void interleave(const std::array<float*, GamelanizerConstants::maxLevels>& levelSamples, int numSamples);
+
+    void deinterleave(const std::array<float*, GamelanizerConstants::maxLevels>& levelSamples, int numSamples) const;
+
+    static void setCutoff(Lanes& lanes, int level, double sampleRate, float cutoff);
+
+    static void snapToZero(Register& state);
+
+    void processFrame(float* frame)
+    {
+        const auto input = Register::fromRawArray(frame);
+
+        // dsp::StateVariableFilter::Filter::processLoop
+        const auto lpHighPassed = (input - lowPass.s1 * lowPass.r2 - lowPass.s1 * lowPass.g - lowPass.s2) * lowPass.h;
+        const auto lpBandPassed = lpHighPassed * lowPass.g + lowPass.s1;
+        lowPass.s1 = lpHighPassed * lowPass.g + lpBandPassed;
+        const auto lowPassed = lpBandPassed * lowPass.g + lowPass.s2;
+        lowPass.s2 = lpBandPassed * lowPass.g + lowPassed;
+
+        const auto highPassed = (lowPassed - highPass.s1 * highPass.r2 - highPass.s1 * highPass.g - highPass.s2)
+            * highPass.h;
+        const auto hpBandPassed = highPassed * highPass.g + highPass.s1;
+        highPass.s1 = highPassed * highPass.g + hpBandPassed;
+        const auto hpLowPassed = hpBandPassed * highPass.g + highPass.s2;
+        highPass.s2 = hpBandPassed * highPass.g + hpLowPassed;
+
+        highPassed.copyToRawArray(frame);
+    }
+
+    //==============================================================================
+    JUCE_LEAK_DETECTOR(SubdivisionLevelsFilterBank)
+};
+
+/** @}*/
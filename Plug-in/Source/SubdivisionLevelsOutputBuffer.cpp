@@ -0,0 +1,195 @@
+/*
+  ==============================================================================
+
+	This file is part of Gamelanizer.
+	Copyright (c) 2019 - Luke McDuffie Craig.
+
+	Gamelanizer is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Gamelanizer is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Gamelanizer. If not, see <https://www.gnu.org/licenses/>.
+
+  ==============================================================================
+*/
+
+#include "SubdivisionLevelsOutputBuffer.h"
+
+void SubdivisionLevelsOutputBuffer::prepare(const std::array<float*, GamelanizerConstants::maxLevels>& notesSamples,
+                                            const std::array<int, GamelanizerConstants::maxLevels>& maxNoteLengths)
+{
+    for (auto level = 0; level < GamelanizerConstants::maxLevels; ++level)
+    {
+        auto& levelNotes = levels[level];
+        levelNotes.samples = notesSamples[level];
+        levelNotes.noteCapacity = maxNoteLengths[level];
+        // the new memory is already zeroed
+        levelNotes.notes.fill({});
+    }
+    clear();
+}
+
+void SubdivisionLevelsOutputBuffer::clear()
+{
+    for (auto level = 0; level < GamelanizerConstants::maxLevels; ++level)
+        clearLevel(level);
+}
+
+void SubdivisionLevelsOutputBuffer::clearLevel(const int level)
+{
+    auto& levelNotes = levels[level];
+    for (auto slot = 0; slot < maxNotesPerLevel; ++slot)
+    {
+        FloatVectorOperations::clear(levelNotes.getNoteSamples(slot), levelNotes.notes[slot].length);
+        levelNotes.notes[slot] = {};
+        levelNotes.finishedNotes[slot] = {};
+    }
+    levelNotes.currentNote = -1;
+    levelNotes.numFinishedNotes.store(0);
+    levelNotes.unfinishedNoteStart.store(std::numeric_limits<int64>::max());
+    levelNotes.numNotesTaken = 0;
+    levelNotes.numPlayingCopies = 0;
+    levelNotes.nextCopyStart = std::numeric_limits<int64>::max();
+}
+
+void SubdivisionLevelsOutputBuffer::startNote(const int level, const int64 start, const double copySpacing,
+                                              const int numCopies, const uint32 droppedCopies)
+{
+    auto& levelNotes = levels[level];
+    jassert(levelNotes.noteCapacity > 0);
+    jassert(numCopies <= 32);
+
+    // the reader can take the note that was being written now
+    if (levelNotes.currentNote >= 0)
+        levelNotes.numFinishedNotes.store(levelNotes.numFinishedNotes.load() + 1);
+
+    // reuse the oldest slot
+    const auto slot = (levelNotes.currentNote + 1) % maxNotesPerLevel;
+    auto& note = levelNotes.notes[slot];
+    // every copy of the note that was in it should have ended already.
+    // They might not have been read, if the level was inactive or the processing was simulated.
+    jassert(note.numCopies == 0 || note.getCopyStart(note.numCopies - 1) + note.length <= readPosition);
+    FloatVectorOperations::clear(levelNotes.getNoteSamples(slot), note.length);
+
+    note.start = start;
+    note.copySpacing = copySpacing;
+    note.numCopies = numCopies;
+    note.droppedCopies = droppedCopies;
+    note.length = 0;
+    note.nextCopy = 0;
+    levelNotes.currentNote = slot;
+    // after the finished note, so that a reader who sees this also sees that
+    levelNotes.unfinishedNoteStart.store(start);
+}
+
+void SubdivisionLevelsOutputBuffer::addToNote(const int level, const int64 position, const float* samples,
+                                              const int numSamples)
+{
+    auto& levelNotes = levels[level];
+    jassert(levelNotes.currentNote >= 0);
+    auto& note = levelNotes.notes[levelNotes.currentNote];
+    const auto offset = static_cast<int>(position - note.start);
+    if (offset < 0 || offset + numSamples > levelNotes.noteCapacity)
+    {
+        // the note is longer than prepare was told it could be
+        jassertfalse;
+        return;
+    }
+    FloatVectorOperations::add(levelNotes.getNoteSamples(levelNotes.currentNote) + offset, samples, numSamples);
+    note.length = jmax(note.length, offset + numSamples);
+}
+
+void SubdivisionLevelsOutputBuffer::readSamples(const int level, float* destination, const int numSamples)
+{
+    auto& levelNotes = levels[level];
+    const int64 start = readPosition;
+    const auto end = start + numSamples;
+    // the notes that are heard have to be finished, or the rest of them would be cut off
+    jassert(isFinishedUpTo(level, end));
+    takeFinishedNotes(levelNotes);
+
+    auto position = start;
+    while (position < end)
+    {
+        if (position >= levelNotes.nextCopyStart)
+            startPlayingCopies(levelNotes, position);
+
+        // the copies that are playing stay the same until one of them ends or another starts
+        auto spanEnd = jmin(end, levelNotes.nextCopyStart);
+        for (auto i = 0; i < levelNotes.numPlayingCopies;)
+        {
+            auto& copy = levelNotes.playingCopies[i];
+            if (position >= copy.end)
+            {
+                // move the last one into its place
+                copy = levelNotes.playingCopies[--levelNotes.numPlayingCopies];
+                continue;
+            }
+            spanEnd = jmin(spanEnd, copy.end);
+            ++i;
+        }
+
+        const auto numSpanSamples = static_cast<int>(spanEnd - position);
+        auto* spanDestination = destination + (position - start);
+        FloatVectorOperations::clear(spanDestination, numSpanSamples);
+        for (auto i = 0; i < levelNotes.numPlayingCopies; ++i)
+        {
+            const auto& copy = levelNotes.playingCopies[i];
+            FloatVectorOperations::add(spanDestination, copy.samples + (position - copy.start), numSpanSamples);
+        }
+        position = spanEnd;
+    }
+}
+
+void SubdivisionLevelsOutputBuffer::takeFinishedNotes(LevelNotes& levelNotes)
+{
+    const auto numFinishedNotes = levelNotes.numFinishedNotes.load();
+    for (auto number = jmax(levelNotes.numNotesTaken, numFinishedNotes - maxNotesTaken);
+         number < numFinishedNotes; ++number)
+    {
+        const auto slot = number % maxNotesPerLevel;
+        auto& note = levelNotes.finishedNotes[slot];
+        note = levelNotes.notes[slot];
+        note.nextCopy = 0;
+        levelNotes.nextCopyStart = jmin(levelNotes.nextCopyStart, note.start);
+    }
+    levelNotes.numNotesTaken = numFinishedNotes;
+}
+
+void SubdivisionLevelsOutputBuffer::startPlayingCopies(LevelNotes& levelNotes, const int64 position)
+{
+    levelNotes.nextCopyStart = std::numeric_limits<int64>::max();
+    for (auto slot = 0; slot < maxNotesPerLevel; ++slot)
+    {
+        auto& note = levelNotes.finishedNotes[slot];
+        while (note.nextCopy < note.numCopies)
+        {
+            const auto copyStart = note.getCopyStart(note.nextCopy);
+            if (copyStart > position)
+            {
+                levelNotes.nextCopyStart = jmin(levelNotes.nextCopyStart, copyStart);
+                break;
+            }
+
+            const auto copyEnd = copyStart + note.length;
+            const auto isDropped = (note.droppedCopies & (1u << note.nextCopy)) != 0;
+            // a copy that ended already was skipped over by GamelanizerAudioProcessor::simulateProcessing
+            if (!isDropped && copyEnd > position)
+            {
+                jassert(levelNotes.numPlayingCopies < maxPlayingCopies);
+                if (levelNotes.numPlayingCopies < maxPlayingCopies)
+                    levelNotes.playingCopies[levelNotes.numPlayingCopies++] = {
+                        levelNotes.getNoteSamples(slot), copyStart, copyEnd
+                    };
+            }
+            ++note.nextCopy;
+        }
+    }
+}
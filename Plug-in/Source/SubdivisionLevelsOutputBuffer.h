@@ -21,6 +21,8 @@
 */
 
 #pragma once
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "GamelanizerConstants.h"
 
 /** \addtogroup Core
  *  @{
@@ -28,18 +30,209 @@
 
 /**
  * \brief Struct for the buffer where the subdivision level outputs are overlapped and added in the correct positions.
+ *
+ * Each level's phase vocoded note is only overlapped and added once, into a slot of its own. The copies of the note
+ * (Algorithm 1 in the paper) are made when the level is read, by reading the note from every position a copy starts at.
+ * Dropped copies are skipped then. Positions are in samples since playback started, so they never wrap around.
+ *
+ * A note is only read once it's finished, when the level starts its next one. The level can be writing on another
+ * thread than the one reading, as long as each level is only written by one thread at a time.
+ * The reader takes its own copy of each finished note, so the notes the level writes are never read while they change.
  */
 struct SubdivisionLevelsOutputBuffer
 {
     /**
-     * \brief The actual buffer
+     * \return The number of samples that a level's note slots take
+     * \param maxNoteLength The longest a note of the level can be, including the tail of its last synthesis frame.
      */
-    AudioBuffer<float> data;
+    static int calculateNotesLength(int maxNoteLength) { return maxNoteLength * maxNotesPerLevel; }
 
     /**
-     * \brief The read position of every channel in the buffer is the same.
+     * \brief Use new memory for the note slots and forget every note. This doesn't allocate.
+     * \param notesSamples For each level, calculateNotesLength() zeroed samples
+     * \param maxNoteLengths The longest a note of each level can be, including the tail of its last synthesis frame.
      */
-    int readPosition{};
+    void prepare(const std::array<float*, GamelanizerConstants::maxLevels>& notesSamples,
+                 const std::array<int, GamelanizerConstants::maxLevels>& maxNoteLengths);
+
+    /**
+     * \brief Forget every note of every level. The levels can't be writing while this is called.
+     */
+    void clear();
+
+    /**
+     * \brief Forget every note of a level. The level can't be writing while this is called.
+     * \param level The subdivision level
+     */
+    void clearLevel(int level);
+
+    /**
+     * \brief Start the note that a level will write next, in the oldest slot, and finish the one it was writing.
+     * Call this at every beat boundary.
+     * \param level The subdivision level
+     * \param start Where the first copy starts
+     * \param copySpacing The distance between the starts of the copies. Each copy starts at a truncated multiple of it.
+     * \param numCopies The number of copies
+     * \param droppedCopies Bit n is set if copy n shouldn't be heard
+     */
+    void startNote(int level, int64 start, double copySpacing, int numCopies, uint32 droppedCopies);
+
+    /**
+     * \brief Overlap and add samples onto the note a level is writing. It's ahead of the #readPosition, because a level
+     * rendered on another thread is caught up with before its notes are read.
+     * \param level The subdivision level
+     * \param position Where the samples go in the first copy. It can't be before the start of the note.
+     * \param samples The audio data
+     * \param numSamples The number of samples in the second parameter
+     */
+    void addToNote(int level, int64 position, const float* samples, int numSamples);
+
+    /**
+     * \brief Sum all the copies of a level's notes that are heard from the #readPosition on.
+     * This doesn't move the #readPosition.
+     * \param level The subdivision level
+     * \param destination Where to write the sums
+     * \param numSamples The number of samples to read
+     */
+    void readSamples(int level, float* destination, int numSamples);
+
+    /**
+     * \return True if every note of a level that could be heard before a position is finished, so it can be read
+     * up to there. This is only false if the level is being written on another thread that hasn't caught up.
+     * \param level The subdivision level
+     * \param position The end of the samples that will be read
+     */
+    [[nodiscard]] bool isFinishedUpTo(int level, int64 position) const
+    {
+        return position <= levels[level].unfinishedNoteStart.load();
+    }
+
+    /**
+     * \brief The read position of every level is the same. It's atomic because the levels check it when they write.
+     */
+    std::atomic<int64> readPosition{};
+
+private:
+    /**
+     * \brief The notes are written at least a beat ahead of the #readPosition and their last copies end
+     * less than five beats after they start being written, so at most six of them are heard or written at any time.
+     */
+    static constexpr int maxNotesPerLevel{8};
+
+    /**
+     * \brief The most copies of a level that overlap. The tails of the synthesis frames are shorter than a note,
+     * so it's usually two.
+     */
+    static constexpr int maxPlayingCopies{8};
+
+    /**
+     * \brief The most finished notes of a level the reader takes at once. Older notes can't be heard anymore.
+     * This leaves out the oldest finished note, because its slot is the next one the level reuses,
+     * so it could be changing while they're taken.
+     */
+    static constexpr int maxNotesTaken{maxNotesPerLevel - 2};
+
+    struct Note
+    {
+        int64 start{};
+        double copySpacing{};
+        int numCopies{};
+        uint32 droppedCopies{};
+
+        /**
+         * \brief The number of samples that have been written, including the tail of the last synthesis frame.
+         */
+        int length{};
+
+        /**
+         * \brief The copy that starts next. #numCopies if they have all started. Only the reader's copies use this.
+         */
+        int nextCopy{};
+
+        /**
+         * \return Where a copy of this note starts
+         */
+        [[nodiscard]] int64 getCopyStart(const int copy) const
+        {
+            return start + static_cast<int64>(copySpacing * copy);
+        }
+    };
+
+    /**
+     * \brief A copy of a note that's being heard.
+     */
+    struct PlayingCopy
+    {
+        const float* samples;
+        int64 start;
+        int64 end;
+    };
+
+    struct LevelNotes
+    {
+        /**
+         * \brief #maxNotesPerLevel slots of #noteCapacity samples, owned by TempoSizedBuffers
+         */
+        float* samples{};
+
+        int noteCapacity{};
+
+        /**
+         * \brief The notes, written by the level
+         */
+        std::array<Note, maxNotesPerLevel> notes;
+
+        /**
+         * \brief The slot of the note being written. -1 if none has been started.
+         */
+        int currentNote{-1};
+
+        /**
+         * \brief The number of notes that have been finished since the level was cleared.
+         * Note n is in slot n % #maxNotesPerLevel.
+         */
+        std::atomic<int> numFinishedNotes{};
+
+        /**
+         * \brief The start of the note being written. Every note that starts before it is finished.
+         */
+        std::atomic<int64> unfinishedNoteStart{std::numeric_limits<int64>::max()};
+
+        /**
+         * \brief The reader's copies of the finished notes, in the same slots
+         */
+        std::array<Note, maxNotesPerLevel> finishedNotes;
+
+        /**
+         * \brief The number of finished notes the reader has taken
+         */
+        int numNotesTaken{};
+
+        std::array<PlayingCopy, maxPlayingCopies> playingCopies{};
+
+        int numPlayingCopies{};
+
+        /**
+         * \brief The earliest start of the copies that haven't started yet
+         */
+        int64 nextCopyStart{std::numeric_limits<int64>::max()};
+
+        [[nodiscard]] float* getNoteSamples(const int note) { return samples + note * noteCapacity; }
+    };
+
+    std::array<LevelNotes, GamelanizerConstants::maxLevels> levels;
+
+    /**
+     * \brief Copy the notes that were finished since the last time into LevelNotes::finishedNotes,
+     * and move LevelNotes::nextCopyStart to the earliest of them.
+     */
+    static void takeFinishedNotes(LevelNotes& levelNotes);
+
+    /**
+     * \brief Move the copies that start by a position to the LevelNotes::playingCopies,
+     * and find the next LevelNotes::nextCopyStart.
+     */
+    static void startPlayingCopies(LevelNotes& levelNotes, int64 position);
 
     JUCE_LEAK_DETECTOR(SubdivisionLevelsOutputBuffer)
 };
@@ -0,0 +1,650 @@
+/*
+  ==============================================================================
+
+	This file is part of Gamelanizer.
+	Copyright (c) 2019 - Luke McDuffie Craig.
+
+	Gamelanizer is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Gamelanizer is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Gamelanizer. If not, see <https://www.gnu.org/licenses/>.
+
+  ==============================================================================
+*/
+
+#include "SubdivisionLevelsRenderer.h"
+
+SubdivisionLevelsRenderer::SubdivisionLevelsRenderer(
+    std::array<SubdivisionLevel, GamelanizerConstants::maxLevels>& sl) : Thread("Gamelanizer level rendering"),
+                                                                         subdivisionLevels(sl)
+{
+    beatChangeDueAt.fill(-1);
+
+    if (renderingMethod == asynchronousRendering)
+        // it has to keep up with the audio thread
+        startThread(9);
+}
+
+SubdivisionLevelsRenderer::~SubdivisionLevelsRenderer()
+{
+    stopThread(4000);
+}
+
+//==============================================================================
+void SubdivisionLevelsRenderer::prepare(const double newSampleRate, const int maxNumSamples)
+{
+    finishRendering();
+
+    const SpinLock::ScopedLockType lock(renderLock);
+    sampleRate = newSampleRate;
+    if (renderMethod == asynchronousRendering)
+    {
+        commands.resize(maxQueuedCommands);
+        commandFifo.setTotalSize(maxQueuedCommands);
+        // a segment might be split where the FIFO wraps around, but it always fits when the FIFO is empty
+        const auto queueLength = jmax(maxNumSamples + 1, static_cast<int>(std::ceil(sampleRate * maxQueuedSeconds)));
+        queuedInput.setSize(2 * GamelanizerConstants::maxLevels, queueLength);
+        queuedInputFifo.setTotalSize(queueLength);
+    }
+
+    if (parallelism == forkJoinLevels && levelsThreadPool == nullptr)
+        levelsThreadPool = std::make_unique<ForkJoinThreadPool>(GamelanizerConstants::maxLevels - 1);
+
+    if (beatChange == staggeredBeatChange)
+    {
+        beatChangeSpacing = maxNumSamples;
+        // the last group is due after maxLevels - 1 spacings, and the segment that gets there can be a whole block
+        deferredInput.setSize(2 * GamelanizerConstants::maxLevels, GamelanizerConstants::maxLevels * maxNumSamples);
+    }
+}
+
+void SubdivisionLevelsRenderer::processSegment(const std::array<const float*, GamelanizerConstants::maxLevels>& inputs,
+                                               const std::array<const float*, GamelanizerConstants::maxLevels>& pitches,
+                                               const int numSamples, const IdenticalInputs& haveIdenticalInput)
+{
+    if (renderMethod == synchronousRendering)
+    {
+        renderSegment(inputs, pitches, numSamples, haveIdenticalInput);
+        return;
+    }
+
+    // a segment is two commands if it's split where the FIFO wraps around
+    const auto hasRoom = [this, numSamples]
+    {
+        return queuedInputFifo.getFreeSpace() >= numSamples
+            && commandFifo.getFreeSpace() >= 2 + numCommandsReservedForBeatChange;
+    };
+    // if the background thread has fallen too far behind, this thread renders until the segment fits,
+    // so the levels never miss their input. Once everything is rendered the FIFOs are empty, and it always fits then
+    const auto fits = catchUp(hasRoom);
+    jassert(fits);
+    ignoreUnused(fits);
+
+    int start1, size1, start2, size2;
+    queuedInputFifo.prepareToWrite(numSamples, start1, size1, start2, size2);
+
+    queueSegment(inputs, pitches, 0, start1, size1, haveIdenticalInput);
+    if (size2 > 0)
+        queueSegment(inputs, pitches, size1, start2, size2, haveIdenticalInput);
+}
+
+void SubdivisionLevelsRenderer::finishBeat(const BeatEnd& beatEnd)
+{
+    if (renderMethod == synchronousRendering)
+    {
+        renderBeatEnd(beatEnd);
+        return;
+    }
+
+    Command command;
+    command.type = Command::beatEnd;
+    command.beatEndInfo = beatEnd;
+    queueOrRender(command);
+}
+
+void SubdivisionLevelsRenderer::startBeat(const BeatStart& beatStart)
+{
+    if (renderMethod == synchronousRendering)
+    {
+        renderBeatStart(beatStart);
+        return;
+    }
+
+    Command command;
+    command.type = Command::beatStart;
+    command.beatStartInfo = beatStart;
+    queueOrRender(command);
+}
+
+void SubdivisionLevelsRenderer::finishRendering()
+{
+    if (renderMethod == synchronousRendering)
+    {
+        finishDeferredBeatChanges();
+        return;
+    }
+
+    const SpinLock::ScopedLockType lock(renderLock);
+    while (renderQueuedCommand())
+    {
+    }
+    finishDeferredBeatChanges();
+}
+
+//==============================================================================
+void SubdivisionLevelsRenderer::run()
+{
+    while (!threadShouldExit())
+    {
+        auto renderedCommand = false;
+        {
+            // the lock is let go between commands, so that the audio thread can take over
+            const GenericScopedTryLock<SpinLock> lock(renderLock);
+            if (lock.isLocked())
+                renderedCommand = renderQueuedCommand();
+        }
+
+        // the audio thread doesn't notify this thread, because that could block it, so this polls
+        if (!renderedCommand)
+            wait(1);
+    }
+}
+
+void SubdivisionLevelsRenderer::queueSegment(const std::array<const float*, GamelanizerConstants::maxLevels>& inputs,
+                                             const std::array<const float*, GamelanizerConstants::maxLevels>& pitches,
+                                             const int offset, const int inputStart, const int numSamples,
+                                             const IdenticalInputs& haveIdenticalInput)
+{
+    Command command;
+    command.type = Command::segment;
+    command.inputStart = inputStart;
+    command.numSamples = numSamples;
+    command.haveIdenticalInput = haveIdenticalInput;
+    for (auto level = 0; level < GamelanizerConstants::maxLevels; ++level)
+    {
+        command.hasInput[level] = inputs[level] != nullptr;
+        if (command.hasInput[level])
+            FloatVectorOperations::copy(queuedInput.getWritePointer(level, inputStart), inputs[level] + offset,
+                                        numSamples);
+
+        command.hasPitch[level] = pitches[level] != nullptr;
+        if (command.hasPitch[level])
+            FloatVectorOperations::copy(queuedInput.getWritePointer(GamelanizerConstants::maxLevels + level,
+                                                                    inputStart), pitches[level] + offset, numSamples);
+    }
+    queuedInputFifo.finishedWrite(numSamples);
+
+    // processSegment made sure there's room for it
+    jassert(commandFifo.getFreeSpace() > 0);
+    queueOrRender(command);
+}
+
+void SubdivisionLevelsRenderer::queueOrRender(const Command& command)
+{
+    // the segments leave room for a beat change, and once everything is rendered the FIFO is empty
+    const auto fits = catchUp([this] { return commandFifo.getFreeSpace() > 0; });
+    jassert(fits);
+    ignoreUnused(fits);
+
+    int start1, size1, start2, size2;
+    commandFifo.prepareToWrite(1, start1, size1, start2, size2);
+    commands[static_cast<size_t>(start1)] = command;
+    commandFifo.finishedWrite(1);
+}
+
+bool SubdivisionLevelsRenderer::renderQueuedCommand()
+{
+    int start1, size1, start2, size2;
+    commandFifo.prepareToRead(1, start1, size1, start2, size2);
+    if (size1 == 0)
+        return false;
+
+    const auto& command = commands[static_cast<size_t>(start1)];
+    switch (command.type)
+    {
+    case Command::segment:
+        {
+            std::array<const float*, GamelanizerConstants::maxLevels> inputs{};
+            std::array<const float*, GamelanizerConstants::maxLevels> pitches{};
+            for (auto level = 0; level < GamelanizerConstants::maxLevels; ++level)
+            {
+                if (command.hasInput[level])
+                    inputs[level] = queuedInput.getReadPointer(level, command.inputStart);
+                if (command.hasPitch[level])
+                    pitches[level] = queuedInput.getReadPointer(GamelanizerConstants::maxLevels + level,
+                                                                command.inputStart);
+            }
+            renderSegment(inputs, pitches, command.numSamples, command.haveIdenticalInput);
+            queuedInputFifo.finishedRead(command.numSamples);
+            break;
+        }
+    case Command::beatEnd:
+        renderBeatEnd(command.beatEndInfo);
+        break;
+    case Command::beatStart:
+        renderBeatStart(command.beatStartInfo);
+        break;
+    default:
+        jassertfalse;
+        break;
+    }
+
+    commandFifo.finishedRead(1);
+    return true;
+}
+
+//==============================================================================
+void SubdivisionLevelsRenderer::renderSegment(const std::array<const float*, GamelanizerConstants::maxLevels>& inputs,
+                                              const std::array<const float*, GamelanizerConstants::maxLevels>& pitches,
+                                              const int numSamples, const IdenticalInputs& haveIdenticalInput)
+{
+    if (beatChange == simultaneousBeatChange)
+    {
+        renderLevelsSegment(inputs, pitches, numSamples, haveIdenticalInput);
+        return;
+    }
+
+    changeBeatsThatAreDue();
+    if (!isAnyBeatChangeDeferred())
+    {
+        renderLevelsSegment(inputs, pitches, numSamples, haveIdenticalInput);
+        return;
+    }
+
+    if (numDeferredSegments == maxDeferredSegments || numDeferredSamples + numSamples > deferredInput.getNumSamples())
+    {
+        // there's no room to keep the input, so the levels can't wait any longer
+        finishDeferredBeatChanges();
+        renderLevelsSegment(inputs, pitches, numSamples, haveIdenticalInput);
+        return;
+    }
+
+    auto& deferredSegment = deferredSegments[numDeferredSegments++];
+    deferredSegment = {numDeferredSamples, numSamples, {}, {}, haveIdenticalInput};
+    auto levelInputs = inputs;
+    auto levelPitches = pitches;
+    for (auto level = 0; level < GamelanizerConstants::maxLevels; ++level)
+    {
+        if (!isBeatChangeDeferred(level))
+            continue;
+
+        deferredSegment.hasInput[level] = inputs[level] != nullptr;
+        if (deferredSegment.hasInput[level])
+            FloatVectorOperations::copy(deferredInput.getWritePointer(level, numDeferredSamples), inputs[level],
+                                        numSamples);
+
+        deferredSegment.hasPitch[level] = pitches[level] != nullptr;
+        if (deferredSegment.hasPitch[level])
+            FloatVectorOperations::copy(deferredInput.getWritePointer(GamelanizerConstants::maxLevels + level,
+                                                                      numDeferredSamples), pitches[level], numSamples);
+
+        levelInputs[level] = nullptr;
+        levelPitches[level] = nullptr;
+    }
+    numDeferredSamples += numSamples;
+    numSamplesSinceBeatBoundary += numSamples;
+
+    renderLevelsSegment(levelInputs, levelPitches, numSamples, haveIdenticalInput);
+}
+
+void SubdivisionLevelsRenderer::renderBeatEnd(const BeatEnd& beatEnd)
+{
+    if (beatChange == simultaneousBeatChange)
+    {
+        std::array<bool, GamelanizerConstants::maxLevels> allLevels;
+        allLevels.fill(true);
+        finishLevelsBeat(beatEnd, allLevels);
+        return;
+    }
+
+    // the levels that are still on the beat before have to catch up first
+    finishDeferredBeatChanges();
+    deferredBeatEnd = beatEnd;
+    beatEndIsDeferred = true;
+}
+
+void SubdivisionLevelsRenderer::renderBeatStart(const BeatStart& beatStart)
+{
+    std::array<bool, GamelanizerConstants::maxLevels> allLevels;
+    allLevels.fill(true);
+    // finishRendering might have finished the beat already
+    if (beatChange == simultaneousBeatChange || !beatEndIsDeferred)
+    {
+        startLevelsBeat(beatStart, allLevels);
+        return;
+    }
+
+    beatEndIsDeferred = false;
+    deferredBeatStart = beatStart;
+    numSamplesSinceBeatBoundary = 0;
+    scheduleBeatChanges(beatStart);
+    changeBeatsThatAreDue();
+}
+
+//==============================================================================
+void SubdivisionLevelsRenderer::renderLevelsSegment(
+    const std::array<const float*, GamelanizerConstants::maxLevels>& inputs,
+    const std::array<const float*, GamelanizerConstants::maxLevels>& pitches, const int numSamples,
+    const IdenticalInputs& haveIdenticalInput)
+{
+    if (analysisSharingMethod == sharedAnalysis)
+        stopDivergedAnalysisSharing(inputs, haveIdenticalInput);
+
+    if (parallelism == serialLevels)
+    {
+        renderLevelsSegmentSerially(inputs, pitches, numSamples);
+        return;
+    }
+
+    // a level that shares the analysis of another one is synthesized when that one analyzes, so they're in one group
+    std::array<std::array<const float*, GamelanizerConstants::maxLevels>, GamelanizerConstants::maxLevels>
+        groupInputs{}, groupPitches{};
+    std::array<int, GamelanizerConstants::maxLevels> groups{};
+    auto numGroups = 0;
+    for (auto level = 0; level < GamelanizerConstants::maxLevels; ++level)
+    {
+        if (inputs[level] == nullptr)
+            continue;
+
+        groups[level] = -1;
+        for (auto producer = 0; producer < level; ++producer)
+            if (inputs[producer] != nullptr && subdivisionLevels[level].isSharingAnalysisOf(subdivisionLevels[producer]))
+                groups[level] = groups[producer];
+        if (groups[level] < 0)
+            groups[level] = numGroups++;
+
+        groupInputs[groups[level]][level] = inputs[level];
+        groupPitches[groups[level]][level] = pitches[level];
+    }
+
+    if (numGroups <= 1)
+    {
+        renderLevelsSegmentSerially(inputs, pitches, numSamples);
+        return;
+    }
+
+    auto renderGroup = [&](const int group)
+    {
+        renderLevelsSegmentSerially(groupInputs[group], groupPitches[group], numSamples);
+    };
+    levelsThreadPool->run(numGroups, renderGroup);
+}
+
+void SubdivisionLevelsRenderer::renderLevelsSegmentSerially(
+    const std::array<const float*, GamelanizerConstants::maxLevels>& inputs,
+    const std::array<const float*, GamelanizerConstants::maxLevels>& pitches, const int numSamples)
+{
+    std::array<bool, GamelanizerConstants::maxLevels> levelUsesBlockInput{};
+    auto anyLevelUsesSampleInput = false;
+    for (auto level = 0; level < GamelanizerConstants::maxLevels; ++level)
+    {
+        levelUsesBlockInput[level] = inputMethod == blockInput && pitches[level] == nullptr;
+        anyLevelUsesSampleInput = anyLevelUsesSampleInput || (inputs[level] != nullptr && !levelUsesBlockInput[level]);
+    }
+
+    // a level whose pitch is being smoothed synthesizes frames as soon as it has analyzed them,
+    // so the pitch changes of every level are queued in the same order as the samples are pushed
+    for (auto i = 0; anyLevelUsesSampleInput && i < numSamples; ++i)
+    {
+        for (auto level = 0; level < GamelanizerConstants::maxLevels; ++level)
+        {
+            // the inactive levels have no input, and neither do the deferred ones
+            if (inputs[level] == nullptr)
+                continue;
+
+            auto& subdivisionLevel = subdivisionLevels[level];
+            if (pitches[level] != nullptr)
+                subdivisionLevel.pv->queueParams(pitches[level][i]);
+            if (levelUsesBlockInput[level])
+                continue;
+
+            subdivisionLevel.processSample(inputs[level][i]);
+        }
+    }
+
+    for (auto level = 0; level < GamelanizerConstants::maxLevels; ++level)
+        if (levelUsesBlockInput[level] && inputs[level] != nullptr)
+            subdivisionLevels[level].processBlock(inputs[level], numSamples);
+}
+
+void SubdivisionLevelsRenderer::finishLevelsBeat(const BeatEnd& beatEnd,
+                                                 const std::array<bool, GamelanizerConstants::maxLevels>& levels)
+{
+    for (auto level = 0; level < GamelanizerConstants::maxLevels; ++level)
+    {
+        if (!levels[level])
+            continue;
+
+        auto& sl = subdivisionLevels[level];
+        // an inactive level didn't write anything this beat, so this moves its write heads a whole note
+        if (sl.isActive())
+            sl.processFinalHop();
+        sl.fastForwardWriteHeadsToNextBeat();
+        // the method can only change while the analysis frames are empty
+        sl.queuePhaseVocoderPitchShiftingMethod(beatEnd.pitchShiftedSpectrally[level]);
+        sl.pv->resetBetweenBeats();
+        if (beatEnd.wasBeatB)
+            sl.moveWritePosOnBeatB();
+    }
+}
+
+void SubdivisionLevelsRenderer::startLevelsBeat(const BeatStart& beatStart,
+                                                const std::array<bool, GamelanizerConstants::maxLevels>& levels)
+{
+    if (analysisSharingMethod == sharedAnalysis)
+        updateAnalysisSharing(beatStart, levels);
+
+    for (auto level = 0; level < GamelanizerConstants::maxLevels; ++level)
+    {
+        if (!levels[level])
+            continue;
+
+        subdivisionLevels[level].setDroppedCopies(beatStart.droppedCopies[level]);
+        subdivisionLevels[level].startNote(beatStart.beatSampleLength);
+    }
+}
+
+void SubdivisionLevelsRenderer::updateAnalysisSharing(const BeatStart& beatStart,
+                                                      const std::array<bool, GamelanizerConstants::maxLevels>& levels)
+{
+    std::array<SubdivisionLevel*, GamelanizerConstants::maxLevels> analysisSources{};
+    for (auto level = 0; level < GamelanizerConstants::maxLevels; ++level)
+    {
+        // use the first lower level that does its own analysis and is compatible
+        if (!levels[level] || !subdivisionLevels[level].isActive())
+            continue;
+        for (auto producer = 0; producer < level; ++producer)
+        {
+            if (levels[producer] && analysisSources[producer] == nullptr && subdivisionLevels[producer].isActive()
+                && beatStart.haveIdenticalInput[producer][level]
+                && subdivisionLevels[level].canShareAnalysisOf(subdivisionLevels[producer]))
+            {
+                analysisSources[level] = &subdivisionLevels[producer];
+                break;
+            }
+        }
+    }
+
+    for (auto level = 0; level < GamelanizerConstants::maxLevels; ++level)
+        if (levels[level])
+            subdivisionLevels[level].setAnalysisSource(analysisSources[level]);
+
+    // the levels outside of levels keep their sources, so their chains stay the same
+    chainAnalysisConsumers();
+}
+
+void SubdivisionLevelsRenderer::stopDivergedAnalysisSharing(
+    const std::array<const float*, GamelanizerConstants::maxLevels>& inputs, const IdenticalInputs& haveIdenticalInput)
+{
+    auto anyLevelStopped = false;
+    for (auto level = 0; level < GamelanizerConstants::maxLevels; ++level)
+    {
+        // a level that's deferred gets this segment's haveIdenticalInput when it catches up
+        if (inputs[level] == nullptr)
+            continue;
+
+        for (auto producer = 0; producer < level; ++producer)
+        {
+            auto& subdivisionLevel = subdivisionLevels[level];
+            if (subdivisionLevel.isSharingAnalysisOf(subdivisionLevels[producer]) && !haveIdenticalInput[producer][level])
+            {
+                subdivisionLevel.takeOverAnalysis();
+                anyLevelStopped = true;
+            }
+        }
+    }
+
+    if (anyLevelStopped)
+        chainAnalysisConsumers();
+}
+
+void SubdivisionLevelsRenderer::chainAnalysisConsumers()
+{
+    for (auto& subdivisionLevel : subdivisionLevels)
+        subdivisionLevel.setAnalysisConsumer(nullptr);
+
+    for (auto level = 0; level < GamelanizerConstants::maxLevels; ++level)
+    {
+        auto* analysisSource = subdivisionLevels[level].getAnalysisSource();
+        if (analysisSource == nullptr)
+            continue;
+        auto* previousInChain = analysisSource;
+        for (auto lower = level - 1; lower >= 0; --lower)
+        {
+            if (subdivisionLevels[lower].isSharingAnalysisOf(*analysisSource))
+            {
+                previousInChain = &subdivisionLevels[lower];
+                break;
+            }
+        }
+        previousInChain->setAnalysisConsumer(&subdivisionLevels[level]);
+    }
+}
+
+//==============================================================================
+void SubdivisionLevelsRenderer::scheduleBeatChanges(const BeatStart& beatStart)
+{
+    // each group is named after its lowest level
+    std::array<int, GamelanizerConstants::maxLevels> groups{};
+    for (auto level = 0; level < GamelanizerConstants::maxLevels; ++level)
+    {
+        groups[level] = level;
+        for (auto producer = 0; producer < level; ++producer)
+        {
+            // a level that shares the analysis of another one, now or in the next beat, has to change beats with it
+            if (!subdivisionLevels[level].isSharingAnalysisOf(subdivisionLevels[producer])
+                && !(analysisSharingMethod == sharedAnalysis && beatStart.haveIdenticalInput[producer][level]))
+                continue;
+
+            const auto joinedGroup = jmax(groups[level], groups[producer]);
+            const auto intoGroup = jmin(groups[level], groups[producer]);
+            for (auto& group : groups)
+                if (group == joinedGroup)
+                    group = intoGroup;
+        }
+    }
+
+    // the inactive levels only have their write heads moved, so they don't need to wait
+    auto dueAt = 0;
+    for (auto group = 0; group < GamelanizerConstants::maxLevels; ++group)
+    {
+        auto groupIsActive = false;
+        for (auto level = 0; level < GamelanizerConstants::maxLevels; ++level)
+            groupIsActive = groupIsActive || (groups[level] == group && subdivisionLevels[level].isActive());
+
+        for (auto level = 0; level < GamelanizerConstants::maxLevels; ++level)
+            if (groups[level] == group)
+                beatChangeDueAt[level] = groupIsActive ? dueAt : 0;
+
+        if (groupIsActive)
+            dueAt += beatChangeSpacing;
+    }
+}
+
+void SubdivisionLevelsRenderer::changeBeatsThatAreDue()
+{
+    std::array<bool, GamelanizerConstants::maxLevels> dueLevels{};
+    auto anyLevelIsDue = false;
+    for (auto level = 0; level < GamelanizerConstants::maxLevels; ++level)
+    {
+        dueLevels[level] = isBeatChangeDeferred(level) && beatChangeDueAt[level] <= numSamplesSinceBeatBoundary;
+        anyLevelIsDue = anyLevelIsDue || dueLevels[level];
+    }
+
+    if (anyLevelIsDue)
+        changeDeferredBeats(dueLevels);
+}
+
+void SubdivisionLevelsRenderer::changeDeferredBeats(const std::array<bool, GamelanizerConstants::maxLevels>& levels)
+{
+    finishLevelsBeat(deferredBeatEnd, levels);
+    startLevelsBeat(deferredBeatStart, levels);
+    for (auto level = 0; level < GamelanizerConstants::maxLevels; ++level)
+        if (levels[level])
+            beatChangeDueAt[level] = -1;
+
+    // then catch up with the input they missed
+    for (auto segment = 0; segment < numDeferredSegments; ++segment)
+    {
+        const auto& deferredSegment = deferredSegments[segment];
+        std::array<const float*, GamelanizerConstants::maxLevels> inputs{};
+        std::array<const float*, GamelanizerConstants::maxLevels> pitches{};
+        for (auto level = 0; level < GamelanizerConstants::maxLevels; ++level)
+        {
+            if (!levels[level])
+                continue;
+            if (deferredSegment.hasInput[level])
+                inputs[level] = deferredInput.getReadPointer(level, deferredSegment.inputStart);
+            if (deferredSegment.hasPitch[level])
+                pitches[level] = deferredInput.getReadPointer(GamelanizerConstants::maxLevels + level,
+                                                              deferredSegment.inputStart);
+        }
+        renderLevelsSegment(inputs, pitches, deferredSegment.numSamples, deferredSegment.haveIdenticalInput);
+    }
+
+    if (!isAnyBeatChangeDeferred())
+    {
+        numDeferredSegments = 0;
+        numDeferredSamples = 0;
+    }
+}
+
+void SubdivisionLevelsRenderer::finishDeferredBeatChanges()
+{
+    if (beatChange == simultaneousBeatChange)
+        return;
+
+    std::array<bool, GamelanizerConstants::maxLevels> allLevels;
+    allLevels.fill(true);
+    if (beatEndIsDeferred)
+    {
+        // renderBeatStart will start the beat of every level
+        beatEndIsDeferred = false;
+        finishLevelsBeat(deferredBeatEnd, allLevels);
+        return;
+    }
+
+    if (!isAnyBeatChangeDeferred())
+        return;
+
+    std::array<bool, GamelanizerConstants::maxLevels> deferredLevels{};
+    for (auto level = 0; level < GamelanizerConstants::maxLevels; ++level)
+        deferredLevels[level] = isBeatChangeDeferred(level);
+    changeDeferredBeats(deferredLevels);
+}
+
+bool SubdivisionLevelsRenderer::isAnyBeatChangeDeferred() const
+{
+    for (auto level = 0; level < GamelanizerConstants::maxLevels; ++level)
+        if (isBeatChangeDeferred(level))
+            return true;
+    return false;
+}
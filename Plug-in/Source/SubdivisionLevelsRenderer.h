@@ -0,0 +1,545 @@
+/*
+  ==============================================================================
+
+	This file is part of Gamelanizer.
+	Copyright (c) 2019 - Luke McDuffie Craig.
+
+	Gamelanizer is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Gamelanizer is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Gamelanizer. If not, see <https://www.gnu.org/licenses/>.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "ForkJoinThreadPool.h"
+#include "GamelanizerConstants.h"
+#include "SubdivisionLevel.h"
+
+/** \addtogroup Core
+ *  @{
+ */
+
+/**
+ * \brief Runs the phase vocoders of the subdivision levels on their tapered input, and moves them on to the next
+ * beat, so they write their notes into the SubdivisionLevelsOutputBuffer.
+ *
+ * With asynchronousRendering this happens on a background thread. The audio thread only pushes the input and the
+ * beat changes into lock-free single producer, single consumer FIFOs, and reads the notes once they're finished.
+ * The latency is at least two beats, so a note usually isn't heard until long after it's finished. If the background
+ * thread falls behind, the audio thread catches up with catchUp, rendering on its own thread as much as it needs
+ * to read the notes or to make room in the FIFOs. Nothing is dropped and no note is skipped.
+ */
+class SubdivisionLevelsRenderer final : private Thread
+{
+public:
+    /**
+     * \brief The ways the levels can be rendered.
+     */
+    enum RenderingMethod
+    {
+        /**
+         * \brief The levels are rendered on the audio thread, as soon as they get their input.
+         */
+        synchronousRendering,
+
+        /**
+         * \brief The levels are rendered on a single background thread, in the same order as synchronousRendering
+         * would. Levels that share their analysis are synthesized together, so they can't be rendered independently.
+         */
+        asynchronousRendering
+    };
+
+    static constexpr RenderingMethod renderingMethod = synchronousRendering;
+
+    /**
+     * \brief The ways the tapered input is passed to the subdivision levels.
+     */
+    enum LevelInputMethod
+    {
+        /**
+         * \brief Every sample is passed to SubdivisionLevel::processSample.
+         */
+        perSampleInput,
+
+        /**
+         * \brief The input of each segment is passed to SubdivisionLevel::processBlock. Levels whose pitch is being
+         * smoothed fall back to perSampleInput, because their phase vocoder params could change on any sample.
+         */
+        blockInput
+    };
+
+    static constexpr LevelInputMethod levelInputMethod = blockInput;
+
+    /**
+     * \brief The ways the subdivision levels can do their phase vocoder analysis.
+     */
+    enum AnalysisSharingMethod
+    {
+        /**
+         * \brief Every level resamples and analyzes its own input.
+         */
+        independentAnalysis,
+
+        /**
+         * \brief Levels with compatible phase vocoders and identical pitch and taper settings use the resampling and 
+         * analysis of the lowest such level and only do their own synthesis. This is decided at every beat boundary.
+         * If a level's settings stop being identical during the beat, it takes over the analysis state of the
+         * level it was sharing, which was also its own, and continues with its own analysis from the next segment.
+         */
+        sharedAnalysis
+    };
+
+    static constexpr AnalysisSharingMethod analysisSharingMethod = sharedAnalysis;
+
+    /**
+     * \brief The ways the subdivision levels move on to the next beat.
+     */
+    enum BeatChangeMethod
+    {
+        /**
+         * \brief Every level finishes its last hop and starts its next note at the beat boundary.
+         */
+        simultaneousBeatChange,
+
+        /**
+         * \brief The levels are split into groups that don't share their analysis, now or in the next beat.
+         * The group with the lowest level changes beats at the boundary, and each other group changes a block
+         * (the maxNumSamples passed to prepare) after the one before it, so their final hops land in different blocks.
+         * The input of a group is kept until it has changed beats. The notes are written at least a beat before they're
+         * heard, and finishRendering makes every group catch up if they're needed sooner.
+         */
+        staggeredBeatChange
+    };
+
+    static constexpr BeatChangeMethod beatChangeMethod = simultaneousBeatChange;
+
+    /**
+     * \brief The ways the subdivision levels can be rendered alongside each other.
+     */
+    enum LevelParallelismMethod
+    {
+        /**
+         * \brief The levels are rendered one after another.
+         */
+        serialLevels,
+
+        /**
+         * \brief The levels of each segment are split into groups that share their analysis, and the groups are
+         * rendered at the same time on the #levelsThreadPool. They're joined before the segment is finished, so unlike
+         * asynchronousRendering this doesn't need the notes to be rendered ahead of the read head, which suits hosts with
+         * small blocks. The levels only share BeatSampleInfo, which isn't changed during a segment,
+         * and write to their own notes in the SubdivisionLevelsOutputBuffer.
+         */
+        forkJoinLevels
+    };
+
+    static constexpr LevelParallelismMethod levelParallelismMethod = serialLevels;
+
+    /**
+     * \brief GamelanizerParametersVtsHelper::levelsHaveIdenticalPhaseVocoderInput for each producer
+     * and higher level, indexed [producer][level]. Only used with sharedAnalysis.
+     */
+    typedef std::array<std::array<bool, GamelanizerConstants::maxLevels>, GamelanizerConstants::maxLevels>
+    IdenticalInputs;
+
+    /**
+     * \brief What the levels need to know about the parameters to finish a beat, taken on the audio thread.
+     */
+    struct BeatEnd
+    {
+        /**
+         * \brief BeatSampleInfo::isBeatB of the beat that's ending
+         */
+        bool wasBeatB{};
+
+        /**
+         * \brief GamelanizerParametersVtsHelper::isPitchShiftedSpectrally for each level
+         */
+        std::array<bool, GamelanizerConstants::maxLevels> pitchShiftedSpectrally{};
+    };
+
+    /**
+     * \brief What the levels need to know about the parameters to start a beat, taken on the audio thread.
+     */
+    struct BeatStart
+    {
+        /**
+         * \brief BeatSampleInfo::getBeatSampleLength of the beat that's starting
+         */
+        int beatSampleLength{};
+
+        /**
+         * \brief SubdivisionLevel::calculateDroppedCopies for each level
+         */
+        std::array<uint32, GamelanizerConstants::maxLevels> droppedCopies{};
+
+        /**
+         * \brief Which levels can share their analysis in the beat that's starting
+         */
+        IdenticalInputs haveIdenticalInput{};
+    };
+
+    //==============================================================================
+    /**
+     * \param sl a reference to GamelanizerAudioProcessor::subdivisionLevels
+     */
+    explicit SubdivisionLevelsRenderer(std::array<SubdivisionLevel, GamelanizerConstants::maxLevels>& sl);
+
+    SubdivisionLevelsRenderer(const SubdivisionLevelsRenderer&) = delete;
+
+    SubdivisionLevelsRenderer& operator=(const SubdivisionLevelsRenderer&) = delete;
+
+    SubdivisionLevelsRenderer(SubdivisionLevelsRenderer&&) = delete;
+
+    SubdivisionLevelsRenderer& operator=(SubdivisionLevelsRenderer&&) = delete;
+
+    ~SubdivisionLevelsRenderer() override;
+
+    //==============================================================================
+    /**
+     * \brief Render everything that's queued, then allocate the FIFOs and the deferred input. Only call this while
+     * the audio thread isn't running.
+     * \param sampleRate The sample rate, which the length of the input FIFO depends on
+     * \param maxNumSamples The longest segment that will be passed to processSegment
+     */
+    void prepare(double sampleRate, int maxNumSamples);
+
+    /**
+     * \brief Pass a segment of tapered input to the levels. A segment never goes past a beat boundary.
+     * \param inputs The input of each level, or nullptr for the inactive ones
+     * \param pitches The pitch of each level for every sample, or nullptr if it didn't change in this segment
+     * \param numSamples The length of the segment
+     * \param haveIdenticalInput Which levels had identical input for the whole segment. A level that is sharing the
+     * analysis of one it no longer has identical input with stops sharing it before the segment.
+     */
+    void processSegment(const std::array<const float*, GamelanizerConstants::maxLevels>& inputs,
+                        const std::array<const float*, GamelanizerConstants::maxLevels>& pitches, int numSamples,
+                        const IdenticalInputs& haveIdenticalInput);
+
+    /**
+     * \brief Finish the notes of the beat that's ending and move the write heads to the next one.
+     * The levels can be (de)activated after this.
+     */
+    void finishBeat(const BeatEnd& beatEnd);
+
+    /**
+     * \brief Decide which levels share their analysis and start the notes of the next beat.
+     */
+    void startBeat(const BeatStart& beatStart);
+
+    /**
+     * \brief Render everything that's queued or deferred on this thread. Afterwards the levels are up to date with
+     * their input, and they can be changed on this thread until the next segment or beat change is passed on.
+     * Nothing is queued with synchronousRendering, and nothing is deferred with simultaneousBeatChange.
+     */
+    void finishRendering();
+
+    /**
+     * \brief Render the queued commands and the deferred beat changes on this thread until a condition is met.
+     * Unlike finishRendering it only renders as much as it has to, and it never waits for the background thread
+     * to let go of #renderLock, it just checks again.
+     * \param isCaughtUp Returns true once enough has been rendered
+     * \return The last result of isCaughtUp, which is only false if everything was rendered before it was met
+     */
+    template <typename Condition>
+    bool catchUp(Condition isCaughtUp)
+    {
+        while (!isCaughtUp())
+        {
+            if (!renderLock.tryEnter())
+                continue;
+
+            const auto renderedCommand = renderQueuedCommand();
+            if (!renderedCommand)
+                finishDeferredBeatChanges();
+            renderLock.exit();
+
+            // there's nothing left to render
+            if (!renderedCommand)
+                return isCaughtUp();
+        }
+        return true;
+    }
+
+private:
+    /**
+     * \brief Switches #inputMethod, #renderMethod, #beatChange and #parallelism to compare the methods
+     */
+    friend class TestRender;
+
+    /**
+     * \brief #levelInputMethod. Only the tests change it.
+     */
+    LevelInputMethod inputMethod{levelInputMethod};
+
+    /**
+     * \brief #renderingMethod. Only the tests change it, before prepare. The background thread is only started for
+     * #renderingMethod, so when they switch this to asynchronousRendering the audio thread has to catch up with
+     * everything.
+     */
+    RenderingMethod renderMethod{renderingMethod};
+
+    /**
+     * \brief #beatChangeMethod. Only the tests change it, before prepare.
+     */
+    BeatChangeMethod beatChange{beatChangeMethod};
+
+    /**
+     * \brief #levelParallelismMethod. Only the tests change it, before prepare.
+     */
+    LevelParallelismMethod parallelism{levelParallelismMethod};
+
+    /**
+     * \brief Something the levels are asked to do, in the order they're asked to do it.
+     */
+    struct Command
+    {
+        enum Type
+        {
+            segment,
+            beatEnd,
+            beatStart
+        };
+
+        Type type{};
+
+        /**
+         * \brief Where the segment is in #queuedInput
+         */
+        int inputStart{};
+
+        int numSamples{};
+
+        /**
+         * \brief Which levels have input and pitch channels in #queuedInput
+         */
+        std::array<bool, GamelanizerConstants::maxLevels> hasInput{}, hasPitch{};
+
+        IdenticalInputs haveIdenticalInput{};
+
+        BeatEnd beatEndInfo;
+
+        BeatStart beatStartInfo;
+    };
+
+    /**
+     * \brief The number of commands that can be queued. If it's full, the audio thread catches up.
+     */
+    static constexpr int maxQueuedCommands{1024};
+
+    /**
+     * \brief The commands that segments leave room for, so that the beat change after them can always be queued
+     */
+    static constexpr int numCommandsReservedForBeatChange{2};
+
+    /**
+     * \brief How much input can be queued. If it's full, the audio thread catches up.
+     */
+    static constexpr double maxQueuedSeconds{1.0};
+
+    /**
+     * \brief A segment that was passed on while some levels' beat change was deferred.
+     */
+    struct DeferredSegment
+    {
+        /**
+         * \brief Where the segment is in #deferredInput
+         */
+        int inputStart{};
+
+        int numSamples{};
+
+        /**
+         * \brief Which levels have input and pitch channels in #deferredInput
+         */
+        std::array<bool, GamelanizerConstants::maxLevels> hasInput{}, hasPitch{};
+
+        IdenticalInputs haveIdenticalInput{};
+    };
+
+    /**
+     * \brief The number of segments that can be deferred. If there are more, every level changes beats right away.
+     */
+    static constexpr int maxDeferredSegments{64};
+
+    //==============================================================================
+    void run() override;
+
+    /**
+     * \brief Copy a segment into #queuedInput and queue it. It has to fit without wrapping around.
+     */
+    void queueSegment(const std::array<const float*, GamelanizerConstants::maxLevels>& inputs,
+                      const std::array<const float*, GamelanizerConstants::maxLevels>& pitches,
+                      int offset, int inputStart, int numSamples, const IdenticalInputs& haveIdenticalInput);
+
+    /**
+     * \brief Queue a command for the background thread, or render it here if the FIFO is full.
+     */
+    void queueOrRender(const Command& command);
+
+    /**
+     * \brief Render the oldest queued command. Only call this while holding #renderLock.
+     * \return False if nothing was queued
+     */
+    bool renderQueuedCommand();
+
+    /**
+     * \brief Render a segment, or keep the input of the levels whose beat change is deferred.
+     */
+    void renderSegment(const std::array<const float*, GamelanizerConstants::maxLevels>& inputs,
+                       const std::array<const float*, GamelanizerConstants::maxLevels>& pitches, int numSamples,
+                       const IdenticalInputs& haveIdenticalInput);
+
+    /**
+     * \brief Finish the beat, or with staggeredBeatChange, wait for the BeatStart.
+     */
+    void renderBeatEnd(const BeatEnd& beatEnd);
+
+    /**
+     * \brief Start the beat, or with staggeredBeatChange, decide when each group of levels changes beats.
+     */
+    void renderBeatStart(const BeatStart& beatStart);
+
+    /**
+     * \brief Pass a segment to the levels that have input in it. The others are inactive or deferred.
+     * With forkJoinLevels, the groups of levels that share their analysis are passed it on the #levelsThreadPool.
+     */
+    void renderLevelsSegment(const std::array<const float*, GamelanizerConstants::maxLevels>& inputs,
+                             const std::array<const float*, GamelanizerConstants::maxLevels>& pitches,
+                             int numSamples, const IdenticalInputs& haveIdenticalInput);
+
+    /**
+     * \brief Pass a segment to the levels that have input in it, one after another.
+     */
+    void renderLevelsSegmentSerially(const std::array<const float*, GamelanizerConstants::maxLevels>& inputs,
+                                     const std::array<const float*, GamelanizerConstants::maxLevels>& pitches,
+                                     int numSamples);
+
+    void finishLevelsBeat(const BeatEnd& beatEnd, const std::array<bool, GamelanizerConstants::maxLevels>& levels);
+
+    void startLevelsBeat(const BeatStart& beatStart, const std::array<bool, GamelanizerConstants::maxLevels>& levels);
+
+    /**
+     * \brief Decide which of some levels share their analysis for the next beat. Levels outside of them can't be
+     * their analysis source.
+     */
+    void updateAnalysisSharing(const BeatStart& beatStart,
+                               const std::array<bool, GamelanizerConstants::maxLevels>& levels);
+
+    /**
+     * \brief Make the levels with input in a segment stop sharing the analysis of a level whose input is no longer
+     * identical to theirs. They take over its analysis state, and do their own analysis from this segment on.
+     */
+    void stopDivergedAnalysisSharing(const std::array<const float*, GamelanizerConstants::maxLevels>& inputs,
+                                     const IdenticalInputs& haveIdenticalInput);
+
+    /**
+     * \brief Chain the levels that share each analysis in ascending order, starting with their analysis source,
+     * so that each frame is passed along the chain.
+     */
+    void chainAnalysisConsumers();
+
+    /**
+     * \brief Split the levels into groups that don't share their analysis, now or in the next beat, and set
+     * #beatChangeDueAt for each of them.
+     */
+    void scheduleBeatChanges(const BeatStart& beatStart);
+
+    /**
+     * \brief Change beats for the groups that are due by #numSamplesSinceBeatBoundary.
+     */
+    void changeBeatsThatAreDue();
+
+    /**
+     * \brief Change beats for some deferred levels and pass them the #deferredSegments.
+     */
+    void changeDeferredBeats(const std::array<bool, GamelanizerConstants::maxLevels>& levels);
+
+    /**
+     * \brief Change beats for every deferred level.
+     */
+    void finishDeferredBeatChanges();
+
+    [[nodiscard]] bool isBeatChangeDeferred(const int level) const { return beatChangeDueAt[level] >= 0; }
+
+    [[nodiscard]] bool isAnyBeatChangeDeferred() const;
+
+    //==============================================================================
+    /**
+     * \brief Reference to GamelanizerAudioProcessor::subdivisionLevels
+     */
+    std::array<SubdivisionLevel, GamelanizerConstants::maxLevels>& subdivisionLevels;
+
+    /**
+     * \brief Held by whichever thread is rendering the queued commands. The background thread only holds it
+     * for one command at a time, so the audio thread doesn't wait long in finishRendering.
+     */
+    SpinLock renderLock;
+
+    double sampleRate{44100.0};
+
+    std::vector<Command> commands;
+
+    AbstractFifo commandFifo{1};
+
+    /**
+     * \brief The input of each level, then the pitch of each level, for the queued segments
+     */
+    AudioBuffer<float> queuedInput;
+
+    AbstractFifo queuedInputFifo{1};
+
+    /**
+     * \brief A worker for every level but the first. It's only created by prepare with forkJoinLevels.
+     */
+    std::unique_ptr<ForkJoinThreadPool> levelsThreadPool;
+
+    //==============================================================================
+    /**
+     * \brief The distance between the beat changes of the groups of levels. See staggeredBeatChange.
+     */
+    int beatChangeSpacing{};
+
+    /**
+     * \brief True between renderBeatEnd and renderBeatStart, with staggeredBeatChange
+     */
+    bool beatEndIsDeferred{};
+
+    BeatEnd deferredBeatEnd;
+
+    BeatStart deferredBeatStart;
+
+    /**
+     * \brief The number of samples since the last beat boundary at which each level changes beats.
+     * -1 if it has already.
+     */
+    std::array<int, GamelanizerConstants::maxLevels> beatChangeDueAt{};
+
+    int numSamplesSinceBeatBoundary{};
+
+    /**
+     * \brief The input of each level, then the pitch of each level, for the #deferredSegments
+     */
+    AudioBuffer<float> deferredInput;
+
+    std::array<DeferredSegment, maxDeferredSegments> deferredSegments;
+
+    int numDeferredSegments{};
+
+    int numDeferredSamples{};
+
+    JUCE_LEAK_DETECTOR(SubdivisionLevelsRenderer)
+};
+
+/** @}*/
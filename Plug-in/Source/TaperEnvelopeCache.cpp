@@ -0,0 +1,80 @@
+/*
+  ==============================================================================
+
+	This file is part of Gamelanizer.
+	Copyright (c) 2019 - Luke McDuffie Craig.
+
+	Gamelanizer is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Gamelanizer is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Gamelanizer. If not, see <https://www.gnu.org/licenses/>.
+
+  ==============================================================================
+*/
+
+#include "TaperEnvelopeCache.h"
+#include "WindowingFunctions.h"
+
+void TaperEnvelopeCache::prepare(float* slotsSamples, const int maxSamplesPerBeat)
+{
+    slotLength = maxSamplesPerBeat + 1;
+    for (auto i = 0; i < numSlots; ++i)
+        slots[i] = {-1, 0.0f, 0, 0, slotsSamples + i * slotLength};
+    useCount = 0;
+}
+
+void TaperEnvelopeCache::applyTaper(const float* source, float* destination, const int numSamples,
+                                    const int samplesIntoBeat, const int beatSampleLength, const float alpha)
+{
+    // the envelope would be all 1s
+    if (alpha == 0.0f)
+    {
+        if (destination != source)
+            FloatVectorOperations::copy(destination, source, numSamples);
+        return;
+    }
+
+    const auto end = samplesIntoBeat + numSamples;
+    // the beat is longer than the slots, which can only happen until a reallocation is swapped in
+    if (end > slotLength)
+    {
+        for (auto i = 0; i < numSamples; ++i)
+            destination[i] = source[i] * WindowingFunctions::tukeyWindow(samplesIntoBeat + i, beatSampleLength, alpha);
+        return;
+    }
+
+    auto& slot = findSlot(beatSampleLength, alpha);
+    for (; slot.numFilled < end; ++slot.numFilled)
+        slot.envelope[slot.numFilled] = WindowingFunctions::tukeyWindow(slot.numFilled, beatSampleLength, alpha);
+
+    FloatVectorOperations::multiply(destination, source, slot.envelope + samplesIntoBeat, numSamples);
+}
+
+TaperEnvelopeCache::Slot& TaperEnvelopeCache::findSlot(const int beatSampleLength, const float alpha)
+{
+    ++useCount;
+    // free slots were last used at 0, so they're taken first
+    auto* leastRecentlyUsed = &slots[0];
+    for (auto& slot : slots)
+    {
+        if (slot.beatSampleLength == beatSampleLength && slot.alpha == alpha)
+        {
+            slot.lastUsed = useCount;
+            return slot;
+        }
+
+        if (slot.lastUsed < leastRecentlyUsed->lastUsed)
+            leastRecentlyUsed = &slot;
+    }
+
+    *leastRecentlyUsed = {beatSampleLength, alpha, 0, useCount, leastRecentlyUsed->envelope};
+    return *leastRecentlyUsed;
+}
@@ -0,0 +1,120 @@
+/*
+  ==============================================================================
+
+	This file is part of Gamelanizer.
+	Copyright (c) 2019 - Luke McDuffie Craig.
+
+	Gamelanizer is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Gamelanizer is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Gamelanizer. If not, see <https://www.gnu.org/licenses/>.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "GamelanizerConstants.h"
+
+/** \addtogroup Core
+ *  @{
+ */
+
+/**
+ * \brief The Tukey taper envelopes of the subdivision levels' input, so that WindowingFunctions::tukeyWindow
+ * doesn't have to be evaluated for every sample of every level.
+ *
+ * An envelope only depends on the beat length and the taper's alpha, so levels with the same alpha share one.
+ * Envelopes are filled in lazily, up to the furthest sample that has been tapered with them, and are kept for as long
+ * as there are free slots. When the samples per beat isn't a whole number the beat lengths alternate,
+ * so there are slots for two lengths of every level's alpha.
+ */
+class TaperEnvelopeCache
+{
+public:
+    TaperEnvelopeCache() = default;
+
+    TaperEnvelopeCache(const TaperEnvelopeCache&) = delete;
+
+    TaperEnvelopeCache& operator=(const TaperEnvelopeCache&) = delete;
+
+    TaperEnvelopeCache(TaperEnvelopeCache&&) = delete;
+
+    TaperEnvelopeCache& operator=(TaperEnvelopeCache&&) = delete;
+
+    ~TaperEnvelopeCache() = default;
+
+    //==============================================================================
+    static constexpr int numSlots{2 * GamelanizerConstants::maxLevels};
+
+    /**
+     * \return The number of samples that all the slots take
+     * \param maxSamplesPerBeat The longest beat the envelopes have to fit
+     */
+    static int calculateSlotsLength(int maxSamplesPerBeat) { return (maxSamplesPerBeat + 1) * numSlots; }
+
+    /**
+     * \brief Use new memory for the slots and forget every envelope. This doesn't allocate.
+     * \param slotsSamples calculateSlotsLength() samples
+     * \param maxSamplesPerBeat The longest beat the envelopes have to fit
+     */
+    void prepare(float* slotsSamples, int maxSamplesPerBeat);
+
+    /**
+     * \brief Multiply a span of a beat by its taper envelope.
+     * \param source The samples of the span
+     * \param destination Where the tapered samples go. It can be the same as source.
+     * \param numSamples The length of the span
+     * \param samplesIntoBeat Where the span starts in the beat, see BeatSampleInfo
+     * \param beatSampleLength See BeatSampleInfo
+     * \param alpha The taper, see WindowingFunctions::tukeyWindow
+     */
+    void applyTaper(const float* source, float* destination, int numSamples, int samplesIntoBeat,
+                    int beatSampleLength, float alpha);
+
+private:
+    struct Slot
+    {
+        /**
+         * \brief -1 if the slot is free
+         */
+        int beatSampleLength{-1};
+        float alpha{};
+        /**
+         * \brief The envelope is filled in from the start of the beat up to here
+         */
+        int numFilled{};
+        /**
+         * \brief The value of #useCount when the slot was last used, to find the least recently used one
+         */
+        uint64 lastUsed{};
+        float* envelope{};
+    };
+
+    std::array<Slot, numSlots> slots{};
+
+    uint64 useCount{};
+
+    /**
+     * \brief The most samples an envelope can have, which is one more than the longest beatSampleLength
+     */
+    int slotLength{};
+
+    /**
+     * \return The slot for this envelope. If there isn't one, the least recently used slot is emptied for it.
+     */
+    Slot& findSlot(int beatSampleLength, float alpha);
+
+    //==============================================================================
+    JUCE_LEAK_DETECTOR(TaperEnvelopeCache)
+};
+
+/** @}*/
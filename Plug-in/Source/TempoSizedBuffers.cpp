@@ -0,0 +1,153 @@
+/*
+  ==============================================================================
+
+	This file is part of Gamelanizer.
+	Copyright (c) 2019 - Luke McDuffie Craig.
+
+	Gamelanizer is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Gamelanizer is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Gamelanizer. If not, see <https://www.gnu.org/licenses/>.
+
+  ==============================================================================
+*/
+
+#include "TempoSizedBuffers.h"
+
+TempoSizedBuffers::Allocation::Allocation(const Sizes& sizesToAllocate) : sizes{sizesToAllocate},
+                                                                           baseDelay(static_cast<size_t>(
+                                                                               sizesToAllocate.baseDelayLength)),
+                                                                           taperEnvelopes(static_cast<size_t>(
+                                                                               TaperEnvelopeCache::calculateSlotsLength(
+                                                                                   sizesToAllocate.maxSamplesPerBeat)))
+{
+    for (auto level = 0; level < GamelanizerConstants::maxLevels; ++level)
+        levelNotes[level].resize(static_cast<size_t>(
+            SubdivisionLevelsOutputBuffer::calculateNotesLength(sizes.maxNoteLengths[level])));
+}
+
+size_t TempoSizedBuffers::Allocation::getSizeInBytes() const
+{
+    auto numSamples = baseDelay.size();
+    for (const auto& notes : levelNotes)
+        numSamples += notes.size();
+    numSamples += taperEnvelopes.size();
+    return numSamples * sizeof(float);
+}
+
+//==============================================================================
+TempoSizedBuffers::TempoSizedBuffers() : Thread("Gamelanizer buffer reallocation"),
+                                         current{std::make_unique<Allocation>(Sizes{})}
+{
+    jassert(reallocation.is_lock_free());
+    jassert(currentSizeInBytes.is_lock_free());
+    startThread();
+}
+
+TempoSizedBuffers::~TempoSizedBuffers()
+{
+    stopThread(4000);
+    delete reallocation.exchange(nullptr);
+    delete retired.exchange(nullptr);
+}
+
+//==============================================================================
+void TempoSizedBuffers::allocateNow(const Sizes& newSizes)
+{
+    {
+        const ScopedLock lock(requestLock);
+        latestSizes = newSizes;
+        hasRequest = false;
+        ++requestNumber;
+        cancelReallocation();
+    }
+    // the audio thread isn't running, so the memory it was using can be freed here
+    current = std::make_unique<Allocation>(newSizes);
+    currentSizeInBytes.store(current->getSizeInBytes());
+}
+
+bool TempoSizedBuffers::needsReallocation(const int samplesPerBeat) const
+{
+    const ScopedLock lock(requestLock);
+    return latestSizes.maxSamplesPerBeat < samplesPerBeat
+        || latestSizes.maxSamplesPerBeat > samplesPerBeat * headroom * 2.0;
+}
+
+void TempoSizedBuffers::requestReallocation(const Sizes& newSizes)
+{
+    {
+        const ScopedLock lock(requestLock);
+        latestSizes = newSizes;
+        hasRequest = true;
+        ++requestNumber;
+    }
+    notify();
+}
+
+bool TempoSizedBuffers::swapInReallocation() noexcept
+{
+    // wait until the background thread has freed the last one
+    if (retired.load() != nullptr || reallocation.load() == nullptr)
+        return false;
+
+    // retire the current one before taking the new one, so the background thread always sees one of them
+    retired.store(current.get());
+    auto* next = reallocation.exchange(nullptr);
+    if (next == nullptr)
+    {
+        // only allocateNow takes it away without replacing it, and the audio thread isn't running then
+        jassertfalse;
+        retired.store(nullptr);
+        return false;
+    }
+    // the background thread owns the old one now
+    current.release();
+    current.reset(next);
+    currentSizeInBytes.store(current->getSizeInBytes());
+    return true;
+}
+
+//==============================================================================
+void TempoSizedBuffers::run()
+{
+    while (!threadShouldExit())
+    {
+        delete retired.exchange(nullptr);
+
+        Sizes sizes;
+        auto number = 0;
+        auto hasNewRequest = false;
+        {
+            const ScopedLock lock(requestLock);
+            std::swap(hasNewRequest, hasRequest);
+            sizes = latestSizes;
+            number = requestNumber;
+        }
+
+        if (hasNewRequest)
+        {
+            auto allocation = std::make_unique<Allocation>(sizes);
+            const ScopedLock lock(requestLock);
+            // if there was a newer request this one is freed when it goes out of scope
+            if (number == requestNumber)
+                delete reallocation.exchange(allocation.release());
+        }
+
+        // poll until the audio thread swaps it in and the memory it swaps out can be freed
+        wait(reallocation.load() != nullptr || retired.load() != nullptr ? 50 : -1);
+    }
+}
+
+void TempoSizedBuffers::cancelReallocation()
+{
+    delete reallocation.exchange(nullptr);
+    delete retired.exchange(nullptr);
+}
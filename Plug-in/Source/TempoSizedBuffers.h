@@ -0,0 +1,176 @@
+/*
+  ==============================================================================
+
+	This file is part of Gamelanizer.
+	Copyright (c) 2019 - Luke McDuffie Craig.
+
+	Gamelanizer is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Gamelanizer is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Gamelanizer. If not, see <https://www.gnu.org/licenses/>.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "GamelanizerConstants.h"
+#include "SubdivisionLevelsOutputBuffer.h"
+#include "TaperEnvelopeCache.h"
+
+/** \addtogroup Core
+ *  @{
+ */
+
+/**
+ * \brief Owns the memory of the buffers whose lengths depend on the tempo, the base delay buffer,
+ * the SubdivisionLevelsOutputBuffer and the TaperEnvelopeCache, and reallocates it on a background thread
+ * when the tempo changes.
+ *
+ * The audio thread picks up a reallocation with swapInReallocation(), which only exchanges pointers.
+ * The memory it replaces is freed on the background thread.
+ */
+class TempoSizedBuffers : private Thread
+{
+public:
+    /**
+     * \brief The lengths of the buffers, in samples.
+     */
+    struct Sizes
+    {
+        /**
+         * \brief The longest beat that the buffers fit
+         */
+        int maxSamplesPerBeat{};
+
+        int baseDelayLength{};
+
+        /**
+         * \brief The longest a note of each level can be, for SubdivisionLevelsOutputBuffer::prepare
+         */
+        std::array<int, GamelanizerConstants::maxLevels> maxNoteLengths{};
+    };
+
+    /**
+     * \brief The memory for one set of Sizes. It's zeroed when it's allocated.
+     */
+    struct Allocation
+    {
+        explicit Allocation(const Sizes& sizesToAllocate);
+
+        [[nodiscard]] size_t getSizeInBytes() const;
+
+        const Sizes sizes;
+
+        std::vector<float> baseDelay;
+
+        std::array<std::vector<float>, GamelanizerConstants::maxLevels> levelNotes;
+
+        std::vector<float> taperEnvelopes;
+    };
+
+    //==============================================================================
+    TempoSizedBuffers();
+
+    TempoSizedBuffers(const TempoSizedBuffers&) = delete;
+
+    TempoSizedBuffers& operator=(const TempoSizedBuffers&) = delete;
+
+    TempoSizedBuffers(TempoSizedBuffers&&) = delete;
+
+    TempoSizedBuffers& operator=(TempoSizedBuffers&&) = delete;
+
+    ~TempoSizedBuffers() override;
+
+    //==============================================================================
+    /**
+     * \brief The buffers are allocated for beats this much longer than the ones at the current tempo,
+     * so that small tempo changes don't reallocate.
+     */
+    static constexpr double headroom{1.25};
+
+    /**
+     * \brief Allocate on this thread and make it current, cancelling any reallocation that hasn't been swapped in.
+     * Only call this while the audio thread isn't running, like in GamelanizerAudioProcessor::prepareToPlay.
+     */
+    void allocateNow(const Sizes& newSizes);
+
+    /**
+     * \return True if the latest allocation, or reallocation that was requested, doesn't fit beats this long or is
+     * more than twice as big as it needs to be with the #headroom.
+     */
+    [[nodiscard]] bool needsReallocation(int samplesPerBeat) const;
+
+    /**
+     * \brief Allocate on the background thread. The last request replaces any that haven't been handled yet.
+     */
+    void requestReallocation(const Sizes& newSizes);
+
+    /**
+     * \brief Called from the audio thread. If a reallocation is ready, make it current. This doesn't allocate or free.
+     * \return True if the current allocation changed and the buffers have to refer to it.
+     */
+    bool swapInReallocation() noexcept;
+
+    /**
+     * \brief Only call this from the audio thread or while it isn't running.
+     */
+    [[nodiscard]] Allocation& getCurrent() noexcept { return *current; }
+
+    /**
+     * \brief Thread safe way to know how much memory the current allocation takes.
+     */
+    [[nodiscard]] size_t getSizeInBytes() const noexcept { return currentSizeInBytes.load(); }
+
+private:
+    void run() override;
+
+    /**
+     * \brief Delete the reallocation that hasn't been swapped in and the allocation that was swapped out, if there are any.
+     */
+    void cancelReallocation();
+
+    std::unique_ptr<Allocation> current;
+
+    /**
+     * \brief A reallocation that's ready to be swapped in, set by the background thread.
+     */
+    std::atomic<Allocation*> reallocation{};
+
+    /**
+     * \brief An allocation that was swapped out, for the background thread to delete.
+     * The audio thread doesn't swap again until this has been taken.
+     */
+    std::atomic<Allocation*> retired{};
+
+    std::atomic<size_t> currentSizeInBytes{};
+
+    /**
+     * \brief Guards the fields below. It's never locked by the audio thread.
+     */
+    CriticalSection requestLock;
+
+    /**
+     * \brief The sizes of the latest allocation or request
+     */
+    Sizes latestSizes;
+
+    bool hasRequest{};
+
+    /**
+     * \brief Incremented on every request, so that a reallocation that finishes after a newer request isn't used.
+     */
+    int requestNumber{};
+
+    JUCE_LEAK_DETECTOR(TempoSizedBuffers)
+};
+
+/** @}*/
@@ -50,3 +50,25 @@ float WindowingFunctions::tukeyWindow(const int x, const int length, const float
     }
     return 0.0f;
 }
+
+double WindowingFunctions::kaiserWindow(const double x, const double beta)
+{
+    if (std::abs(x) > 1.0)
+        return 0.0;
+
+    // the zeroth order modified Bessel function of the first kind, by its power series
+    const auto besselI0 = [](const double z)
+    {
+        auto sum = 1.0;
+        auto term = 1.0;
+        for (auto k = 1; k < 50; ++k)
+        {
+            term *= (z * 0.5 / k) * (z * 0.5 / k);
+            sum += term;
+            if (term < sum * 1.0e-12)
+                break;
+        }
+        return sum;
+    };
+    return besselI0(beta * std::sqrt(1.0 - x * x)) / besselI0(beta);
+}
@@ -45,6 +45,15 @@ struct WindowingFunctions
      */
     static float tukeyWindow(int x, int length, float alpha);
 
+    /**
+     * \brief A Kaiser window.
+     * \param x The position along the window, from -1 to 1.
+     * \param beta The shape parameter. Larger values have lower sidelobes and a wider main lobe.
+     * \return a point on the window at position x, or 0 outside of it
+     * \see https://en.wikipedia.org/wiki/Kaiser_window
+     */
+    static double kaiserWindow(double x, double beta);
+
     /**
      * \brief Fill an array with a nonsymmetric Hann window.     
      * \param window The array to fill.
@@ -0,0 +1,68 @@
+/*
+  ==============================================================================
+
+	This file is part of Gamelanizer.
+	Copyright (c) 2019 - Luke McDuffie Craig.
+
+	Gamelanizer is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Gamelanizer is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Gamelanizer. If not, see <https://www.gnu.org/licenses/>.
+
+  ==============================================================================
+*/
+
+#include "../../JuceLibraryCode/JuceHeader.h"
+#include "TestRender.h"
+
+/**
+ * \brief Checks that SubdivisionLevelsRenderer::blockInput is bit-identical to SubdivisionLevelsRenderer::perSampleInput.
+ *
+ * The input is rendered through the processor with each method, so every level gets its input from
+ * SubdivisionLevelsRenderer, through SubdivisionLevel::processSample or SubdivisionLevel::processBlock. With blocks of
+ * 37 samples the segments end partway through the hops. The pitch of levels 0 and 1 is smoothed during the render,
+ * so blockInput falls back to per-sample input for them, and levels 2 and 3 share their analysis until their tapers
+ * differ. The stereo out and the individual out of every level have to be the same.
+ */
+class LevelInputMethodTest final : public UnitTest
+{
+public:
+    LevelInputMethodTest() : UnitTest("Level input methods", "Gamelanizer")
+    {
+    }
+
+    void runTest() override
+    {
+        const auto input = TestRender::createInput();
+        for (const auto blockSize : {512, 37})
+        {
+            beginTest("Block input is bit-identical to per-sample input, with blocks of " + String(blockSize));
+            RendererMethods perSampleMethods;
+            perSampleMethods.levelInput = SubdivisionLevelsRenderer::perSampleInput;
+            const auto perSampleOutput = TestRender::render(input, blockSize, false, perSampleMethods);
+            RendererMethods blockMethods;
+            blockMethods.levelInput = SubdivisionLevelsRenderer::blockInput;
+            const auto blockOutput = TestRender::render(input, blockSize, false, blockMethods);
+            expectEquals(static_cast<int>(blockOutput.size()), static_cast<int>(perSampleOutput.size()));
+
+            const auto difference = std::mismatch(blockOutput.begin(), blockOutput.end(),
+                                                  perSampleOutput.begin(), perSampleOutput.end());
+            expect(difference.first == blockOutput.end(),
+                   "first difference at " + String(static_cast<int>(difference.first - blockOutput.begin())));
+
+            // every level is heard in its individual out
+            for (auto channel = 0; channel < TestRender::numOutputChannels; ++channel)
+                expect(TestRender::isChannelAudible(blockOutput, channel), "channel " + String(channel) + " is silent");
+        }
+    }
+};
+
+static LevelInputMethodTest levelInputMethodTest;
@@ -0,0 +1,62 @@
+/*
+  ==============================================================================
+
+	This file is part of Gamelanizer.
+	Copyright (c) 2019 - Luke McDuffie Craig.
+
+	Gamelanizer is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Gamelanizer is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Gamelanizer. If not, see <https://www.gnu.org/licenses/>.
+
+  ==============================================================================
+*/
+
+#include "../../JuceLibraryCode/JuceHeader.h"
+#include "TestRender.h"
+
+/**
+ * \brief Checks that GamelanizerAudioProcessor::processSamples, which works on segments between beat boundaries,
+ * is bit-identical to processing one sample at a time in the order the plug-in always has.
+ *
+ * The reference is TestRender::processBlockPerSample. The input is rendered by both with blocks of 512 and of
+ * 37 samples, while the parameters are automated, so the smoothers are ramping across segment and beat boundaries.
+ */
+class ProcessorRenderTest final : public UnitTest
+{
+public:
+    ProcessorRenderTest() : UnitTest("Processor render", "Gamelanizer")
+    {
+    }
+
+    void runTest() override
+    {
+        const auto input = TestRender::createInput();
+        for (const auto blockSize : {512, 37})
+        {
+            beginTest("Segments are bit-identical to per-sample processing, with blocks of " + String(blockSize));
+            const auto output = TestRender::render(input, blockSize, false);
+            const auto referenceOutput = TestRender::render(input, blockSize, true);
+            expectEquals(static_cast<int>(output.size()), static_cast<int>(referenceOutput.size()));
+
+            const auto difference = std::mismatch(output.begin(), output.end(),
+                                                  referenceOutput.begin(), referenceOutput.end());
+            expect(difference.first == output.end(),
+                   "first difference at " + String(static_cast<int>(difference.first - output.begin())));
+
+            // so that the comparison isn't just of silence
+            for (auto channel = 0; channel < TestRender::numOutputChannels; ++channel)
+                expect(TestRender::isChannelAudible(output, channel), "channel " + String(channel) + " is silent");
+        }
+    }
+};
+
+static ProcessorRenderTest processorRenderTest;
@@ -0,0 +1,93 @@
+/*
+  ==============================================================================
+
+	This file is part of Gamelanizer.
+	Copyright (c) 2019 - Luke McDuffie Craig.
+
+	Gamelanizer is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Gamelanizer is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Gamelanizer. If not, see <https://www.gnu.org/licenses/>.
+
+  ==============================================================================
+*/
+#include "../../JuceLibraryCode/JuceHeader.h"
+#include "TestRender.h"
+
+/**
+ * \brief Checks that every combination of SubdivisionLevelsRenderer::RenderingMethod,
+ * SubdivisionLevelsRenderer::BeatChangeMethod and SubdivisionLevelsRenderer::LevelParallelismMethod is bit-identical
+ * to rendering synchronously, with simultaneous beat changes, one level after another.
+ *
+ * With the default #SubdivisionLevelsRenderer::renderingMethod the background thread isn't started, so with
+ * asynchronousRendering every level lags as far behind as it can. The audio thread has to render the notes that are
+ * heard in each segment itself, and the queued input fills the FIFO well before the end of the render, so it has to
+ * make room for each segment too. No level can be silent where it would be heard, and no input can be dropped.
+ * With forkJoinLevels the levels really are rendered on several threads, so building this with ThreadSanitizer checks
+ * them for races.
+ */
+class RenderingMethodTest final : public UnitTest
+{
+public:
+    RenderingMethodTest() : UnitTest("Rendering methods", "Gamelanizer")
+    {
+    }
+
+    void runTest() override
+    {
+        const auto input = TestRender::createInput();
+        for (const auto blockSize : {512, 37})
+        {
+            RendererMethods referenceMethods;
+            referenceMethods.rendering = SubdivisionLevelsRenderer::synchronousRendering;
+            referenceMethods.beatChange = SubdivisionLevelsRenderer::simultaneousBeatChange;
+            referenceMethods.levelParallelism = SubdivisionLevelsRenderer::serialLevels;
+            const auto referenceOutput = TestRender::render(input, blockSize, false, referenceMethods);
+
+            for (const auto rendering : {SubdivisionLevelsRenderer::synchronousRendering,
+                                         SubdivisionLevelsRenderer::asynchronousRendering})
+                for (const auto beatChange : {SubdivisionLevelsRenderer::simultaneousBeatChange,
+                                              SubdivisionLevelsRenderer::staggeredBeatChange})
+                    for (const auto levelParallelism : {SubdivisionLevelsRenderer::serialLevels,
+                                                        SubdivisionLevelsRenderer::forkJoinLevels})
+                    {
+                        RendererMethods methods;
+                        methods.rendering = rendering;
+                        methods.beatChange = beatChange;
+                        methods.levelParallelism = levelParallelism;
+                        if (methods.rendering == referenceMethods.rendering
+                            && methods.beatChange == referenceMethods.beatChange
+                            && methods.levelParallelism == referenceMethods.levelParallelism)
+                            continue;
+
+                        beginTest(String(rendering == SubdivisionLevelsRenderer::synchronousRendering
+                                             ? "Synchronous"
+                                             : "Asynchronous")
+                            + (beatChange == SubdivisionLevelsRenderer::simultaneousBeatChange
+                                   ? " rendering with simultaneous beat changes and "
+                                   : " rendering with staggered beat changes and ")
+                            + (levelParallelism == SubdivisionLevelsRenderer::serialLevels
+                                   ? "serial levels"
+                                   : "forked levels")
+                            + " is bit-identical, with blocks of " + String(blockSize));
+                        const auto output = TestRender::render(input, blockSize, false, methods);
+                        expectEquals(static_cast<int>(output.size()), static_cast<int>(referenceOutput.size()));
+
+                        const auto difference = std::mismatch(output.begin(), output.end(),
+                                                              referenceOutput.begin(), referenceOutput.end());
+                        expect(difference.first == output.end(),
+                               "first difference at " + String(static_cast<int>(difference.first - output.begin())));
+                    }
+        }
+    }
+};
+
+static RenderingMethodTest renderingMethodTest;
@@ -0,0 +1,200 @@
+/*
+  ==============================================================================
+
+	This file is part of Gamelanizer.
+	Copyright (c) 2019 - Luke McDuffie Craig.
+
+	Gamelanizer is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Gamelanizer is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Gamelanizer. If not, see <https://www.gnu.org/licenses/>.
+
+  ==============================================================================
+*/
+
+#include "../../JuceLibraryCode/JuceHeader.h"
+#include "../../Source/SimdPhaseMath.h"
+
+/**
+ * \brief Checks the approximations of SimdPhaseMath against the standard library, computed in double precision.
+ *
+ * Every array has an odd length, so the scalar tail after the SIMD lanes is checked too.
+ */
+class SimdPhaseMathTest final : public UnitTest
+{
+public:
+    SimdPhaseMathTest() : UnitTest("SimdPhaseMath", "Gamelanizer")
+    {
+    }
+
+    void runTest() override
+    {
+        beginTest("The arctangent is within the bound for every exponent and angle");
+        checkArctangentOfEveryExponent();
+
+        beginTest("The arctangent is within the bound for every ratio of the sides");
+        checkArctangentOfEveryRatio();
+
+        beginTest("The sine and cosine are within the bound for wrapped phases");
+        checkSineAndCosine();
+
+        beginTest("The wrap is within the bound as an angle, and only just outside [-pi, pi]");
+        for (const auto synthesisOverlapFactor : {1.0f, 4.0f, 16.0f})
+            checkWrap(synthesisOverlapFactor);
+    }
+
+private:
+    /**
+     * \brief The bound in SimdPhaseMath's documentation
+     */
+    static constexpr double maxError{3.0e-7};
+
+    /**
+     * \brief The number of bins of a 1024 point FFT, plus the most the phase deviation can add
+     */
+    static constexpr float maxTrueBinIndex{513.0f + 8.0f};
+
+    /**
+     * \return The difference between two angles, the short way around the circle
+     */
+    static double angleDifference(const double a, const double b)
+    {
+        return std::abs(std::remainder(a - b, MathConstants<double>::twoPi));
+    }
+
+    /**
+     * \brief Compare SimdPhaseMath::cartesianToPolar's phases to std::atan2
+     * \return The largest difference
+     */
+    static double measureArctangent(const std::vector<float>& complexBins)
+    {
+        const auto numBins = static_cast<int>(complexBins.size() / 2);
+        std::vector<float> magnitudes(static_cast<size_t>(numBins));
+        std::vector<float> phases(static_cast<size_t>(numBins));
+        SimdPhaseMath::cartesianToPolar(complexBins.data(), magnitudes.data(), phases.data(), numBins);
+
+        auto largestError = 0.0;
+        for (auto k = 0; k < numBins; ++k)
+        {
+            const auto exact = std::atan2(static_cast<double>(complexBins[2 * k + 1]),
+                                          static_cast<double>(complexBins[2 * k]));
+            largestError = jmax(largestError, angleDifference(phases[k], exact));
+        }
+        return largestError;
+    }
+
+    /**
+     * \brief Points all the way around the circle, at every radius from the smallest denormal to the largest float
+     */
+    void checkArctangentOfEveryExponent()
+    {
+        constexpr auto numAngles = 4095;
+        std::vector<float> complexBins(2 * numAngles);
+        auto largestError = 0.0;
+        for (auto exponent = -149; exponent <= 127; ++exponent)
+        {
+            // 1.5 times the largest power of two would overflow
+            const auto radius = std::ldexp(exponent < 127 ? 1.5 : 1.0, exponent);
+            for (auto i = 0; i < numAngles; ++i)
+            {
+                const auto angle = MathConstants<double>::twoPi * (i + 0.5) / numAngles - MathConstants<double>::pi;
+                complexBins[2 * i] = static_cast<float>(radius * std::cos(angle));
+                complexBins[2 * i + 1] = static_cast<float>(radius * std::sin(angle));
+            }
+            largestError = jmax(largestError, measureArctangent(complexBins));
+        }
+        expectLessThan(largestError, maxError);
+
+        // the axes and the origin
+        const std::vector<float> axes{0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, -1.0f};
+        expectLessThan(measureArctangent(axes), maxError);
+    }
+
+    /**
+     * \brief Every 997th float ratio in [0, 1], in each of the octants that the approximation reconstructs
+     */
+    void checkArctangentOfEveryRatio()
+    {
+        std::vector<float> ratios;
+        for (uint32 bits = 0; bits <= 0x3f800000u; bits += 997)
+        {
+            float ratio;
+            std::memcpy(&ratio, &bits, sizeof(ratio));
+            ratios.push_back(ratio);
+        }
+
+        auto largestError = 0.0;
+        std::vector<float> complexBins(2 * ratios.size());
+        for (const auto signs : {std::make_pair(1.0f, 1.0f), std::make_pair(-1.0f, 1.0f),
+                                 std::make_pair(-1.0f, -1.0f), std::make_pair(1.0f, -1.0f)})
+        {
+            for (const auto isSwapped : {false, true})
+            {
+                for (size_t i = 0; i < ratios.size(); ++i)
+                {
+                    complexBins[2 * i] = signs.first * (isSwapped ? ratios[i] : 1.0f);
+                    complexBins[2 * i + 1] = signs.second * (isSwapped ? 1.0f : ratios[i]);
+                }
+                largestError = jmax(largestError, measureArctangent(complexBins));
+            }
+        }
+        expectLessThan(largestError, maxError);
+    }
+
+    void checkSineAndCosine()
+    {
+        constexpr auto numPhases = (1 << 20) + 1;
+        std::vector<float> magnitudes(numPhases, 1.0f);
+        std::vector<float> phases(numPhases);
+        for (auto i = 0; i < numPhases; ++i)
+            phases[i] = static_cast<float>(MathConstants<double>::twoPi * i / (numPhases - 1) - MathConstants<double>::pi);
+        std::vector<float> complexBins(2 * numPhases);
+        SimdPhaseMath::polarToCartesian(magnitudes.data(), phases.data(), complexBins.data(), numPhases);
+
+        auto largestError = 0.0;
+        for (auto i = 0; i < numPhases; ++i)
+        {
+            largestError = jmax(largestError, std::abs(complexBins[2 * i] - std::cos(static_cast<double>(phases[i]))));
+            largestError = jmax(largestError, std::abs(complexBins[2 * i + 1] - std::sin(static_cast<double>(phases[i]))));
+        }
+        expectLessThan(largestError, maxError);
+    }
+
+    /**
+     * \brief Advance phases of 0 by every true bin index up to #maxTrueBinIndex, in both directions,
+     * and compare the wrapped results to std::remainder
+     */
+    void checkWrap(const float synthesisOverlapFactor)
+    {
+        constexpr auto numBins = (1 << 20) + 1;
+        std::vector<float> trueBinIndices(numBins);
+        for (auto k = 0; k < numBins; ++k)
+            trueBinIndices[k] = maxTrueBinIndex * (2.0f * static_cast<float>(k) / (numBins - 1) - 1.0f);
+        std::vector<float> scaledPhases(numBins, 0.0f);
+        SimdPhaseMath::accumulatePhases(scaledPhases.data(), trueBinIndices.data(), numBins, synthesisOverlapFactor);
+
+        // the same float phases that accumulatePhases wraps
+        const auto phaseAdvancePerBin = 2.0f * MathConstants<float>::pi / synthesisOverlapFactor;
+        auto largestError = 0.0;
+        auto largestOvershoot = 0.0;
+        for (auto k = 0; k < numBins; ++k)
+        {
+            const auto unwrapped = static_cast<double>(0.0f + trueBinIndices[k] * phaseAdvancePerBin);
+            largestError = jmax(largestError, angleDifference(scaledPhases[k], unwrapped));
+            const auto overshoot = std::abs(static_cast<double>(scaledPhases[k])) - MathConstants<double>::pi;
+            largestOvershoot = jmax(largestOvershoot, overshoot / jmax(1.0, std::abs(unwrapped)));
+        }
+        expectLessThan(largestError, maxError);
+        expectLessThan(largestOvershoot, 1.0e-7);
+    }
+};
+
+static SimdPhaseMathTest simdPhaseMathTest;
@@ -0,0 +1,309 @@
+/*
+  ==============================================================================
+
+	This file is part of Gamelanizer.
+	Copyright (c) 2019 - Luke McDuffie Craig.
+
+	Gamelanizer is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Gamelanizer is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Gamelanizer. If not, see <https://www.gnu.org/licenses/>.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "../../JuceLibraryCode/JuceHeader.h"
+#include "../../Source/PluginProcessor.h"
+
+/**
+ * \brief The ways a TestRender passes the input to the levels and renders them. They default to the methods the
+ * plug-in uses.
+ */
+struct RendererMethods
+{
+    SubdivisionLevelsRenderer::LevelInputMethod levelInput{SubdivisionLevelsRenderer::levelInputMethod};
+
+    /**
+     * \brief See SubdivisionLevelsRenderer::renderMethod
+     */
+    SubdivisionLevelsRenderer::RenderingMethod rendering{SubdivisionLevelsRenderer::renderingMethod};
+
+    SubdivisionLevelsRenderer::BeatChangeMethod beatChange{SubdivisionLevelsRenderer::beatChangeMethod};
+
+    SubdivisionLevelsRenderer::LevelParallelismMethod levelParallelism{
+        SubdivisionLevelsRenderer::levelParallelismMethod
+    };
+};
+
+/**
+ * \brief Renders a fixed input through a GamelanizerAudioProcessor while its parameters are automated, for the tests
+ * that compare two ways of processing the same thing.
+ *
+ * The gains, pans and filters change after the first beat, and the base and subdivision level 2 are muted for a
+ * while. The pitch of level 0 and then of level 1 is smoothed, and levels 2 and 3 start out sharing their analysis
+ * until the taper of level 3 changes in the middle of a beat.
+ */
+class TestRender
+{
+public:
+    static constexpr double sampleRate{44100.0};
+
+    /**
+     * \brief 120 bpm at 44.1 kHz
+     */
+    static constexpr int beatSampleLength{22050};
+
+    static constexpr int numSamples{8 * beatSampleLength};
+
+    /**
+     * \brief The stereo out and the individual outs of the base and the 4 subdivision levels
+     */
+    static constexpr int numOutputChannels{7};
+
+    /**
+     * \brief A tone with some noise. Every third quarter of a beat is silent, so the silence gating is checked too.
+     */
+    static std::vector<float> createInput()
+    {
+        std::vector<float> input(static_cast<size_t>(numSamples));
+        Random random(1);
+        for (size_t i = 0; i < input.size(); ++i)
+        {
+            const auto tone = 0.5f * std::sin(MathConstants<float>::twoPi * 440.0f * static_cast<float>(i) / 44100.0f);
+            const auto noise = 0.05f * (2.0f * random.nextFloat() - 1.0f);
+            input[i] = (i / (beatSampleLength / 4)) % 3 == 2 ? 0.0f : tone + noise;
+        }
+        return input;
+    }
+
+    /**
+     * \brief Render the input through a new processor.
+     * \param input The mono input, #numSamples long
+     * \param blockSize The length of the blocks the host passes to the processor
+     * \param isPerSampleReference Whether to use processBlockPerSample instead of GamelanizerAudioProcessor::processBlock
+     * \param methods How the levels get their input and are rendered
+     * \return Every output channel, one after the other
+     */
+    static std::vector<float> render(const std::vector<float>& input, const int blockSize,
+                                     const bool isPerSampleReference, const RendererMethods& methods = {})
+    {
+        GamelanizerAudioProcessor processor;
+        processor.enableAllBuses();
+        processor.setNonRealtime(true);
+        PlayHead playHead;
+        processor.setPlayHead(&playHead);
+        processor.levelsRenderer.inputMethod = methods.levelInput;
+        processor.levelsRenderer.renderMethod = methods.rendering;
+        processor.levelsRenderer.beatChange = methods.beatChange;
+        processor.levelsRenderer.parallelism = methods.levelParallelism;
+
+        // every level can be heard from the start, and levels 2 and 3 have identical input
+        auto& parameters = processor.gamelanizerParameters;
+        for (auto level = 0; level <= GamelanizerConstants::maxLevels; ++level)
+            setParameter(processor, parameters.getMuteId(level), 0.0f);
+        setParameter(processor, parameters.getPitchId(3), 3600.0f);
+        setParameter(processor, parameters.getTaperId(3), 0.1f);
+        processor.gamelanizerParametersVtsHelper.instantlyUpdateSmoothers();
+        processor.prepareToPlay(sampleRate, blockSize);
+        jassert(processor.getTotalNumOutputChannels() == numOutputChannels);
+
+        std::vector<float> output(static_cast<size_t>(numOutputChannels * numSamples));
+        AudioBuffer<float> buffer(numOutputChannels, blockSize);
+        MidiBuffer midiMessages;
+        for (auto blockStart = 0; blockStart < numSamples; blockStart += blockSize)
+        {
+            const auto numBlockSamples = jmin(blockSize, numSamples - blockStart);
+            buffer.setSize(numOutputChannels, numBlockSamples, false, false, true);
+            buffer.clear();
+            buffer.copyFrom(0, 0, input.data() + blockStart, numBlockSamples);
+
+            automate(processor, blockStart, numBlockSamples);
+            playHead.timeInSamples = blockStart;
+            if (isPerSampleReference)
+                processBlockPerSample(processor, buffer);
+            else
+                processor.processBlock(buffer, midiMessages);
+
+            for (auto channel = 0; channel < numOutputChannels; ++channel)
+                std::copy(buffer.getReadPointer(channel), buffer.getReadPointer(channel) + numBlockSamples,
+                          output.begin() + channel * numSamples + blockStart);
+        }
+        processor.releaseResources();
+        return output;
+    }
+
+    /**
+     * \return True if a channel of the output of render has any sound in it
+     */
+    static bool isChannelAudible(const std::vector<float>& output, const int channel)
+    {
+        const auto channelStart = output.begin() + channel * numSamples;
+        return std::any_of(channelStart, channelStart + numSamples, [](const float x) { return x != 0.0f; });
+    }
+
+private:
+    /**
+     * \brief Plays from the start at 120 bpm
+     */
+    struct PlayHead final : AudioPlayHead
+    {
+        int64 timeInSamples{};
+
+        bool getCurrentPosition(CurrentPositionInfo& result) override
+        {
+            result.resetToDefault();
+            result.bpm = 120.0;
+            result.timeInSamples = timeInSamples;
+            result.isPlaying = true;
+            return true;
+        }
+    };
+
+    static void setParameter(GamelanizerAudioProcessor& processor, const String& parameterId, const float value)
+    {
+        *processor.audioProcessorValueTreeState.getRawParameterValue(parameterId) = value;
+    }
+
+    /**
+     * \brief Change the parameters at the start of the block that contains each change
+     */
+    static void automate(GamelanizerAudioProcessor& processor, const int blockStart, const int blockSize)
+    {
+        auto& parameters = processor.gamelanizerParameters;
+        const auto isInBlock = [blockStart, blockSize](const int time)
+        {
+            return time >= blockStart && time < blockStart + blockSize;
+        };
+
+        if (isInBlock(30000))
+        {
+            for (auto level = 0; level <= GamelanizerConstants::maxLevels; ++level)
+            {
+                setParameter(processor, parameters.getGainId(level), 0.3f + 0.1f * static_cast<float>(level));
+                setParameter(processor, parameters.getPanId(level), 40.0f * static_cast<float>(level) - 80.0f);
+            }
+            for (auto level = 0; level < GamelanizerConstants::maxLevels; ++level)
+            {
+                setParameter(processor, parameters.getLpfId(level), 3000.0f);
+                setParameter(processor, parameters.getHpfId(level), 200.0f);
+            }
+        }
+        // in the middle of a beat in which levels 2 and 3 share their analysis
+        if (isInBlock(50000))
+            setParameter(processor, parameters.getTaperId(3), 0.5f);
+        if (isInBlock(60000))
+        {
+            setParameter(processor, parameters.getMuteId(0), 1.0f);
+            setParameter(processor, parameters.getMuteId(3), 1.0f);
+            setParameter(processor, parameters.getPitchId(0), -300.0f);
+        }
+        if (isInBlock(95000))
+        {
+            setParameter(processor, parameters.getMuteId(0), 0.0f);
+            setParameter(processor, parameters.getMuteId(3), 0.0f);
+            setParameter(processor, parameters.getPitchId(1), 500.0f);
+        }
+    }
+
+    /**
+     * \brief GamelanizerAudioProcessor::processBlock, with each sample processed on its own like the per-sample loop
+     * did, instead of with GamelanizerAudioProcessor::processSamples. It delays the base level, reads each subdivision
+     * level, applies its gain and mute, filters it, and then pans it into the outputs. Only the parts that the segments
+     * didn't change are shared with the processor: the levels' input and rendering, and the beat changes.
+     */
+    static void processBlockPerSample(GamelanizerAudioProcessor& processor, AudioBuffer<float>& buffer)
+    {
+        auto& parameters = processor.gamelanizerParametersVtsHelper;
+        parameters.updateSmoothers();
+        processor.levelsFilterBank.snapToZero();
+        if (processor.handleTimelineStateChange())
+            return;
+
+        const auto numBlockSamples = buffer.getNumSamples();
+
+        auto* multiOutWrite = buffer.getArrayOfWritePointers();
+        auto& baseDelayBuffer = processor.baseDelayBuffer;
+        auto* baseDelayBufferReadWrite = baseDelayBuffer.data.getWritePointer(0);
+        const auto baseDelayBufferLength = baseDelayBuffer.data.getNumSamples();
+        for (auto sample = 0; sample < numBlockSamples; ++sample)
+        {
+            const auto sampleData = multiOutWrite[0][sample];
+
+            const auto haveIdenticalInput = processor.findLevelsWithIdenticalInput();
+            parameters.generateRamps(1);
+            processor.processLevelsInputSegment(&sampleData, 1, haveIdenticalInput);
+
+            // store new input sample into delay buffer
+            baseDelayBufferReadWrite[baseDelayBuffer.writePosition] = sampleData;
+
+            const auto baseGain = parameters.getGainRamp(0)[0] * (1.0f - parameters.getMuteRamp(0)[0]);
+            const auto baseOutput = baseDelayBufferReadWrite[baseDelayBuffer.readPosition] * baseGain;
+            const auto basePanAmplitude = parameters.getPanRamp(0)[0] / 200.0f + 0.5f;
+
+            // base - stereo out
+            multiOutWrite[0][sample] = std::sqrt(1.0f - basePanAmplitude) * baseOutput;
+            multiOutWrite[1][sample] = std::sqrt(basePanAmplitude) * baseOutput;
+
+            // base - individual out
+            multiOutWrite[2][sample] = baseOutput;
+
+            // subdivision levels, with the gain and mute before the filters
+            processor.levelsRenderer.finishRendering();
+            std::array<float, GamelanizerConstants::maxLevels> levelOutputs{};
+            std::array<float*, GamelanizerConstants::maxLevels> levelOutputPointers{};
+            for (auto level = 0; level < GamelanizerConstants::maxLevels; ++level)
+            {
+                processor.levelsOutputBuffer.readSamples(level, &levelOutputs[level], 1);
+                levelOutputs[level] *= parameters.getGainRamp(level + 1)[0]
+                    * (1.0f - parameters.getMuteRamp(level + 1)[0]);
+                levelOutputPointers[level] = &levelOutputs[level];
+            }
+
+            processor.levelsFilterBank.process(levelOutputPointers, 1, [&processor]
+            {
+                for (auto& subdivisionLevel : processor.subdivisionLevels)
+                    subdivisionLevel.updateFilters();
+            });
+
+            for (auto level = 0; level < GamelanizerConstants::maxLevels; ++level)
+            {
+                const auto levelOutputFiltered = levelOutputs[level];
+                const auto levelPanAmplitude = parameters.getPanRamp(level + 1)[0] / 200.0f + 0.5f;
+                // stereo out
+                multiOutWrite[0][sample] += std::sqrt(1.0f - levelPanAmplitude) * levelOutputFiltered;
+                multiOutWrite[1][sample] += std::sqrt(levelPanAmplitude) * levelOutputFiltered;
+
+                // individual out (+3 is to skip the stereo out and base channels)
+                multiOutWrite[level + 3][sample] = levelOutputFiltered;
+            }
+
+            // if we're on a beat boundary
+            if (processor.beatSampleInfo.getNumSamplesLeftInBeat() == 1)
+                processor.nextBeat();
+            else
+                processor.beatSampleInfo.incrementSamplesIntoBeat(1);
+
+            // update indices and circle them back around if necessary
+            ++processor.levelsOutputBuffer.readPosition;
+
+            ++baseDelayBuffer.writePosition;
+            if (baseDelayBuffer.writePosition == baseDelayBufferLength)
+                baseDelayBuffer.writePosition = 0;
+
+            ++baseDelayBuffer.readPosition;
+            if (baseDelayBuffer.readPosition == baseDelayBufferLength)
+                baseDelayBuffer.readPosition = 0;
+
+            ++processor.hostSampleOughtToBe;
+        }
+    }
+};